@@ -6,10 +6,15 @@ HIDAPI_ROOT_ABS:= $(LOCAL_PATH)/../..
 include $(CLEAR_VARS)
 
 LOCAL_SRC_FILES := \
-  $(HIDAPI_ROOT_REL)/libusb/hid.c
+  $(HIDAPI_ROOT_REL)/libusb/hid.c \
+  $(HIDAPI_ROOT_REL)/core/hidapi_device_info.c \
+  $(HIDAPI_ROOT_REL)/core/hidapi_parallel.c \
+  $(HIDAPI_ROOT_REL)/core/hidapi_report_descriptor.c \
+  $(HIDAPI_ROOT_REL)/core/hidapi_utf.c
 
 LOCAL_C_INCLUDES += \
   $(HIDAPI_ROOT_ABS)/hidapi \
+  $(HIDAPI_ROOT_ABS)/core \
   $(HIDAPI_ROOT_ABS)/android
 
 LOCAL_SHARED_LIBRARIES := libusb1.0
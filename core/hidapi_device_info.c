@@ -0,0 +1,140 @@
+/*******************************************************
+ HIDAPI - Multi-Platform library for
+ communication with HID devices.
+
+ libusb/hidapi Team
+
+ Copyright 2023, All Rights Reserved.
+
+ At the discretion of the user of this library,
+ this software may be licensed under the terms of the
+ GNU General Public License v3, a BSD-Style license, or the
+ original HIDAPI license as outlined in the LICENSE.txt,
+ LICENSE-gpl3.txt, LICENSE-bsd.txt, and LICENSE-orig.txt
+ files located at the root of the source distribution.
+ These files may also be found in the public source
+ code repository located at:
+        https://github.com/libusb/hidapi .
+********************************************************/
+
+#include "hidapi_device_info.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+
+/* The layout of a packed list: the records, then the wide strings,
+   then the narrow strings, so that each part is aligned. */
+struct packed_size {
+	size_t num_records;
+	size_t wide_chars;
+	size_t narrow_chars;
+};
+
+static int same_wide_string(const wchar_t *a, const wchar_t *b)
+{
+	return a && b && wcscmp(a, b) == 0;
+}
+
+static void add_wide_string(struct packed_size *size, const wchar_t *str, const wchar_t *prev)
+{
+	if (str && !same_wide_string(str, prev))
+		size->wide_chars += wcslen(str) + 1;
+}
+
+/* Returns the copy of str, prev_copy if str equals prev */
+static wchar_t *pack_wide_string(wchar_t **wide, const wchar_t *str, const wchar_t *prev, wchar_t *prev_copy)
+{
+	wchar_t *copy;
+	size_t len;
+
+	if (!str)
+		return NULL;
+	if (same_wide_string(str, prev))
+		return prev_copy;
+
+	len = wcslen(str) + 1;
+	copy = *wide;
+	memcpy(copy, str, len * sizeof(wchar_t));
+	*wide += len;
+	return copy;
+}
+
+struct hid_device_info *hidapi_pack_device_info_list(struct hid_device_info *devs)
+{
+	struct packed_size size = { 0, 0, 0 };
+	const struct hid_device_info *cur;
+	const struct hid_device_info *prev;
+	struct hid_device_info *packed;
+	struct hid_device_info *record;
+	wchar_t *wide;
+	char *narrow;
+
+	if (!devs)
+		return NULL;
+
+	for (cur = devs, prev = NULL; cur; prev = cur, cur = cur->next) {
+		size.num_records++;
+		if (cur->path && !(prev && prev->path && strcmp(cur->path, prev->path) == 0))
+			size.narrow_chars += strlen(cur->path) + 1;
+		add_wide_string(&size, cur->serial_number, prev? prev->serial_number: NULL);
+		add_wide_string(&size, cur->manufacturer_string, prev? prev->manufacturer_string: NULL);
+		add_wide_string(&size, cur->product_string, prev? prev->product_string: NULL);
+	}
+
+	packed = (struct hid_device_info*) malloc(size.num_records * sizeof(struct hid_device_info)
+		+ size.wide_chars * sizeof(wchar_t)
+		+ size.narrow_chars);
+	if (!packed) {
+		hidapi_free_device_info_list(devs);
+		return NULL;
+	}
+
+	wide = (wchar_t*) (packed + size.num_records);
+	narrow = (char*) (wide + size.wide_chars);
+
+	for (cur = devs, prev = NULL, record = packed; cur; prev = cur, cur = cur->next, record++) {
+		const struct hid_device_info *prev_record = prev? record - 1: NULL;
+
+		*record = *cur;
+		record->next = cur->next? record + 1: NULL;
+
+		if (!cur->path) {
+			record->path = NULL;
+		}
+		else if (prev && prev->path && strcmp(cur->path, prev->path) == 0) {
+			record->path = prev_record->path;
+		}
+		else {
+			size_t len = strlen(cur->path) + 1;
+			memcpy(narrow, cur->path, len);
+			record->path = narrow;
+			narrow += len;
+		}
+
+		record->serial_number = pack_wide_string(&wide, cur->serial_number,
+			prev? prev->serial_number: NULL, prev? prev_record->serial_number: NULL);
+		record->manufacturer_string = pack_wide_string(&wide, cur->manufacturer_string,
+			prev? prev->manufacturer_string: NULL, prev? prev_record->manufacturer_string: NULL);
+		record->product_string = pack_wide_string(&wide, cur->product_string,
+			prev? prev->product_string: NULL, prev? prev_record->product_string: NULL);
+	}
+
+	hidapi_free_device_info_list(devs);
+
+	return packed;
+}
+
+void hidapi_free_device_info_list(struct hid_device_info *devs)
+{
+	struct hid_device_info *d = devs;
+	while (d) {
+		struct hid_device_info *next = d->next;
+		free(d->path);
+		free(d->serial_number);
+		free(d->manufacturer_string);
+		free(d->product_string);
+		free(d);
+		d = next;
+	}
+}
@@ -0,0 +1,42 @@
+/*******************************************************
+ HIDAPI - Multi-Platform library for
+ communication with HID devices.
+
+ libusb/hidapi Team
+
+ Copyright 2023, All Rights Reserved.
+
+ At the discretion of the user of this library,
+ this software may be licensed under the terms of the
+ GNU General Public License v3, a BSD-Style license, or the
+ original HIDAPI license as outlined in the LICENSE.txt,
+ LICENSE-gpl3.txt, LICENSE-bsd.txt, and LICENSE-orig.txt
+ files located at the root of the source distribution.
+ These files may also be found in the public source
+ code repository located at:
+        https://github.com/libusb/hidapi .
+********************************************************/
+
+#ifndef HIDAPI_DEVICE_INFO_H
+#define HIDAPI_DEVICE_INFO_H
+
+#include "hidapi.h"
+
+/* Internal helpers shared by the backends, not part of the public API.
+
+   The lists returned by hid_enumerate() are packed: the records and
+   their strings live in a single allocation, which starts with the
+   first record, so that hid_free_enumeration() is a single free().
+   The lists used internally (hotplug, hid_get_device_info()) are built
+   record by record, with separately allocated strings. */
+
+/* Packs a list built record by record, which is freed.
+   Equal strings of consecutive records (e.g. the records of the
+   top-level collections of a device) are stored once.
+   Returns NULL if devs is NULL or the memory allocation fails. */
+struct hid_device_info *hidapi_pack_device_info_list(struct hid_device_info *devs);
+
+/* Frees a list built record by record (not packed). */
+void hidapi_free_device_info_list(struct hid_device_info *devs);
+
+#endif /* HIDAPI_DEVICE_INFO_H */
@@ -0,0 +1,117 @@
+/*******************************************************
+ HIDAPI - Multi-Platform library for
+ communication with HID devices.
+
+ libusb/hidapi Team
+
+ Copyright 2023, All Rights Reserved.
+
+ At the discretion of the user of this library,
+ this software may be licensed under the terms of the
+ GNU General Public License v3, a BSD-Style license, or the
+ original HIDAPI license as outlined in the LICENSE.txt,
+ LICENSE-gpl3.txt, LICENSE-bsd.txt, and LICENSE-orig.txt
+ files located at the root of the source distribution.
+ These files may also be found in the public source
+ code repository located at:
+        https://github.com/libusb/hidapi .
+********************************************************/
+
+#include "hidapi_parallel.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+struct parallel_job {
+	pthread_mutex_t mutex;
+	size_t next;
+	size_t count;
+	int has_deadline;
+	struct timespec deadline;
+	hidapi_parallel_work_fn work;
+	void *context;
+};
+
+static int deadline_passed(const struct parallel_job *job)
+{
+	struct timespec now;
+
+	if (!job->has_deadline)
+		return 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec > job->deadline.tv_sec
+	    || (now.tv_sec == job->deadline.tv_sec && now.tv_nsec >= job->deadline.tv_nsec);
+}
+
+static void *parallel_worker(void *param)
+{
+	struct parallel_job *job = (struct parallel_job*) param;
+	size_t index;
+
+	for (;;) {
+		pthread_mutex_lock(&job->mutex);
+		if (job->next >= job->count || deadline_passed(job)) {
+			/* Also stops the other threads without looking at the clock */
+			job->next = job->count;
+			pthread_mutex_unlock(&job->mutex);
+			return NULL;
+		}
+		index = job->next++;
+		pthread_mutex_unlock(&job->mutex);
+
+		job->work(index, job->context);
+	}
+}
+
+void hidapi_parallel_for(size_t count, int max_threads, int timeout_ms, hidapi_parallel_work_fn work, void *context)
+{
+	struct parallel_job job;
+	pthread_t *threads = NULL;
+	size_t num_threads = 0;
+	size_t i;
+
+	job.next = 0;
+	job.count = count;
+	job.has_deadline = timeout_ms >= 0;
+	job.work = work;
+	job.context = context;
+
+	if (job.has_deadline) {
+		clock_gettime(CLOCK_MONOTONIC, &job.deadline);
+		job.deadline.tv_sec += timeout_ms / 1000;
+		job.deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+		if (job.deadline.tv_nsec >= 1000000000L) {
+			job.deadline.tv_sec++;
+			job.deadline.tv_nsec -= 1000000000L;
+		}
+	}
+
+	pthread_mutex_init(&job.mutex, NULL);
+
+	/* The calling thread is one of the workers */
+	if (max_threads > 1 && count > 1) {
+		num_threads = (size_t) max_threads - 1;
+		if (num_threads > count - 1)
+			num_threads = count - 1;
+
+		threads = (pthread_t*) calloc(num_threads, sizeof(pthread_t));
+		if (!threads)
+			num_threads = 0;
+	}
+
+	for (i = 0; i < num_threads; i++) {
+		if (pthread_create(&threads[i], NULL, parallel_worker, &job) != 0)
+			break;
+	}
+	num_threads = i;
+
+	parallel_worker(&job);
+
+	for (i = 0; i < num_threads; i++)
+		pthread_join(threads[i], NULL);
+
+	free(threads);
+	pthread_mutex_destroy(&job.mutex);
+}
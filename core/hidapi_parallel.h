@@ -0,0 +1,37 @@
+/*******************************************************
+ HIDAPI - Multi-Platform library for
+ communication with HID devices.
+
+ libusb/hidapi Team
+
+ Copyright 2023, All Rights Reserved.
+
+ At the discretion of the user of this library,
+ this software may be licensed under the terms of the
+ GNU General Public License v3, a BSD-Style license, or the
+ original HIDAPI license as outlined in the LICENSE.txt,
+ LICENSE-gpl3.txt, LICENSE-bsd.txt, and LICENSE-orig.txt
+ files located at the root of the source distribution.
+ These files may also be found in the public source
+ code repository located at:
+        https://github.com/libusb/hidapi .
+********************************************************/
+
+#ifndef HIDAPI_PARALLEL_H
+#define HIDAPI_PARALLEL_H
+
+#include <stddef.h>
+
+/* Internal helper shared by the backends, not part of the public API. */
+
+typedef void (*hidapi_parallel_work_fn)(size_t index, void *context);
+
+/* Calls work(index, context) once for each index in [0, count), from up
+   to max_threads threads: the calling thread and (max_threads - 1) new
+   ones, fewer if there are fewer indexes or a thread can't be created.
+   The indexes are handed out in increasing order, none is handed out
+   once timeout_ms milliseconds have passed (negative: no timeout), so
+   some indexes may be skipped. Returns once all the calls returned. */
+void hidapi_parallel_for(size_t count, int max_threads, int timeout_ms, hidapi_parallel_work_fn work, void *context);
+
+#endif /* HIDAPI_PARALLEL_H */
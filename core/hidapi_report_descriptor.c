@@ -0,0 +1,781 @@
+/*******************************************************
+ HIDAPI - Multi-Platform library for
+ communication with HID devices.
+
+ libusb/hidapi Team
+
+ Copyright 2023, All Rights Reserved.
+
+ At the discretion of the user of this library,
+ this software may be licensed under the terms of the
+ GNU General Public License v3, a BSD-Style license, or the
+ original HIDAPI license as outlined in the LICENSE.txt,
+ LICENSE-gpl3.txt, LICENSE-bsd.txt, and LICENSE-orig.txt
+ files located at the root of the source distribution.
+ These files may also be found in the public source
+ code repository located at:
+        https://github.com/libusb/hidapi .
+********************************************************/
+
+#include "hidapi_report_descriptor.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Gets the size of the HID item at the given position
+ * Returns 1 if successful, 0 if an invalid key
+ * Sets data_len and key_size when successful
+ */
+static int get_hid_item_size(const uint8_t *report_descriptor, unsigned int pos, size_t size, int *data_len, int *key_size)
+{
+	int key = report_descriptor[pos];
+	int size_code;
+
+	/*
+	 * This is a Long Item. The next byte contains the
+	 * length of the data section (value) for this key.
+	 * See the HID specification, version 1.11, section
+	 * 6.2.2.3, titled "Long Items."
+	 */
+	if ((key & 0xf0) == 0xf0) {
+		if (pos + 1 < size)
+		{
+			*data_len = report_descriptor[pos + 1];
+			*key_size = 3;
+			return 1;
+		}
+		*data_len = 0; /* malformed report */
+		*key_size = 0;
+	}
+
+	/*
+	 * This is a Short Item. The bottom two bits of the
+	 * key contain the size code for the data section
+	 * (value) for this key. Refer to the HID
+	 * specification, version 1.11, section 6.2.2.2,
+	 * titled "Short Items."
+	 */
+	size_code = key & 0x3;
+	switch (size_code) {
+	case 0:
+	case 1:
+	case 2:
+		*data_len = size_code;
+		*key_size = 1;
+		return 1;
+	case 3:
+		*data_len = 4;
+		*key_size = 1;
+		return 1;
+	default:
+		/* Can't ever happen since size_code is & 0x3 */
+		*data_len = 0;
+		*key_size = 0;
+		break;
+	};
+
+	/* malformed report */
+	return 0;
+}
+
+/*
+ * Get bytes from a HID Report Descriptor.
+ * Only call with a num_bytes of 0, 1, 2, or 4.
+ */
+static uint32_t get_hid_report_bytes(const uint8_t *rpt, size_t len, size_t num_bytes, size_t cur)
+{
+	/* Return if there aren't enough bytes. */
+	if (cur + num_bytes >= len)
+		return 0;
+
+	if (num_bytes == 0)
+		return 0;
+	else if (num_bytes == 1)
+		return rpt[cur + 1];
+	else if (num_bytes == 2)
+		return (rpt[cur + 2] * 256 + rpt[cur + 1]);
+	else if (num_bytes == 4)
+		return (
+			rpt[cur + 4] * 0x01000000 +
+			rpt[cur + 3] * 0x00010000 +
+			rpt[cur + 2] * 0x00000100 +
+			rpt[cur + 1] * 0x00000001
+		);
+	else
+		return 0;
+}
+
+/* See hidapi_report_descriptor.h */
+int hidapi_get_next_usage(const uint8_t *report_descriptor, size_t size, unsigned int *pos, unsigned short *usage_page, unsigned short *usage)
+{
+	int data_len, key_size;
+	int initial = *pos == 0; /* Used to handle case where no top-level application collection is defined */
+	int usage_pair_ready = 0;
+
+	/* Usage is a Local Item, it must be set before each Main Item (Collection) before a pair is returned */
+	int usage_found = 0;
+
+	while (*pos < size) {
+		int key = report_descriptor[*pos];
+		int key_cmd = key & 0xfc;
+
+		/* Determine data_len and key_size */
+		if (!get_hid_item_size(report_descriptor, *pos, size, &data_len, &key_size))
+			return -1; /* malformed report */
+
+		switch (key_cmd) {
+		case 0x4: /* Usage Page 6.2.2.7 (Global) */
+			*usage_page = get_hid_report_bytes(report_descriptor, size, data_len, *pos);
+			break;
+
+		case 0x8: /* Usage 6.2.2.8 (Local) */
+			*usage = get_hid_report_bytes(report_descriptor, size, data_len, *pos);
+			usage_found = 1;
+			break;
+
+		case 0xa0: /* Collection 6.2.2.4 (Main) */
+			/* A Usage Item (Local) must be found for the pair to be valid */
+			if (usage_found)
+				usage_pair_ready = 1;
+
+			/* Usage is a Local Item, unset it */
+			usage_found = 0;
+			break;
+
+		case 0x80: /* Input 6.2.2.4 (Main) */
+		case 0x90: /* Output 6.2.2.4 (Main) */
+		case 0xb0: /* Feature 6.2.2.4 (Main) */
+		case 0xc0: /* End Collection 6.2.2.4 (Main) */
+			/* Usage is a Local Item, unset it */
+			usage_found = 0;
+			break;
+		}
+
+		/* Skip over this key and its associated data */
+		*pos += data_len + key_size;
+
+		/* Return usage pair */
+		if (usage_pair_ready)
+			return 0;
+	}
+
+	/* If no top-level application collection is found and usage page/usage pair is found, pair is valid
+	   https://docs.microsoft.com/en-us/windows-hardware/drivers/hid/top-level-collections */
+	if (initial && usage_found)
+		return 0; /* success */
+
+	return 1; /* finished processing */
+}
+
+/* The values of a Global item, which is signed or not depending on the
+   other items, so it is kept as read (see item_value_signed()) */
+struct item_value {
+	uint32_t value;
+	int data_len;
+};
+
+/* The Global items in scope, saved and restored by Push and Pop */
+struct global_state {
+	uint16_t usage_page;
+	struct item_value logical_minimum;
+	struct item_value logical_maximum;
+	struct item_value physical_minimum;
+	struct item_value physical_maximum;
+	uint32_t report_size;
+	uint32_t report_count;
+	uint8_t report_id;
+};
+
+/* A Usage item (minimum == maximum) or a Usage Minimum/Maximum pair.
+   The page is the one in the item for extended (4 bytes) usages,
+   otherwise the Usage Page in scope at the Main item. */
+struct usage_range {
+	int extended;
+	uint16_t page;
+	uint16_t minimum;
+	uint16_t maximum;
+};
+
+#define GLOBAL_STACK_DEPTH 8
+
+/* A report under construction, bits counts the report ID byte */
+struct report_state {
+	uint8_t report_id;
+	uint8_t report_type;
+	uint32_t bits;
+	unsigned int num_fields;
+};
+
+struct layout_compiler {
+	struct global_state global;
+	struct global_state stack[GLOBAL_STACK_DEPTH];
+	int stack_depth;
+
+	/* The Local items, reset by each Main item */
+	struct usage_range *usages;
+	size_t num_usages;
+	size_t max_usages;
+	struct item_value usage_minimum;
+	int have_usage_minimum;
+
+	struct report_state *reports;
+	size_t num_reports;
+	size_t max_reports;
+	/* Index of each report in reports, -1 if not seen yet */
+	short report_index[3][256];
+	int uses_report_ids;
+
+	/* In the order of the descriptor, grouped by report at the end */
+	struct hid_report_field *fields;
+	size_t num_fields;
+	size_t max_fields;
+};
+
+/* Grows an array of the compiler, returns -1 on memory allocation failure */
+static int grow_array(void **array, size_t *max_elements, size_t element_size)
+{
+	size_t new_max = *max_elements? *max_elements * 2: 16;
+	void *new_array = realloc(*array, new_max * element_size);
+	if (!new_array)
+		return -1;
+	*array = new_array;
+	*max_elements = new_max;
+	return 0;
+}
+
+static int32_t item_value_signed(struct item_value value)
+{
+	switch (value.data_len) {
+	case 1:
+		return (int8_t) value.value;
+	case 2:
+		return (int16_t) value.value;
+	default:
+		return (int32_t) value.value;
+	}
+}
+
+/* The minimum is signed, the maximum too when the minimum is negative
+   (a positive maximum may have been written without its sign bit) */
+static void get_range(struct item_value minimum, struct item_value maximum, int *min_value, int *max_value)
+{
+	*min_value = item_value_signed(minimum);
+	*max_value = (*min_value < 0)? item_value_signed(maximum): (int) maximum.value;
+}
+
+static int add_usage(struct layout_compiler *compiler, uint32_t minimum, uint32_t maximum, int data_len)
+{
+	struct usage_range *range;
+
+	if (compiler->num_usages == compiler->max_usages
+	 && grow_array((void**) &compiler->usages, &compiler->max_usages, sizeof(*compiler->usages)) < 0)
+		return -1;
+
+	range = &compiler->usages[compiler->num_usages++];
+	range->extended = (data_len == 4);
+	range->page = (uint16_t) (maximum >> 16);
+	range->minimum = (uint16_t) minimum;
+	range->maximum = (uint16_t) maximum;
+	if (range->maximum < range->minimum)
+		range->maximum = range->minimum;
+
+	return 0;
+}
+
+static int get_report(struct layout_compiler *compiler, uint8_t report_type, uint8_t report_id, struct report_state **report)
+{
+	short index = compiler->report_index[report_type][report_id];
+
+	if (index < 0) {
+		if (compiler->num_reports == compiler->max_reports
+		 && grow_array((void**) &compiler->reports, &compiler->max_reports, sizeof(*compiler->reports)) < 0)
+			return -1;
+
+		index = (short) compiler->num_reports++;
+		compiler->report_index[report_type][report_id] = index;
+		compiler->reports[index].report_id = report_id;
+		compiler->reports[index].report_type = report_type;
+		compiler->reports[index].bits = report_id? 8: 0;
+		compiler->reports[index].num_fields = 0;
+	}
+
+	*report = &compiler->reports[index];
+	return 0;
+}
+
+static int add_field(struct layout_compiler *compiler, struct report_state *report, const struct hid_report_field *field)
+{
+	if (compiler->num_fields == compiler->max_fields
+	 && grow_array((void**) &compiler->fields, &compiler->max_fields, sizeof(*compiler->fields)) < 0)
+		return -1;
+
+	compiler->fields[compiler->num_fields++] = *field;
+	report->num_fields++;
+	return 0;
+}
+
+/* Adds the fields of an Input, Output or Feature item.
+   Returns -1 on memory allocation failure, -2 if the item is malformed. */
+static int add_main_item(struct layout_compiler *compiler, uint8_t report_type, uint32_t data)
+{
+	const struct global_state *global = &compiler->global;
+	struct report_state *report;
+	struct hid_report_field field;
+	uint64_t bits = (uint64_t) global->report_size * global->report_count;
+
+	if (get_report(compiler, report_type, global->report_id, &report) < 0)
+		return -1;
+
+	if (global->report_size > 0xFFFF || report->bits + bits > 0xFFFFFF)
+		return -2;
+
+	if (bits == 0)
+		return 0;
+
+	memset(&field, 0, sizeof(field));
+	field.report_id = global->report_id;
+	field.report_type = report_type;
+	field.flags = (unsigned short) (data & 0x1FF);
+	field.report_size = (unsigned short) global->report_size;
+	field.report_count = global->report_count;
+	field.bit_offset = report->bits;
+	get_range(global->logical_minimum, global->logical_maximum, &field.logical_minimum, &field.logical_maximum);
+	get_range(global->physical_minimum, global->physical_maximum, &field.physical_minimum, &field.physical_maximum);
+	if (field.physical_minimum == 0 && field.physical_maximum == 0) {
+		field.physical_minimum = field.logical_minimum;
+		field.physical_maximum = field.logical_maximum;
+	}
+
+	report->bits += (uint32_t) bits;
+
+	if (compiler->num_usages == 0) {
+		/* e.g. padding */
+		return add_field(compiler, report, &field);
+	}
+
+	if (!(data & HID_API_FIELD_VARIABLE)) {
+		/* Array: the elements select among the usages (of the first page) */
+		size_t i;
+
+		field.usage_page = compiler->usages[0].extended? compiler->usages[0].page: global->usage_page;
+		field.usage_minimum = compiler->usages[0].minimum;
+		field.usage_maximum = compiler->usages[0].maximum;
+		for (i = 1; i < compiler->num_usages; i++) {
+			const struct usage_range *range = &compiler->usages[i];
+			if ((range->extended? range->page: global->usage_page) != field.usage_page)
+				continue;
+			if (range->minimum < field.usage_minimum)
+				field.usage_minimum = range->minimum;
+			if (range->maximum > field.usage_maximum)
+				field.usage_maximum = range->maximum;
+		}
+		return add_field(compiler, report, &field);
+	}
+	else {
+		/* Variable: the elements take the usages one after the other,
+		   the last one being repeated. The elements with consecutive
+		   usages (then repeated ones) make a field. */
+		size_t range_index = 0;
+		uint32_t range_offset = 0;
+		uint32_t count = field.report_count;
+		uint32_t i;
+		int repeating = 0;
+
+		field.report_count = 0;
+
+		for (i = 0; i < count; i++) {
+			const struct usage_range *range = &compiler->usages[range_index];
+			uint16_t page = range->extended? range->page: global->usage_page;
+			uint16_t usage = (uint16_t) (range->minimum + range_offset);
+
+			/* Next usage, the last one stays */
+			if (range->minimum + range_offset < range->maximum) {
+				range_offset++;
+			}
+			else if (range_index + 1 < compiler->num_usages) {
+				range_index++;
+				range_offset = 0;
+			}
+
+			if (field.report_count > 0 && page == field.usage_page) {
+				if (usage == field.usage_maximum) {
+					repeating = 1;
+					field.report_count++;
+					continue;
+				}
+				if (!repeating && usage == field.usage_maximum + 1) {
+					field.usage_maximum = usage;
+					field.report_count++;
+					continue;
+				}
+			}
+
+			if (field.report_count > 0 && add_field(compiler, report, &field) < 0)
+				return -1;
+
+			field.bit_offset = report->bits - (uint32_t) bits + i * global->report_size;
+			field.usage_page = page;
+			field.usage_minimum = usage;
+			field.usage_maximum = usage;
+			field.report_count = 1;
+			repeating = 0;
+		}
+
+		return add_field(compiler, report, &field);
+	}
+}
+
+/* Builds the single allocation returned by hidapi_compile_report_layout() */
+static struct hid_report_layout *pack_layout(struct layout_compiler *compiler)
+{
+	struct hid_report_layout *layout;
+	struct hid_report_info *reports;
+	struct hid_report_field *fields;
+	unsigned int *next_field;
+	size_t i;
+
+	layout = (struct hid_report_layout*) malloc(sizeof(*layout)
+		+ compiler->num_reports * sizeof(*reports)
+		+ compiler->num_fields * sizeof(*fields));
+	next_field = (unsigned int*) calloc(compiler->num_reports + 1, sizeof(*next_field));
+	if (!layout || !next_field) {
+		free(layout);
+		free(next_field);
+		return NULL;
+	}
+
+	reports = (struct hid_report_info*) (layout + 1);
+	fields = (struct hid_report_field*) (reports + compiler->num_reports);
+
+	for (i = 0; i < compiler->num_reports; i++) {
+		const struct report_state *report = &compiler->reports[i];
+
+		reports[i].report_id = report->report_id;
+		reports[i].report_type = report->report_type;
+		reports[i].size = (report->bits + 7) / 8;
+		reports[i].first_field = i? reports[i - 1].first_field + reports[i - 1].num_fields: 0;
+		reports[i].num_fields = report->num_fields;
+		next_field[i] = reports[i].first_field;
+	}
+
+	/* Group the fields by report, keeping their order */
+	for (i = 0; i < compiler->num_fields; i++) {
+		const struct hid_report_field *field = &compiler->fields[i];
+		short index = compiler->report_index[field->report_type][field->report_id];
+
+		fields[next_field[index]++] = *field;
+	}
+
+	free(next_field);
+
+	layout->reports = reports;
+	layout->num_reports = compiler->num_reports;
+	layout->fields = fields;
+	layout->num_fields = compiler->num_fields;
+	layout->uses_report_ids = compiler->uses_report_ids;
+
+	return layout;
+}
+
+/* See hidapi_report_descriptor.h */
+struct hid_report_layout *hidapi_compile_report_layout(const uint8_t *report_descriptor, size_t size)
+{
+	struct layout_compiler *compiler;
+	struct hid_report_layout *layout = NULL;
+	unsigned int pos = 0;
+	int res = 0;
+
+	compiler = (struct layout_compiler*) calloc(1, sizeof(*compiler));
+	if (!compiler) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	memset(compiler->report_index, 0xFF, sizeof(compiler->report_index));
+
+	while (pos < size && res == 0) {
+		int key = report_descriptor[pos];
+		int data_len, key_size;
+		uint32_t data;
+
+		if (!get_hid_item_size(report_descriptor, pos, size, &data_len, &key_size)
+		 || pos + key_size + data_len > size) {
+			res = -2;
+			break;
+		}
+
+		data = get_hid_report_bytes(report_descriptor, size, data_len, pos);
+
+		/* Long Items aren't defined by the specification, they are skipped */
+		if ((key & 0xf0) != 0xf0) {
+			switch (key & 0xfc) {
+			/* Main items 6.2.2.4 */
+			case 0x80: /* Input */
+				res = add_main_item(compiler, HID_API_REPORT_INPUT, data);
+				break;
+			case 0x90: /* Output */
+				res = add_main_item(compiler, HID_API_REPORT_OUTPUT, data);
+				break;
+			case 0xb0: /* Feature */
+				res = add_main_item(compiler, HID_API_REPORT_FEATURE, data);
+				break;
+			case 0xa0: /* Collection */
+			case 0xc0: /* End Collection */
+				break;
+
+			/* Global items 6.2.2.7 */
+			case 0x04: /* Usage Page */
+				compiler->global.usage_page = (uint16_t) data;
+				break;
+			case 0x14: /* Logical Minimum */
+				compiler->global.logical_minimum.value = data;
+				compiler->global.logical_minimum.data_len = data_len;
+				break;
+			case 0x24: /* Logical Maximum */
+				compiler->global.logical_maximum.value = data;
+				compiler->global.logical_maximum.data_len = data_len;
+				break;
+			case 0x34: /* Physical Minimum */
+				compiler->global.physical_minimum.value = data;
+				compiler->global.physical_minimum.data_len = data_len;
+				break;
+			case 0x44: /* Physical Maximum */
+				compiler->global.physical_maximum.value = data;
+				compiler->global.physical_maximum.data_len = data_len;
+				break;
+			case 0x74: /* Report Size */
+				compiler->global.report_size = data;
+				break;
+			case 0x84: /* Report ID */
+				if (data == 0 || data > 0xFF)
+					res = -2;
+				compiler->global.report_id = (uint8_t) data;
+				compiler->uses_report_ids = 1;
+				break;
+			case 0x94: /* Report Count */
+				compiler->global.report_count = data;
+				break;
+			case 0xa4: /* Push */
+				if (compiler->stack_depth == GLOBAL_STACK_DEPTH)
+					res = -2;
+				else
+					compiler->stack[compiler->stack_depth++] = compiler->global;
+				break;
+			case 0xb4: /* Pop */
+				if (compiler->stack_depth == 0)
+					res = -2;
+				else
+					compiler->global = compiler->stack[--compiler->stack_depth];
+				break;
+
+			/* Local items 6.2.2.8 */
+			case 0x08: /* Usage */
+				res = add_usage(compiler, data, data, data_len);
+				break;
+			case 0x18: /* Usage Minimum */
+				compiler->usage_minimum.value = data;
+				compiler->usage_minimum.data_len = data_len;
+				compiler->have_usage_minimum = 1;
+				break;
+			case 0x28: /* Usage Maximum */
+				if (compiler->have_usage_minimum)
+					res = add_usage(compiler, compiler->usage_minimum.value, data, data_len);
+				compiler->have_usage_minimum = 0;
+				break;
+
+			default:
+				/* Unit, Unit Exponent, designators, strings, delimiters */
+				break;
+			}
+
+			/* The Local items only apply to the next Main item */
+			if ((key & 0x0c) == 0x00) {
+				compiler->num_usages = 0;
+				compiler->have_usage_minimum = 0;
+			}
+		}
+
+		pos += data_len + key_size;
+	}
+
+	if (res == 0) {
+		layout = pack_layout(compiler);
+		if (!layout)
+			res = -1;
+	}
+
+	free(compiler->usages);
+	free(compiler->reports);
+	free(compiler->fields);
+	free(compiler);
+
+	if (res < 0)
+		errno = (res == -2)? EINVAL: ENOMEM;
+
+	return layout;
+}
+
+/* Little-endian loads, a single load on the usual targets */
+static uint32_t load_le16(const uint8_t *p)
+{
+	return (uint32_t) p[0] | ((uint32_t) p[1] << 8);
+}
+
+static uint32_t load_le32(const uint8_t *p)
+{
+	return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static uint64_t load_le64(const uint8_t *p)
+{
+	return (uint64_t) load_le32(p) | ((uint64_t) load_le32(p + 4) << 32);
+}
+
+/* The 64 bits from the given byte, the bytes past the end being 0 */
+static uint64_t load_bits(const uint8_t *report, size_t length, size_t byte)
+{
+	uint64_t window = 0;
+	size_t i;
+
+	if (byte + 8 <= length)
+		return load_le64(report + byte);
+
+	for (i = 0; byte + i < length && i < 8; i++)
+		window |= (uint64_t) report[byte + i] << (8 * i);
+	return window;
+}
+
+/* Any element size and position, the report may be short */
+static void decode_elements(const uint8_t *report, size_t length, size_t bit, unsigned int size, uint32_t count, int *values)
+{
+	uint32_t mask = (size >= 32)? 0xFFFFFFFF: (1u << size) - 1;
+	uint32_t i;
+
+	for (i = 0; i < count; i++, bit += size)
+		values[i] = (int) ((uint32_t) (load_bits(report, length, bit >> 3) >> (bit & 7)) & mask);
+}
+
+/* 1-bit elements (buttons), a byte at a time once aligned */
+static void decode_bits(const uint8_t *report, size_t bit, uint32_t count, int *values)
+{
+	uint32_t i = 0;
+
+	for (; i < count && (bit & 7); i++, bit++)
+		values[i] = (report[bit >> 3] >> (bit & 7)) & 1;
+
+	for (; count - i >= 8; i += 8, bit += 8) {
+		unsigned int byte = report[bit >> 3];
+		values[i] = byte & 1;
+		values[i + 1] = (byte >> 1) & 1;
+		values[i + 2] = (byte >> 2) & 1;
+		values[i + 3] = (byte >> 3) & 1;
+		values[i + 4] = (byte >> 4) & 1;
+		values[i + 5] = (byte >> 5) & 1;
+		values[i + 6] = (byte >> 6) & 1;
+		values[i + 7] = (byte >> 7) & 1;
+	}
+
+	for (; i < count; i++, bit++)
+		values[i] = (report[bit >> 3] >> (bit & 7)) & 1;
+}
+
+/* Byte aligned 12-bit elements (sensor samples), two per three bytes */
+static void decode_12bit(const uint8_t *report, size_t bit, uint32_t count, int *values)
+{
+	const uint8_t *p = report + (bit >> 3);
+	uint32_t i;
+
+	for (i = 0; i + 2 <= count; i += 2, p += 3) {
+		values[i] = p[0] | ((p[1] & 0x0F) << 8);
+		values[i + 1] = (p[1] >> 4) | (p[2] << 4);
+	}
+
+	if (i < count)
+		values[i] = p[0] | ((p[1] & 0x0F) << 8);
+}
+
+static void decode_field(const struct hid_report_field *field, const uint8_t *report, size_t length, int *values)
+{
+	unsigned int size = field->report_size;
+	uint32_t count = field->report_count;
+	size_t bit = field->bit_offset;
+	uint32_t i;
+
+	if (bit + (uint64_t) size * count > (uint64_t) length * 8) {
+		/* Short report */
+		decode_elements(report, length, bit, size, count, values);
+	}
+	else if (size == 1) {
+		decode_bits(report, bit, count, values);
+	}
+	else if ((bit & 7) == 0 && size == 8) {
+		for (i = 0; i < count; i++)
+			values[i] = report[(bit >> 3) + i];
+	}
+	else if ((bit & 7) == 0 && size == 12) {
+		decode_12bit(report, bit, count, values);
+	}
+	else if ((bit & 7) == 0 && size == 16) {
+		for (i = 0; i < count; i++)
+			values[i] = (int) load_le16(report + (bit >> 3) + 2 * i);
+	}
+	else if ((bit & 7) == 0 && size == 32) {
+		for (i = 0; i < count; i++)
+			values[i] = (int) load_le32(report + (bit >> 3) + 4 * i);
+	}
+	else {
+		decode_elements(report, length, bit, size, count, values);
+	}
+
+	if (field->logical_minimum < 0 && size < 32) {
+		uint32_t sign = 1u << (size - 1);
+		for (i = 0; i < count; i++)
+			values[i] = (int) (((uint32_t) values[i] ^ sign) - sign);
+	}
+}
+
+/* See hidapi_report_descriptor.h */
+int hidapi_decode_report(const struct hid_report_layout *layout, const uint8_t *report, size_t length, int *values, size_t max_values)
+{
+	const struct hid_report_info *info = NULL;
+	uint8_t report_id = 0;
+	size_t num_values = 0;
+	unsigned int i;
+
+	if (!layout || !report || (layout->uses_report_ids && length == 0)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (layout->uses_report_ids)
+		report_id = report[0];
+
+	for (i = 0; i < layout->num_reports && !info; i++) {
+		if (layout->reports[i].report_type == HID_API_REPORT_INPUT && layout->reports[i].report_id == report_id)
+			info = &layout->reports[i];
+	}
+
+	if (!info) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	for (i = 0; i < info->num_fields; i++)
+		num_values += layout->fields[info->first_field + i].report_count;
+
+	if (num_values > max_values || (num_values && !values)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	num_values = 0;
+	for (i = 0; i < info->num_fields; i++) {
+		const struct hid_report_field *field = &layout->fields[info->first_field + i];
+
+		decode_field(field, report, length, values + num_values);
+		num_values += field->report_count;
+	}
+
+	return (int) num_values;
+}
@@ -0,0 +1,59 @@
+/*******************************************************
+ HIDAPI - Multi-Platform library for
+ communication with HID devices.
+
+ libusb/hidapi Team
+
+ Copyright 2023, All Rights Reserved.
+
+ At the discretion of the user of this library,
+ this software may be licensed under the terms of the
+ GNU General Public License v3, a BSD-Style license, or the
+ original HIDAPI license as outlined in the LICENSE.txt,
+ LICENSE-gpl3.txt, LICENSE-bsd.txt, and LICENSE-orig.txt
+ files located at the root of the source distribution.
+ These files may also be found in the public source
+ code repository located at:
+        https://github.com/libusb/hidapi .
+********************************************************/
+
+#ifndef HIDAPI_REPORT_DESCRIPTOR_H
+#define HIDAPI_REPORT_DESCRIPTOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hidapi.h"
+
+/* Internal report descriptor parsing shared by the backends,
+   not part of the public API. */
+
+/*
+ * Retrieves the device's Usage Page and Usage from the report descriptor.
+ * The algorithm returns the current Usage Page/Usage pair whenever a new
+ * Collection is found and a Usage Local Item is currently in scope.
+ * Usage Local Items are consumed by each Main Item (See. 6.2.2.8).
+ * The algorithm should give similar results as Apple's:
+ *   https://developer.apple.com/documentation/iokit/kiohiddeviceusagepairskey?language=objc
+ * Physical Collections are also matched (macOS does the same).
+ *
+ * This function can be called repeatedly until it returns non-0
+ * Usage is found. pos is the starting point (initially 0) and will be updated
+ * to the next search position.
+ *
+ * The return value is 0 when a pair is found.
+ * 1 when finished processing descriptor.
+ * -1 on a malformed report.
+ */
+int hidapi_get_next_usage(const uint8_t *report_descriptor, size_t size, unsigned int *pos, unsigned short *usage_page, unsigned short *usage);
+
+/* Compiles a report descriptor into the table of its reports and fields,
+   see hid_get_report_layout(). The layout is a single allocation, to be
+   freed with free(). Returns NULL if the descriptor is malformed (errno
+   is EINVAL) or the memory allocation fails (errno is ENOMEM). */
+struct hid_report_layout *hidapi_compile_report_layout(const uint8_t *report_descriptor, size_t size);
+
+/* See hid_decode_report(). On error, returns -1 with errno set to EINVAL. */
+int hidapi_decode_report(const struct hid_report_layout *layout, const uint8_t *report, size_t length, int *values, size_t max_values);
+
+#endif /* HIDAPI_REPORT_DESCRIPTOR_H */
@@ -0,0 +1,217 @@
+/*******************************************************
+ HIDAPI - Multi-Platform library for
+ communication with HID devices.
+
+ libusb/hidapi Team
+
+ Copyright 2023, All Rights Reserved.
+
+ At the discretion of the user of this library,
+ this software may be licensed under the terms of the
+ GNU General Public License v3, a BSD-Style license, or the
+ original HIDAPI license as outlined in the LICENSE.txt,
+ LICENSE-gpl3.txt, LICENSE-bsd.txt, and LICENSE-orig.txt
+ files located at the root of the source distribution.
+ These files may also be found in the public source
+ code repository located at:
+        https://github.com/libusb/hidapi .
+********************************************************/
+
+#include "hidapi_utf.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define REPLACEMENT_CHARACTER 0xFFFD
+
+/* The ASCII fast path looks at 8 bytes at a time: if none of them
+   has a bit outside of the ASCII range set, they are all copied
+   without further checks. The loads go through memcpy(), so the
+   input doesn't have to be aligned. */
+#define ASCII_BLOCK 8
+
+/* The bits which are never set in ASCII: the top bit of each UTF-8 byte,
+   everything above 0x7F in each UTF-16LE code unit */
+static const unsigned char utf8_non_ascii_bits[ASCII_BLOCK] = {
+	0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80
+};
+static const unsigned char utf16le_non_ascii_bits[ASCII_BLOCK] = {
+	0x80, 0xFF, 0x80, 0xFF, 0x80, 0xFF, 0x80, 0xFF
+};
+
+static int is_ascii_block(const unsigned char *src, const unsigned char *non_ascii_bits)
+{
+	uint64_t block;
+	uint64_t mask;
+
+	memcpy(&block, src, sizeof(block));
+	memcpy(&mask, non_ascii_bits, sizeof(mask));
+
+	return (block & mask) == 0;
+}
+
+/* Stores a code point, as a surrogate pair if wchar_t is 16 bits wide.
+   Returns the number of wchar_t written. */
+static size_t put_code_point(wchar_t *dst, uint32_t cp)
+{
+#if WCHAR_MAX > 0xFFFF
+	dst[0] = (wchar_t) cp;
+	return 1;
+#else
+	if (cp < 0x10000) {
+		dst[0] = (wchar_t) cp;
+		return 1;
+	}
+	cp -= 0x10000;
+	dst[0] = (wchar_t) (0xD800 | (cp >> 10));
+	dst[1] = (wchar_t) (0xDC00 | (cp & 0x3FF));
+	return 2;
+#endif
+}
+
+wchar_t *hidapi_utf16le_to_wchar(const unsigned char *utf16le, size_t len)
+{
+	size_t units = len / 2;
+	size_t i = 0;
+	size_t out = 0;
+	wchar_t *ret;
+
+	/* Never more wchar_t than there are UTF-16 code units */
+	ret = (wchar_t*) malloc((units + 1) * sizeof(wchar_t));
+	if (!ret)
+		return NULL;
+
+	while (i < units) {
+		uint32_t cp;
+
+		if (units - i >= ASCII_BLOCK / 2 && is_ascii_block(utf16le + i * 2, utf16le_non_ascii_bits)) {
+			ret[out++] = utf16le[i * 2];
+			ret[out++] = utf16le[i * 2 + 2];
+			ret[out++] = utf16le[i * 2 + 4];
+			ret[out++] = utf16le[i * 2 + 6];
+			i += ASCII_BLOCK / 2;
+			continue;
+		}
+
+		cp = utf16le[i * 2] | (utf16le[i * 2 + 1] << 8);
+		i++;
+
+		if (cp >= 0xD800 && cp <= 0xDBFF) {
+			/* A high surrogate must be followed by a low one */
+			uint32_t low = (i < units)? (uint32_t) (utf16le[i * 2] | (utf16le[i * 2 + 1] << 8)): 0;
+			if (low >= 0xDC00 && low <= 0xDFFF) {
+				cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+				i++;
+			}
+			else {
+				cp = REPLACEMENT_CHARACTER;
+			}
+		}
+		else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+			cp = REPLACEMENT_CHARACTER;
+		}
+
+		out += put_code_point(ret + out, cp);
+	}
+
+	ret[out] = 0x0000;
+
+	return ret;
+}
+
+/* Decodes a single UTF-8 sequence at src (of at most len bytes).
+   Returns the number of bytes used, the code point goes into *cp. */
+static size_t decode_utf8(const unsigned char *src, size_t len, uint32_t *cp)
+{
+	uint32_t c = src[0];
+	uint32_t min;
+	size_t n;
+	size_t i;
+
+	if (c < 0x80) {
+		*cp = c;
+		return 1;
+	}
+	else if (c >= 0xC2 && c <= 0xDF) {
+		n = 2;
+		min = 0x80;
+		c &= 0x1F;
+	}
+	else if (c >= 0xE0 && c <= 0xEF) {
+		n = 3;
+		min = 0x800;
+		c &= 0x0F;
+	}
+	else if (c >= 0xF0 && c <= 0xF4) {
+		n = 4;
+		min = 0x10000;
+		c &= 0x07;
+	}
+	else {
+		/* Continuation byte, or a lead byte that can only start an overlong sequence */
+		*cp = REPLACEMENT_CHARACTER;
+		return 1;
+	}
+
+	if (n > len) {
+		*cp = REPLACEMENT_CHARACTER;
+		return 1;
+	}
+
+	for (i = 1; i < n; i++) {
+		if ((src[i] & 0xC0) != 0x80) {
+			*cp = REPLACEMENT_CHARACTER;
+			return 1;
+		}
+		c = (c << 6) | (src[i] & 0x3F);
+	}
+
+	/* Overlong forms, surrogates and values past U+10FFFF aren't valid UTF-8 */
+	if (c < min || (c >= 0xD800 && c <= 0xDFFF) || c > 0x10FFFF) {
+		*cp = REPLACEMENT_CHARACTER;
+		return 1;
+	}
+
+	*cp = c;
+	return n;
+}
+
+wchar_t *hidapi_utf8_to_wchar(const char *utf8)
+{
+	const unsigned char *src = (const unsigned char *) utf8;
+	size_t len;
+	size_t i = 0;
+	size_t out = 0;
+	wchar_t *ret;
+
+	if (!utf8)
+		return NULL;
+
+	len = strlen(utf8);
+
+	/* Never more wchar_t than there are bytes:
+	   a surrogate pair takes 2 wchar_t but 4 bytes of UTF-8 */
+	ret = (wchar_t*) malloc((len + 1) * sizeof(wchar_t));
+	if (!ret)
+		return NULL;
+
+	while (i < len) {
+		uint32_t cp;
+
+		if (len - i >= ASCII_BLOCK && is_ascii_block(src + i, utf8_non_ascii_bits)) {
+			size_t k;
+			for (k = 0; k < ASCII_BLOCK; k++)
+				ret[out++] = src[i + k];
+			i += ASCII_BLOCK;
+			continue;
+		}
+
+		i += decode_utf8(src + i, len - i, &cp);
+		out += put_code_point(ret + out, cp);
+	}
+
+	ret[out] = 0x0000;
+
+	return ret;
+}
@@ -0,0 +1,42 @@
+/*******************************************************
+ HIDAPI - Multi-Platform library for
+ communication with HID devices.
+
+ libusb/hidapi Team
+
+ Copyright 2023, All Rights Reserved.
+
+ At the discretion of the user of this library,
+ this software may be licensed under the terms of the
+ GNU General Public License v3, a BSD-Style license, or the
+ original HIDAPI license as outlined in the LICENSE.txt,
+ LICENSE-gpl3.txt, LICENSE-bsd.txt, and LICENSE-orig.txt
+ files located at the root of the source distribution.
+ These files may also be found in the public source
+ code repository located at:
+        https://github.com/libusb/hidapi .
+********************************************************/
+
+#ifndef HIDAPI_UTF_H
+#define HIDAPI_UTF_H
+
+#include <stddef.h>
+#include <wchar.h>
+
+/* Internal helpers shared by the backends, not part of the public API.
+
+   Both functions return a newly allocated, NULL-terminated wide string
+   (to be freed with free()), or NULL if the memory allocation fails.
+   The conversion doesn't depend on the current locale: wchar_t holds
+   UTF-32 code points, or UTF-16 code units where wchar_t is 16 bits wide.
+   Malformed input (unpaired surrogates, invalid UTF-8 sequences)
+   is replaced by U+FFFD. */
+
+/* Converts len bytes of UTF-16LE, as found in USB string descriptors.
+   An odd trailing byte is ignored. */
+wchar_t *hidapi_utf16le_to_wchar(const unsigned char *utf16le, size_t len);
+
+/* Converts a NULL-terminated UTF-8 string. Returns NULL if utf8 is NULL. */
+wchar_t *hidapi_utf8_to_wchar(const char *utf8);
+
+#endif /* HIDAPI_UTF_H */
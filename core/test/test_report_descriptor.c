@@ -0,0 +1,274 @@
+/*******************************************************
+ HIDAPI - Multi-Platform library for
+ communication with HID devices.
+
+ libusb/hidapi Team
+
+ Copyright 2023, All Rights Reserved.
+
+ At the discretion of the user of this library,
+ this software may be licensed under the terms of the
+ GNU General Public License v3, a BSD-Style license, or the
+ original HIDAPI license as outlined in the LICENSE.txt,
+ LICENSE-gpl3.txt, LICENSE-bsd.txt, and LICENSE-orig.txt
+ files located at the root of the source distribution.
+ These files may also be found in the public source
+ code repository located at:
+        https://github.com/libusb/hidapi .
+********************************************************/
+
+/* Tests of the report layout compiler and decoder of core/hidapi_report_descriptor.c */
+
+#include "hidapi_report_descriptor.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+		if (!(cond)) { \
+			printf("FAIL line %d: %s\n", __LINE__, #cond); \
+			failures++; \
+		} \
+	} while (0)
+
+/* A mouse with report IDs: an Input report 1 whose fields take every
+   decoding path, a Feature report 1 declared in the middle of it, and
+   an Input report 2 with an Array field */
+static const uint8_t mouse_descriptor[] = {
+	0x05, 0x01,             /* Usage Page (Generic Desktop) */
+	0x09, 0x02,             /* Usage (Mouse) */
+	0xA1, 0x01,             /* Collection (Application) */
+	0x85, 0x01,             /*   Report ID (1) */
+	0x05, 0x09,             /*   Usage Page (Button) */
+	0x19, 0x01,             /*   Usage Minimum (1) */
+	0x29, 0x05,             /*   Usage Maximum (5) */
+	0x15, 0x00,             /*   Logical Minimum (0) */
+	0x25, 0x01,             /*   Logical Maximum (1) */
+	0x75, 0x01,             /*   Report Size (1) */
+	0x95, 0x05,             /*   Report Count (5) */
+	0x81, 0x02,             /*   Input (Data, Variable, Absolute) */
+	0x75, 0x03,             /*   Report Size (3) */
+	0x95, 0x01,             /*   Report Count (1) */
+	0x81, 0x01,             /*   Input (Constant) */
+	0x06, 0x00, 0xFF,       /*   Usage Page (Vendor 0xFF00) */
+	0x09, 0x01,             /*   Usage (1) */
+	0x26, 0xFF, 0x00,       /*   Logical Maximum (255) */
+	0x75, 0x08,             /*   Report Size (8) */
+	0xB1, 0x02,             /*   Feature (Data, Variable, Absolute) */
+	0x05, 0x01,             /*   Usage Page (Generic Desktop) */
+	0x09, 0x30,             /*   Usage (X) */
+	0x09, 0x31,             /*   Usage (Y) */
+	0x15, 0x81,             /*   Logical Minimum (-127) */
+	0x25, 0x7F,             /*   Logical Maximum (127) */
+	0x95, 0x02,             /*   Report Count (2) */
+	0x81, 0x06,             /*   Input (Data, Variable, Relative) */
+	0x09, 0x32,             /*   Usage (Z) */
+	0x15, 0x00,             /*   Logical Minimum (0) */
+	0x26, 0xFF, 0x0F,       /*   Logical Maximum (4095) */
+	0x75, 0x0C,             /*   Report Size (12) */
+	0x81, 0x02,             /*   Input (Data, Variable, Absolute) */
+	0x09, 0x38,             /*   Usage (Wheel) */
+	0x16, 0x00, 0x80,       /*   Logical Minimum (-32768) */
+	0x26, 0xFF, 0x7F,       /*   Logical Maximum (32767) */
+	0x75, 0x10,             /*   Report Size (16) */
+	0x95, 0x01,             /*   Report Count (1) */
+	0x81, 0x06,             /*   Input (Data, Variable, Relative) */
+	0x85, 0x02,             /*   Report ID (2) */
+	0x05, 0x0C,             /*   Usage Page (Consumer) */
+	0x19, 0x00,             /*   Usage Minimum (0) */
+	0x2A, 0x9C, 0x02,       /*   Usage Maximum (0x29C) */
+	0x15, 0x00,             /*   Logical Minimum (0) */
+	0x26, 0x9C, 0x02,       /*   Logical Maximum (0x29C) */
+	0x81, 0x00,             /*   Input (Data, Array, Absolute) */
+	0xC0,                   /* End Collection */
+};
+
+static void check_field(const struct hid_report_field *field, unsigned short usage_page,
+	unsigned short usage_minimum, unsigned short usage_maximum, unsigned int bit_offset,
+	unsigned short report_size, unsigned int report_count, int logical_minimum, int logical_maximum)
+{
+	CHECK(field->usage_page == usage_page);
+	CHECK(field->usage_minimum == usage_minimum);
+	CHECK(field->usage_maximum == usage_maximum);
+	CHECK(field->bit_offset == bit_offset);
+	CHECK(field->report_size == report_size);
+	CHECK(field->report_count == report_count);
+	CHECK(field->logical_minimum == logical_minimum);
+	CHECK(field->logical_maximum == logical_maximum);
+	/* No Physical Minimum/Maximum in the descriptors */
+	CHECK(field->physical_minimum == logical_minimum);
+	CHECK(field->physical_maximum == logical_maximum);
+}
+
+static void test_compile(const struct hid_report_layout *layout)
+{
+	const struct hid_report_field *fields = layout->fields;
+	unsigned int i;
+
+	CHECK(layout->uses_report_ids);
+
+	CHECK(layout->num_reports == 3);
+	if (layout->num_reports != 3)
+		return;
+	CHECK(layout->reports[0].report_id == 1);
+	CHECK(layout->reports[0].report_type == HID_API_REPORT_INPUT);
+	CHECK(layout->reports[0].size == 9);
+	CHECK(layout->reports[0].first_field == 0);
+	CHECK(layout->reports[0].num_fields == 5);
+	CHECK(layout->reports[1].report_id == 1);
+	CHECK(layout->reports[1].report_type == HID_API_REPORT_FEATURE);
+	CHECK(layout->reports[1].size == 2);
+	CHECK(layout->reports[1].first_field == 5);
+	CHECK(layout->reports[1].num_fields == 1);
+	CHECK(layout->reports[2].report_id == 2);
+	CHECK(layout->reports[2].report_type == HID_API_REPORT_INPUT);
+	CHECK(layout->reports[2].size == 3);
+	CHECK(layout->reports[2].first_field == 6);
+	CHECK(layout->reports[2].num_fields == 1);
+
+	CHECK(layout->num_fields == 7);
+	if (layout->num_fields != 7)
+		return;
+	for (i = 0; i < 7; i++)
+		CHECK(fields[i].report_id == (i < 6? 1: 2));
+
+	/* The bit offsets count the report ID byte */
+	check_field(&fields[0], 0x09, 1, 5, 8, 1, 5, 0, 1);
+	CHECK(fields[0].flags == HID_API_FIELD_VARIABLE);
+	check_field(&fields[1], 0, 0, 0, 13, 3, 1, 0, 1);
+	CHECK(fields[1].flags == HID_API_FIELD_CONSTANT);
+	check_field(&fields[2], 0x01, 0x30, 0x31, 16, 8, 2, -127, 127);
+	CHECK(fields[2].flags == (HID_API_FIELD_VARIABLE | HID_API_FIELD_RELATIVE));
+	check_field(&fields[3], 0x01, 0x32, 0x32, 32, 12, 2, 0, 4095);
+	check_field(&fields[4], 0x01, 0x38, 0x38, 56, 16, 1, -32768, 32767);
+	check_field(&fields[5], 0xFF00, 1, 1, 8, 8, 1, 0, 255);
+	CHECK(fields[5].report_type == HID_API_REPORT_FEATURE);
+	check_field(&fields[6], 0x0C, 0, 0x29C, 8, 16, 1, 0, 0x29C);
+	CHECK(fields[6].flags == 0);
+}
+
+/* Stores the low bits of value at the given bit position, little-endian */
+static void put_bits(uint8_t *report, unsigned int bit, unsigned int size, int value)
+{
+	unsigned int i;
+
+	for (i = 0; i < size; i++, bit++) {
+		if (((unsigned int) value >> i) & 1)
+			report[bit >> 3] |= (uint8_t) (1u << (bit & 7));
+	}
+}
+
+/* Encodes the values with the layout of the report, for decoding them back */
+static size_t encode_report(const struct hid_report_layout *layout, unsigned int index, const int *values, uint8_t *report)
+{
+	const struct hid_report_info *info = &layout->reports[index];
+	unsigned int i, j;
+
+	memset(report, 0, info->size);
+	report[0] = info->report_id;
+	for (i = 0; i < info->num_fields; i++) {
+		const struct hid_report_field *field = &layout->fields[info->first_field + i];
+		for (j = 0; j < field->report_count; j++)
+			put_bits(report, field->bit_offset + j * field->report_size, field->report_size, *values++);
+	}
+
+	return info->size;
+}
+
+static void test_decode(const struct hid_report_layout *layout)
+{
+	/* buttons, padding, X, Y, Z, Z, wheel */
+	static const int values1[] = { 1, 0, 1, 1, 0, 0, -5, 100, 0xABC, 0x123, -300 };
+	static const int values2[] = { 0x29C };
+	uint8_t report[16];
+	int values[16];
+	size_t length;
+
+	if (layout->num_reports != 3)
+		return;
+
+	length = encode_report(layout, 0, values1, report);
+	CHECK(hidapi_decode_report(layout, report, length, values, 16) == 11);
+	CHECK(memcmp(values, values1, sizeof(values1)) == 0);
+
+	/* Not enough room */
+	errno = 0;
+	CHECK(hidapi_decode_report(layout, report, length, values, 10) == -1);
+	CHECK(errno == EINVAL);
+
+	/* The wheel past the end of a short report is 0 */
+	CHECK(hidapi_decode_report(layout, report, length - 2, values, 16) == 11);
+	CHECK(memcmp(values, values1, 10 * sizeof(int)) == 0);
+	CHECK(values[10] == 0);
+
+	length = encode_report(layout, 2, values2, report);
+	CHECK(hidapi_decode_report(layout, report, length, values, 16) == 1);
+	CHECK(values[0] == 0x29C);
+
+	/* No Input report 3 */
+	report[0] = 3;
+	errno = 0;
+	CHECK(hidapi_decode_report(layout, report, length, values, 16) == -1);
+	CHECK(errno == EINVAL);
+}
+
+static void test_no_report_ids(void)
+{
+	static const uint8_t descriptor[] = {
+		0x05, 0x01, 0x09, 0x30, 0x15, 0x00, 0x25, 0x0A,
+		0x75, 0x04, 0x95, 0x01, 0x81, 0x02,
+	};
+	static const uint8_t report[] = { 0x37 };
+	struct hid_report_layout *layout = hidapi_compile_report_layout(descriptor, sizeof(descriptor));
+	int value = -1;
+
+	CHECK(layout != NULL);
+	if (!layout)
+		return;
+
+	CHECK(!layout->uses_report_ids);
+	CHECK(layout->num_reports == 1 && layout->reports[0].report_id == 0 && layout->reports[0].size == 1);
+	CHECK(layout->num_fields == 1 && layout->fields[0].bit_offset == 0);
+	CHECK(hidapi_decode_report(layout, report, sizeof(report), &value, 1) == 1);
+	CHECK(value == 7);
+
+	free(layout);
+}
+
+static void test_malformed(void)
+{
+	static const uint8_t truncated[] = { 0x05, 0x01, 0x26, 0xFF };
+	static const uint8_t report_id_0[] = { 0x85, 0x00 };
+	static const uint8_t pop_without_push[] = { 0x05, 0x01, 0xB4 };
+
+	errno = 0;
+	CHECK(hidapi_compile_report_layout(truncated, sizeof(truncated)) == NULL && errno == EINVAL);
+	errno = 0;
+	CHECK(hidapi_compile_report_layout(report_id_0, sizeof(report_id_0)) == NULL && errno == EINVAL);
+	errno = 0;
+	CHECK(hidapi_compile_report_layout(pop_without_push, sizeof(pop_without_push)) == NULL && errno == EINVAL);
+}
+
+int main(void)
+{
+	struct hid_report_layout *layout = hidapi_compile_report_layout(mouse_descriptor, sizeof(mouse_descriptor));
+
+	CHECK(layout != NULL);
+	if (layout) {
+		test_compile(layout);
+		test_decode(layout);
+		free(layout);
+	}
+	test_no_report_ids();
+	test_malformed();
+
+	if (failures) {
+		printf("%d failure(s)\n", failures);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,135 @@
+/*******************************************************
+ HIDAPI - Multi-Platform library for
+ communication with HID devices.
+
+ libusb/hidapi Team
+
+ Copyright 2023, All Rights Reserved.
+
+ At the discretion of the user of this library,
+ this software may be licensed under the terms of the
+ GNU General Public License v3, a BSD-Style license, or the
+ original HIDAPI license as outlined in the LICENSE.txt,
+ LICENSE-gpl3.txt, LICENSE-bsd.txt, and LICENSE-orig.txt
+ files located at the root of the source distribution.
+ These files may also be found in the public source
+ code repository located at:
+        https://github.com/libusb/hidapi .
+********************************************************/
+
+/* Tests of the UTF-8 and UTF-16LE conversions of core/hidapi_utf.c */
+
+#include "hidapi_utf.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <wchar.h>
+
+static int failures = 0;
+
+/* Compares a converted string with the expected code points,
+   which are encoded as surrogate pairs if wchar_t is 16 bits wide */
+static void check(const char *name, wchar_t *got, const uint32_t *expected, size_t count)
+{
+	wchar_t want[64];
+	size_t n = 0;
+	size_t i;
+
+	for (i = 0; i < count; i++) {
+#if WCHAR_MAX <= 0xFFFF
+		if (expected[i] >= 0x10000) {
+			want[n++] = (wchar_t) (0xD800 | ((expected[i] - 0x10000) >> 10));
+			want[n++] = (wchar_t) (0xDC00 | ((expected[i] - 0x10000) & 0x3FF));
+			continue;
+		}
+#endif
+		want[n++] = (wchar_t) expected[i];
+	}
+	want[n] = 0;
+
+	if (!got || wcscmp(got, want) != 0) {
+		printf("FAIL %s\n", name);
+		failures++;
+	}
+	free(got);
+}
+
+#define CHECK_UTF8(name, str, ...) do { \
+		static const uint32_t expected[] = { __VA_ARGS__ }; \
+		check(name, hidapi_utf8_to_wchar(str), expected, sizeof(expected) / sizeof(expected[0])); \
+	} while (0)
+
+#define CHECK_UTF16LE(name, bytes, ...) do { \
+		static const unsigned char src[] = bytes; \
+		static const uint32_t expected[] = { __VA_ARGS__ }; \
+		check(name, hidapi_utf16le_to_wchar(src, sizeof(src) - 1), expected, sizeof(expected) / sizeof(expected[0])); \
+	} while (0)
+
+static void test_utf8(void)
+{
+	wchar_t *empty = hidapi_utf8_to_wchar("");
+
+	if (hidapi_utf8_to_wchar(NULL) != NULL || !empty || empty[0] != 0) {
+		printf("FAIL utf8 NULL/empty\n");
+		failures++;
+	}
+	free(empty);
+
+	CHECK_UTF8("utf8 2/3/4 bytes", "\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80", 0xE9, 0x20AC, 0x1F600);
+	CHECK_UTF8("utf8 stray continuation", "a\x80z", 'a', 0xFFFD, 'z');
+	CHECK_UTF8("utf8 truncated at the end", "a\xE2\x82", 'a', 0xFFFD, 0xFFFD);
+	CHECK_UTF8("utf8 bad continuation", "\xE2(z", 0xFFFD, '(', 'z');
+	CHECK_UTF8("utf8 overlong", "\xC0\xAF\xE0\x80\xAF", 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD);
+	CHECK_UTF8("utf8 surrogate", "\xED\xA0\x80", 0xFFFD, 0xFFFD, 0xFFFD);
+	CHECK_UTF8("utf8 past U+10FFFF", "\xF4\x90\x80\x80", 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD);
+	CHECK_UTF8("utf8 highest", "\xF4\x8F\xBF\xBF", 0x10FFFF);
+
+	/* The ASCII fast path takes 8 bytes at a time */
+	CHECK_UTF8("utf8 7 ascii", "abcdefg", 'a', 'b', 'c', 'd', 'e', 'f', 'g');
+	CHECK_UTF8("utf8 8 ascii", "abcdefgh", 'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h');
+	CHECK_UTF8("utf8 9 ascii", "abcdefghi", 'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i');
+	CHECK_UTF8("utf8 non-ascii last in block", "abcdefg\xC3\xA9xyz", 'a', 'b', 'c', 'd', 'e', 'f', 'g', 0xE9, 'x', 'y', 'z');
+	CHECK_UTF8("utf8 non-ascii first in block", "\xC3\xA9" "abcdefghij", 0xE9, 'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j');
+	CHECK_UTF8("utf8 sequence across blocks", "abcdef\xE2\x82\xAC" "ghijklmnop",
+		'a', 'b', 'c', 'd', 'e', 'f', 0x20AC, 'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o', 'p');
+}
+
+static void test_utf16le(void)
+{
+	wchar_t *empty = hidapi_utf16le_to_wchar((const unsigned char *) "", 0);
+
+	if (!empty || empty[0] != 0) {
+		printf("FAIL utf16le empty\n");
+		failures++;
+	}
+	free(empty);
+
+	CHECK_UTF16LE("utf16le bmp", "\xE9\x00\xAC\x20", 0xE9, 0x20AC);
+	CHECK_UTF16LE("utf16le surrogate pair", "\x3D\xD8\x00\xDE", 0x1F600);
+	CHECK_UTF16LE("utf16le lone high", "\x3D\xD8" "a\x00", 0xFFFD, 'a');
+	CHECK_UTF16LE("utf16le high at the end", "a\x00\x3D\xD8", 'a', 0xFFFD);
+	CHECK_UTF16LE("utf16le lone low", "\x00\xDE" "a\x00", 0xFFFD, 'a');
+	CHECK_UTF16LE("utf16le odd trailing byte", "a\x00" "b", 'a');
+
+	/* The ASCII fast path takes 4 code units at a time */
+	CHECK_UTF16LE("utf16le 3 ascii", "a\x00" "b\x00" "c\x00", 'a', 'b', 'c');
+	CHECK_UTF16LE("utf16le 4 ascii", "a\x00" "b\x00" "c\x00" "d\x00", 'a', 'b', 'c', 'd');
+	CHECK_UTF16LE("utf16le 5 ascii", "a\x00" "b\x00" "c\x00" "d\x00" "e\x00", 'a', 'b', 'c', 'd', 'e');
+	CHECK_UTF16LE("utf16le latin-1 in block", "a\x00" "b\x00" "c\x00" "\xE9\x00" "e\x00", 'a', 'b', 'c', 0xE9, 'e');
+	CHECK_UTF16LE("utf16le high byte in block", "a\x00" "b\x01" "c\x00" "d\x00", 'a', 0x162, 'c', 'd');
+	CHECK_UTF16LE("utf16le pair across blocks", "a\x00" "b\x00" "c\x00" "\x3D\xD8\x00\xDE" "d\x00" "e\x00" "f\x00" "g\x00",
+		'a', 'b', 'c', 0x1F600, 'd', 'e', 'f', 'g');
+}
+
+int main(void)
+{
+	test_utf8();
+	test_utf16le();
+
+	if (failures) {
+		printf("%d failure(s)\n", failures);
+		return 1;
+	}
+	return 0;
+}
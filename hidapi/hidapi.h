@@ -48,7 +48,7 @@
 
 	@ingroup API
 */
-#define HID_API_VERSION_MINOR 13
+#define HID_API_VERSION_MINOR 14
 /** @brief Static/compile-time patch version of the library.
 
 	@ingroup API
@@ -108,6 +108,26 @@ extern "C" {
 		struct hid_device_;
 		typedef struct hid_device_ hid_device; /**< opaque hidapi structure */
 
+		struct hid_poller_;
+		typedef struct hid_poller_ hid_poller; /**< opaque hidapi structure */
+
+		/** @brief Callback invoked by hid_poller_run() for each Input report read.
+
+			Since version 0.14.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 14, 0)
+
+			When reading from the device fails (e.g. the device was
+			disconnected), the callback is invoked once with @p data set
+			to NULL and @p length set to 0, and the device is removed
+			from the poller.
+
+			@ingroup API
+			@param dev The device the report was read from.
+			@param data The report data, only valid during the call.
+			@param length The length of the report in bytes.
+			@param user_data The value given to hid_poller_add().
+		*/
+		typedef void (HID_API_CALL *hid_poller_callback)(hid_device *dev, const unsigned char *data, size_t length, void *user_data);
+
 		/** @brief HID underlying bus types.
 
 			@ingroup API
@@ -139,6 +159,28 @@ extern "C" {
 			HID_API_BUS_SPI = 0x04,
 		} hid_bus_type;
 
+		/** @brief What to do with an Input report which arrives
+			while the input queue of a device is full.
+
+			Since version 0.14.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 14, 0)
+
+			@see hid_set_input_queue()
+
+			@ingroup API
+		*/
+		typedef enum {
+			/* Drop the oldest queued report to make room for the new one (default) */
+			HID_API_QUEUE_DROP_OLDEST = 0,
+
+			/* Drop the new report */
+			HID_API_QUEUE_DROP_NEWEST = 1,
+
+			/* Stop reading from the device until there is room in the queue,
+			   the reports are then buffered (and eventually dropped)
+			   by the OS or the device itself */
+			HID_API_QUEUE_BLOCK = 2,
+		} hid_queue_policy;
+
 		/** hidapi info structure */
 		struct hid_device_info {
 			/** Platform-specific device path */
@@ -157,10 +199,12 @@ extern "C" {
 			/** Product string */
 			wchar_t *product_string;
 			/** Usage Page for this Device/Interface
-			    (Windows/Mac/hidraw only) */
+			    (Windows/Mac/hidraw, libusb on Linux
+			    or with INVASIVE_GET_USAGE) */
 			unsigned short usage_page;
 			/** Usage for this Device/Interface
-			    (Windows/Mac/hidraw only) */
+			    (Windows/Mac/hidraw, libusb on Linux
+			    or with INVASIVE_GET_USAGE) */
 			unsigned short usage;
 			/** The USB interface which this logical device
 			    represents.
@@ -181,6 +225,240 @@ extern "C" {
 			hid_bus_type bus_type;
 		};
 
+		/** @brief Flags of struct #hid_enum_filter.
+
+			Since version 0.14.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 14, 0)
+
+			@ingroup API
+		*/
+		typedef enum {
+			/* Only list the devices with the interface_number of the filter */
+			HID_API_ENUM_MATCH_INTERFACE = (1 << 0),
+
+			/* Don't read the manufacturer, product and serial number strings,
+			   they are left NULL (the serial number is still read
+			   if the filter has a serial_number_prefix) */
+			HID_API_ENUM_SKIP_STRINGS = (1 << 1),
+
+			/* Don't read the report descriptors: a single record per
+			   device/interface, with the usage_page and usage left 0
+			   (ignored if the filter has a usage_page or usage) */
+			HID_API_ENUM_SKIP_USAGES = (1 << 2),
+		} hid_enum_flag;
+
+		/** @brief Selects the devices listed by hid_enumerate_ex().
+
+			Since version 0.14.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 14, 0)
+
+			A zero-initialized filter matches all the devices,
+			every criterion which is set has to match.
+
+			@ingroup API
+		*/
+		struct hid_enum_filter {
+			/** Vendor ID, or 0x0 for any vendor */
+			unsigned short vendor_id;
+			/** Product ID, or 0x0 for any product */
+			unsigned short product_id;
+			/** Usage Page, or 0x0 for any usage page */
+			unsigned short usage_page;
+			/** Usage within the usage_page, or 0x0 for any usage */
+			unsigned short usage;
+			/** Bus type, or HID_API_BUS_UNKNOWN for any bus */
+			hid_bus_type bus_type;
+			/** USB interface number (used with HID_API_ENUM_MATCH_INTERFACE) */
+			int interface_number;
+			/** Beginning of the serial number (case-sensitive), or NULL for any */
+			const wchar_t *serial_number_prefix;
+			/** A combination of #hid_enum_flag values, or 0 */
+			int flags;
+		};
+
+		/** @brief Callback invoked by hid_enumerate_each() for each matching device.
+
+			Since version 0.14.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 14, 0)
+
+			@ingroup API
+			@param device The device, a single record (its next pointer
+			              is NULL), only valid during the call.
+			@param user_data The value given to hid_enumerate_each().
+
+			@returns
+				Returning a non-zero value stops the enumeration.
+		*/
+		typedef int (HID_API_CALL *hid_enumerate_callback_fn)(const struct hid_device_info *device, void *user_data);
+
+		/** @brief The type of a report, see struct #hid_report_layout.
+
+			Since version 0.14.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 14, 0)
+
+			@ingroup API
+		*/
+		typedef enum {
+			HID_API_REPORT_INPUT = 0,
+			HID_API_REPORT_OUTPUT = 1,
+			HID_API_REPORT_FEATURE = 2,
+		} hid_report_type;
+
+		/** @brief Flags of struct #hid_report_field, the data bits of
+			its Input, Output or Feature item (HID 1.11, section 6.2.2.5).
+
+			Since version 0.14.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 14, 0)
+
+			@ingroup API
+		*/
+		typedef enum {
+			/* Constant (e.g. padding) rather than Data */
+			HID_API_FIELD_CONSTANT = (1 << 0),
+			/* Variable: each element is the value of its own usage.
+			   Otherwise an Array: each element is the index of an
+			   active usage, counted from the logical minimum */
+			HID_API_FIELD_VARIABLE = (1 << 1),
+			/* Relative rather than Absolute */
+			HID_API_FIELD_RELATIVE = (1 << 2),
+			HID_API_FIELD_WRAP = (1 << 3),
+			HID_API_FIELD_NON_LINEAR = (1 << 4),
+			HID_API_FIELD_NO_PREFERRED_STATE = (1 << 5),
+			HID_API_FIELD_NULL_STATE = (1 << 6),
+			HID_API_FIELD_VOLATILE = (1 << 7),
+			HID_API_FIELD_BUFFERED_BYTES = (1 << 8),
+		} hid_report_field_flag;
+
+		/** @brief A field of a report: report_count elements
+			of report_size bits each, one after the other.
+
+			Since version 0.14.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 14, 0)
+
+			@ingroup API
+		*/
+		struct hid_report_field {
+			/** Report ID, 0 if the device doesn't use report IDs */
+			unsigned char report_id;
+			/** A #hid_report_type value */
+			unsigned char report_type;
+			/** A combination of #hid_report_field_flag values */
+			unsigned short flags;
+			/** Usage Page of the usages */
+			unsigned short usage_page;
+			/** For a Variable field, element i has the usage
+			    min(usage_minimum + i, usage_maximum).
+			    For an Array field, the range of the usages the
+			    elements select from. 0 if the field has no usage. */
+			unsigned short usage_minimum;
+			unsigned short usage_maximum;
+			/** Size of an element, in bits */
+			unsigned short report_size;
+			/** Number of elements */
+			unsigned int report_count;
+			/** Position of the first element, in bits, from the first
+			    byte of the report as hid_read() or hid_get_feature_report()
+			    return it (so counting the report ID byte, if any) */
+			unsigned int bit_offset;
+			/** Range of the element values (signed if logical_minimum < 0) */
+			int logical_minimum;
+			int logical_maximum;
+			/** Range of the physical values, the logical range
+			    if the descriptor doesn't give one */
+			int physical_minimum;
+			int physical_maximum;
+		};
+
+		/** @brief A report of a device, see struct #hid_report_layout.
+
+			Since version 0.14.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 14, 0)
+
+			@ingroup API
+		*/
+		struct hid_report_info {
+			/** Report ID, 0 if the device doesn't use report IDs */
+			unsigned char report_id;
+			/** A #hid_report_type value */
+			unsigned char report_type;
+			/** Size of the report in bytes, including the report ID byte (if any) */
+			unsigned int size;
+			/** The fields of the report: fields[first_field] to
+			    fields[first_field + num_fields - 1] of the layout */
+			unsigned int first_field;
+			unsigned int num_fields;
+		};
+
+		/** @brief The reports of a device and their fields, compiled
+			from its report descriptor, see hid_get_report_layout().
+
+			Since version 0.14.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 14, 0)
+
+			@ingroup API
+		*/
+		struct hid_report_layout {
+			/** The reports, in the order of the report descriptor */
+			const struct hid_report_info *reports;
+			size_t num_reports;
+			/** The fields, grouped by report, each report's
+			    in the order of the report descriptor */
+			const struct hid_report_field *fields;
+			size_t num_fields;
+			/** Non-zero if the reports start with a report ID byte */
+			int uses_report_ids;
+		};
+
+		/** @brief Hotplug events, see hid_hotplug_register_callback().
+
+			Since version 0.14.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 14, 0)
+
+			@ingroup API
+		*/
+		typedef enum {
+			/* A device was connected */
+			HID_API_HOTPLUG_EVENT_DEVICE_ARRIVED = (1 << 0),
+
+			/* A device was disconnected */
+			HID_API_HOTPLUG_EVENT_DEVICE_LEFT = (1 << 1),
+		} hid_hotplug_event;
+
+		/** @brief Flags for hid_hotplug_register_callback().
+
+			Since version 0.14.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 14, 0)
+
+			@ingroup API
+		*/
+		typedef enum {
+			/* Report the devices already connected as arrived,
+			   before hid_hotplug_register_callback() returns */
+			HID_API_HOTPLUG_ENUMERATE = (1 << 0),
+		} hid_hotplug_flag;
+
+		/** @brief Identifies a registered hotplug callback.
+
+			Since version 0.14.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 14, 0)
+
+			@ingroup API
+		*/
+		typedef int hid_hotplug_callback_handle;
+
+		/** @brief Callback invoked when a matching device arrives or leaves.
+
+			Since version 0.14.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 14, 0)
+
+			The callback is invoked from an internal thread of HIDAPI
+			(or from hid_hotplug_register_callback() itself for
+			#HID_API_HOTPLUG_ENUMERATE), never concurrently with
+			another hotplug callback. It may register and deregister
+			hotplug callbacks, including itself.
+
+			@ingroup API
+			@param callback_handle The handle of the callback.
+			@param device The device which arrived or left, a single
+			              record (its next pointer is NULL), only valid
+			              during the call. For #HID_API_HOTPLUG_EVENT_DEVICE_LEFT
+			              it holds what was known when the device arrived.
+			@param event The event which happened to the device.
+			@param user_data The value given to hid_hotplug_register_callback().
+
+			@returns
+				Returning a non-zero value deregisters the callback.
+		*/
+		typedef int (HID_API_CALL *hid_hotplug_callback_fn)(hid_hotplug_callback_handle callback_handle, struct hid_device_info *device, hid_hotplug_event event, void *user_data);
+
 
 		/** @brief Initialize the HIDAPI library.
 
@@ -239,6 +517,50 @@ extern "C" {
 		*/
 		struct hid_device_info HID_API_EXPORT * HID_API_CALL hid_enumerate(unsigned short vendor_id, unsigned short product_id);
 
+		/** @brief Enumerate the HID Devices matching a filter.
+
+			Since version 0.14.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 14, 0)
+
+			Same as hid_enumerate(), with more criteria. The devices
+			are only read as far as needed to reject them, so a narrow
+			filter is cheaper than filtering the result of hid_enumerate().
+
+			@ingroup API
+			@param filter The devices to list, or NULL for all the devices.
+
+			@returns
+				This function returns a pointer to a linked list of type
+				struct #hid_device_info, containing information about the matching HID devices,
+				or NULL in the case of failure or if no HID devices match.
+				Call hid_error(NULL) to get the failure reason.
+
+			@note The returned value by this function must to be freed by calling hid_free_enumeration(),
+			      when not needed anymore.
+		*/
+		struct hid_device_info HID_API_EXPORT * HID_API_CALL hid_enumerate_ex(const struct hid_enum_filter *filter);
+
+		/** @brief Enumerate the HID Devices one at a time.
+
+			Since version 0.14.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 14, 0)
+
+			Same as hid_enumerate_ex(), except that each record is given
+			to the callback as soon as it is read, and the devices which
+			come after the one the callback stops at aren't read at all.
+			The devices are read from the calling thread, in the order
+			hid_enumerate_ex() would list them.
+
+			@ingroup API
+			@param filter The devices to list, or NULL for all the devices.
+			@param callback The function to call for each record.
+			@param user_data Passed to the callback as is.
+
+			@returns
+				This function returns 0 on success (including when the
+				callback stops the enumeration) and -1 on error.
+				Call hid_error(NULL) to get the failure reason.
+		*/
+		int HID_API_EXPORT HID_API_CALL hid_enumerate_each(const struct hid_enum_filter *filter, hid_enumerate_callback_fn callback, void *user_data);
+
 		/** @brief Free an enumeration Linked List
 
 			This function frees a linked list created by hid_enumerate().
@@ -249,6 +571,103 @@ extern "C" {
 		*/
 		void  HID_API_EXPORT HID_API_CALL hid_free_enumeration(struct hid_device_info *devs);
 
+		/** @brief Get notified when HID devices are connected or disconnected.
+
+			Since version 0.14.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 14, 0)
+
+			The devices are monitored with the OS notifications (not by
+			polling hid_enumerate()), starting with the first registered
+			callback and until hid_exit().
+
+			@ingroup API
+			@param vendor_id The Vendor ID (VID) of the devices to report,
+			                 or 0x0 for any vendor.
+			@param product_id The Product ID (PID) of the devices to report,
+			                  or 0x0 for any product.
+			@param events A combination of #hid_hotplug_event values.
+			@param flags A combination of #hid_hotplug_flag values, or 0.
+			@param callback The function to call for each event.
+			@param user_data Passed to the callback as is.
+			@param callback_handle Receives the handle of the callback,
+			                       used to deregister it (Optionally NULL).
+
+			@returns
+				This function returns 0 on success and -1 on error.
+				Call hid_error(NULL) to get the failure reason.
+		*/
+		int HID_API_EXPORT HID_API_CALL hid_hotplug_register_callback(unsigned short vendor_id, unsigned short product_id, int events, int flags, hid_hotplug_callback_fn callback, void *user_data, hid_hotplug_callback_handle *callback_handle);
+
+		/** @brief Stop calling a hotplug callback.
+
+			Since version 0.14.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 14, 0)
+
+			Once this function returns, the callback isn't running
+			and won't be called anymore (unless this function is
+			called from the callback itself).
+
+			@ingroup API
+			@param callback_handle A handle returned by hid_hotplug_register_callback().
+
+			@returns
+				This function returns 0 on success and -1 on error
+				(e.g. an unknown handle).
+		*/
+		int HID_API_EXPORT HID_API_CALL hid_hotplug_deregister_callback(hid_hotplug_callback_handle callback_handle);
+
+		/** @brief Serve hid_enumerate() from memory.
+
+			Since version 0.14.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 14, 0)
+
+			When enabled, the connected devices are read once and then
+			kept up to date by the hotplug monitor (see
+			hid_hotplug_register_callback()), so that hid_enumerate()
+			and hid_open() don't access the devices anymore. A device
+			shows up once the notification of its arrival is processed,
+			which may be shortly after it is connected. The devices
+			connected meanwhile are listed last, so the order may
+			differ from the one of an actual scan.
+
+			Disabled by default. The monitor runs until hid_exit(),
+			the setting outlives it: the next hid_enumerate() starts
+			the monitor again.
+
+			@ingroup API
+			@param enable 1 to enable the cache, 0 to disable it.
+
+			@returns
+				This function returns 0 on success and -1 on error
+				(e.g. the devices can't be monitored on this platform).
+				Call hid_error(NULL) to get the failure reason.
+		*/
+		int HID_API_EXPORT HID_API_CALL hid_set_enumeration_cache(int enable);
+
+		/** @brief Read the devices from several threads while enumerating.
+
+			Since version 0.14.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 14, 0)
+
+			By default hid_enumerate() reads the devices one after
+			another, so a slow device delays all the following ones.
+			With more than one thread the devices are read concurrently,
+			the order of the result stays the same.
+
+			The timeout bounds the time spent starting to read devices:
+			the devices which aren't being read by then are left out
+			of the result (the ones being read are waited for).
+
+			@ingroup API
+			@param num_threads The maximal number of threads reading the devices,
+			                   including the calling thread. 0 or 1 (default)
+			                   to read the devices from the calling thread only.
+			@param timeout_ms The timeout of an enumeration in milliseconds,
+			                  or -1 (default) to read all the devices.
+
+			@returns
+				This function returns 0 on success and -1 on error
+				(e.g. not supported on this platform).
+				Call hid_error(NULL) to get the failure reason.
+		*/
+		int HID_API_EXPORT HID_API_CALL hid_set_enumeration_threads(int num_threads, int timeout_ms);
+
 		/** @brief Open a HID device using a Vendor ID (VID), Product ID
 			(PID) and optionally a serial number.
 
@@ -364,6 +783,36 @@ extern "C" {
 		*/
 		int  HID_API_EXPORT HID_API_CALL hid_read(hid_device *dev, unsigned char *data, size_t length);
 
+		/** @brief Read several Input reports from a HID device at once.
+
+			Since version 0.14.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 14, 0)
+
+			Waits for the first Input report the same way hid_read_timeout()
+			does, then also returns every further report which is already
+			queued for the device, without waiting any longer.
+			Report number i is stored at @p data + i * @p stride and its
+			length is stored in @p lengths[i].
+
+			@ingroup API
+			@param dev A device handle returned from hid_open().
+			@param data A buffer to put the read data into,
+				at least @p stride * @p max_reports bytes long.
+			@param stride The number of bytes reserved for each report.
+				Longer reports are truncated, the same way as by hid_read().
+			@param max_reports The maximum number of reports to read.
+			@param lengths An array of at least @p max_reports elements,
+				which receives the length of each report read.
+			@param milliseconds timeout in milliseconds or -1 for blocking wait.
+
+			@returns
+				This function returns the number of reports read and
+				-1 on error.
+				Call hid_error(dev) to get the failure reason.
+				If no report was available to be read within
+				the timeout period, this function returns 0.
+		*/
+		int HID_API_EXPORT HID_API_CALL hid_read_batch(hid_device *dev, unsigned char *data, size_t stride, size_t max_reports, size_t *lengths, int milliseconds);
+
 		/** @brief Set the device handle to be non-blocking.
 
 			In non-blocking mode calls to hid_read() will return
@@ -385,6 +834,235 @@ extern "C" {
 		*/
 		int  HID_API_EXPORT HID_API_CALL hid_set_nonblocking(hid_device *dev, int nonblock);
 
+		/** @brief Get a file descriptor which is readable while Input reports are available.
+
+			Since version 0.14.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 14, 0)
+
+			Allows to wait for Input reports in an external event loop
+			(poll(), epoll, libuv, etc.) instead of blocking in hid_read().
+			When the descriptor becomes readable, read the reports with
+			hid_read_timeout() and a timeout of 0 (or hid_read_batch())
+			until none is left. The descriptor also becomes readable when
+			the device is disconnected, so the next read reports the error.
+
+			The descriptor is owned by the device and is valid until
+			hid_close() is called. It must not be read from or closed
+			by the caller.
+
+			Only available on Linux (hidraw) and on the libusb backend.
+
+			@ingroup API
+			@param dev A device handle returned from hid_open().
+
+			@returns
+				This function returns the file descriptor on success
+				and -1 on error.
+				Call hid_error(dev) to get the failure reason.
+		*/
+		int HID_API_EXPORT HID_API_CALL hid_get_pollable_fd(hid_device *dev);
+
+		/** @brief Configure the queue of Input reports received and not read yet.
+
+			Since version 0.14.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 14, 0)
+
+			By default, the libusb backend queues up to 32 reports and
+			drops the oldest one when the queue is full, and the hidraw
+			backend relies on the buffer of the kernel driver.
+
+			With the libusb backend, the reports are queued as they
+			are received. With the hidraw backend, the reports are moved
+			from the kernel buffer to the queue on every read.
+
+			The reports already queued are kept, unless they exceed
+			the new limits.
+
+			@ingroup API
+			@param dev A device handle returned from hid_open().
+			@param max_reports The maximum number of queued reports, at least 1.
+			@param max_bytes The maximum total size of the queued reports,
+				or 0 for no limit other than @p max_reports.
+			@param policy What to do when a report arrives and the queue is full.
+				@ref HID_API_QUEUE_BLOCK fails while there are queues
+				of report IDs, see hid_set_report_id_queue().
+
+			@returns
+				This function returns 0 on success and -1 on error.
+				Call hid_error(dev) to get the failure reason.
+		*/
+		int HID_API_EXPORT HID_API_CALL hid_set_input_queue(hid_device *dev, size_t max_reports, size_t max_bytes, hid_queue_policy policy);
+
+		/** @brief Get the number of Input reports dropped because the input queue was full.
+
+			Since version 0.14.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 14, 0)
+
+			Reports dropped by the OS or the device itself are not counted.
+
+			@ingroup API
+			@param dev A device handle returned from hid_open().
+			@param count The number of dropped reports since the device was opened, on return.
+
+			@returns
+				This function returns 0 on success and -1 on error.
+				Call hid_error(dev) to get the failure reason.
+		*/
+		int HID_API_EXPORT HID_API_CALL hid_get_dropped_reports(hid_device *dev, unsigned long long *count);
+
+		/** @brief Queue the Input reports with a given report ID separately.
+
+			Since version 0.14.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 14, 0)
+
+			The reports with this report ID are no longer returned by
+			hid_read(), hid_read_timeout() or hid_read_batch(), but
+			by hid_read_report_id(). A busy report ID then can't
+			push the other reports out of the input queue.
+
+			Whatever the policy of the input queue (see
+			hid_set_input_queue()), when the queue of the ID is full
+			its oldest report is dropped, and counted by
+			hid_get_dropped_reports().
+			The input queue can't use @ref HID_API_QUEUE_BLOCK while
+			there are queues of report IDs: a full input queue would
+			stop the reports of the IDs as well. Both this function and
+			hid_set_input_queue() fail instead.
+			With the hidraw backend, the input queue is enabled
+			(see hid_set_input_queue()) if it is not already.
+
+			The pollable descriptor and the pollers don't take
+			the queues of the report IDs into account.
+			This function must not be called while another thread
+			reads from the device.
+
+			Only available on Linux (hidraw) and on the libusb backend.
+
+			@ingroup API
+			@param dev A device handle returned from hid_open().
+			@param report_id The report ID, the first byte of the reports.
+				0 is invalid: without report IDs, the first byte is data.
+			@param max_reports The maximum number of queued reports
+				of this ID, or 0 to remove the queue of the ID. Its
+				queued reports then go back to the input queue.
+
+			@returns
+				This function returns 0 on success and -1 on error.
+				Call hid_error(dev) to get the failure reason.
+		*/
+		int HID_API_EXPORT HID_API_CALL hid_set_report_id_queue(hid_device *dev, unsigned char report_id, size_t max_reports);
+
+		/** @brief Read an Input report from the queue of a report ID.
+
+			Since version 0.14.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 14, 0)
+
+			Works like hid_read_timeout(), for the reports queued
+			separately with hid_set_report_id_queue(). The first
+			byte of the report is the report ID.
+
+			Only available on Linux (hidraw) and on the libusb backend.
+
+			@ingroup API
+			@param dev A device handle returned from hid_open().
+			@param report_id The report ID, with a queue set by hid_set_report_id_queue().
+			@param data A buffer to put the read data into.
+			@param length The number of bytes to read.
+			@param milliseconds timeout in milliseconds or -1 for blocking wait.
+
+			@returns
+				This function returns the actual number of bytes read and
+				-1 on error (including no queue for @p report_id).
+				Call hid_error(dev) to get the failure reason.
+				If no packet was available to be read within
+				the timeout period, this function returns 0.
+		*/
+		int HID_API_EXPORT HID_API_CALL hid_read_report_id(hid_device *dev, unsigned char report_id, unsigned char *data, size_t length, int milliseconds);
+
+		/** @brief Create a poller, which reads from many devices in a single thread.
+
+			Since version 0.14.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 14, 0)
+
+			A poller waits for Input reports of all the devices added
+			to it at once, and passes each report to the callback
+			given for its device. This allows a single thread to serve
+			any number of devices.
+
+			A poller must only be used by one thread at a time.
+
+			@ingroup API
+
+			@returns
+				This function returns a pointer to a #hid_poller object on
+				success or NULL on failure.
+				Call hid_error(NULL) to get the failure reason.
+		*/
+		hid_poller HID_API_EXPORT * HID_API_CALL hid_poller_new(void);
+
+		/** @brief Add a device to a poller.
+
+			Since version 0.14.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 14, 0)
+
+			A device can be added to a single poller only.
+			While a device is added to a poller, its Input reports
+			must not be read with hid_read() and similar functions.
+
+			@ingroup API
+			@param poller A poller returned from hid_poller_new().
+			@param dev A device handle returned from hid_open().
+			@param callback The function to call for each Input report of the device.
+			@param user_data The value to pass to @p callback.
+
+			@returns
+				This function returns 0 on success and -1 on error.
+				Call hid_error(NULL) to get the failure reason.
+		*/
+		int HID_API_EXPORT HID_API_CALL hid_poller_add(hid_poller *poller, hid_device *dev, hid_poller_callback callback, void *user_data);
+
+		/** @brief Remove a device from a poller.
+
+			Since version 0.14.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 14, 0)
+
+			Can be called from within the callback.
+			hid_close() removes the device from its poller as well.
+
+			@ingroup API
+			@param poller A poller returned from hid_poller_new().
+			@param dev A device handle previously added with hid_poller_add().
+
+			@returns
+				This function returns 0 on success and -1 on error.
+				Call hid_error(NULL) to get the failure reason.
+		*/
+		int HID_API_EXPORT HID_API_CALL hid_poller_remove(hid_poller *poller, hid_device *dev);
+
+		/** @brief Wait for Input reports and dispatch them to the callbacks.
+
+			Since version 0.14.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 14, 0)
+
+			Waits until at least one of the devices has Input reports
+			available, or until the timeout expires, then invokes the
+			callbacks for all the reports that are available.
+
+			@ingroup API
+			@param poller A poller returned from hid_poller_new().
+			@param milliseconds timeout in milliseconds or -1 for blocking wait.
+
+			@returns
+				This function returns the number of reports dispatched
+				and -1 on error.
+				Call hid_error(NULL) to get the failure reason.
+				If no report was available within the timeout period,
+				this function returns 0.
+		*/
+		int HID_API_EXPORT HID_API_CALL hid_poller_run(hid_poller *poller, int milliseconds);
+
+		/** @brief Free a poller.
+
+			Since version 0.14.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 14, 0)
+
+			The devices added to the poller are not closed.
+
+			@ingroup API
+			@param poller A poller returned from hid_poller_new().
+		*/
+		void HID_API_EXPORT HID_API_CALL hid_poller_free(hid_poller *poller);
+
 		/** @brief Send a Feature report to the device.
 
 			Feature reports are sent over the Control endpoint as a
@@ -531,6 +1209,83 @@ extern "C" {
 		*/
 		struct hid_device_info HID_API_EXPORT * HID_API_CALL hid_get_device_info(hid_device *dev);
 
+		/** @brief Get the layout of the reports of a HID device.
+
+			Since version 0.14.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 14, 0)
+
+			The report descriptor of the device is read and compiled
+			into a table of its reports and their fields at the first
+			call, the next calls return the same table.
+
+			Not available on Windows, where hid_get_report_descriptor()
+			isn't either.
+
+			@ingroup API
+			@param dev A device handle returned from hid_open().
+
+			@returns
+				This function returns a pointer to the layout of the
+				device, or NULL in the case of failure (including a
+				malformed report descriptor).
+				Call hid_error(dev) to get the failure reason.
+				The layout is valid until the device is closed with hid_close().
+
+			@note The returned object is owned by the @p dev, and SHOULD NOT be freed by the user.
+		*/
+		HID_API_EXPORT const struct hid_report_layout * HID_API_CALL hid_get_report_layout(hid_device *dev);
+
+		/** @brief Get the report descriptor of a HID device.
+
+			Since version 0.14.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 14, 0)
+
+			The descriptor is read from the device (or the OS) at the
+			first call and kept with the handle, the next calls copy it
+			from memory.
+
+			@ingroup API
+			@param dev A device handle returned from hid_open().
+			@param buf The buffer to copy the descriptor into.
+			@param buf_size The size of the buffer in bytes, a buffer of
+			                #HID_API_MAX_REPORT_DESCRIPTOR_SIZE is enough.
+
+			@returns
+				This function returns the number of bytes copied
+				(the descriptor is truncated if the buffer is too small),
+				or -1 on error.
+				Call hid_error(dev) to get the failure reason.
+		*/
+		int HID_API_EXPORT_CALL hid_get_report_descriptor(hid_device *dev, unsigned char *buf, size_t buf_size);
+
+		/** @brief Extract the values of all the fields of an Input report.
+
+			Since version 0.14.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 14, 0)
+
+			The report is found in the layout by its report ID (the first
+			byte of the report, if the device uses report IDs). The values
+			of its fields are stored one after the other, in the order of
+			the fields: the report_count elements of the first field, then
+			those of the second field, and so on (padding fields included).
+			Each element is sign-extended if the logical minimum of its
+			field is negative, elements wider than 32 bits are truncated
+			to their low 32 bits. Elements past the end of a short report
+			are 0.
+
+			This function is thread-safe, it only reads the layout.
+
+			@ingroup API
+			@param layout A layout returned from hid_get_report_layout().
+			@param report An Input report, as hid_read() returns it.
+			@param length The length of the report in bytes.
+			@param values An array to put the values into.
+			@param max_values The number of elements of the array.
+
+			@returns
+				This function returns the number of values stored,
+				or -1 on error (no Input report with this ID in the
+				layout, or not enough room in the array).
+		*/
+		int HID_API_EXPORT HID_API_CALL hid_decode_report(const struct hid_report_layout *layout, const unsigned char *report, size_t length, int *values, size_t max_values);
+
 		/** @brief Get a string from a HID device, based on its string index.
 
 			@ingroup API
@@ -27,6 +27,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <limits.h>
 #include <locale.h>
 #include <errno.h>
 
@@ -37,19 +38,23 @@
 #include <sys/ioctl.h>
 #include <sys/utsname.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <wchar.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <dirent.h>
+#endif
 
 /* GNU / LibUSB */
 #include <libusb.h>
-#if !defined(__ANDROID__) && !defined(NO_ICONV)
-#include <iconv.h>
-#ifndef ICONV_CONST
-#define ICONV_CONST
-#endif
-#endif
 
 #include "hidapi_libusb.h"
+#include "hidapi_device_info.h"
+#include "hidapi_parallel.h"
+#include "hidapi_report_descriptor.h"
+#include "hidapi_utf.h"
 
 #if defined(__ANDROID__) && __ANDROID_API__ < __ANDROID_API_N__
 
@@ -134,11 +139,85 @@ libusb HIDAPI programs are encouraged to use the interface number
 instead to differentiate between interfaces on a composite HID device. */
 /*#define INVASIVE_GET_USAGE*/
 
-/* Linked List of input reports received from the device. */
-struct input_report {
-	uint8_t *data;
-	size_t len;
-	struct input_report *next;
+/* On Linux, the usages are read without opening the device from the
+   report descriptor the kernel exposes in sysfs (if a HID driver is
+   bound to the interface), see get_report_descriptor_from_sysfs(). */
+#if defined(__linux__) || defined(INVASIVE_GET_USAGE)
+#define HIDAPI_READ_USAGES
+#endif
+
+/* Maximum number of interrupt IN transfers kept in flight for a device,
+   see hid_libusb_set_input_transfers() */
+#define MAX_INPUT_TRANSFERS 16
+
+/* Default maximum number of input reports queued for a device. The oldest
+   report is dropped when a new one arrives and the queue is full, this
+   way we don't grow forever if the user never reads anything from the device.
+   See hid_set_input_queue(). */
+#define INPUT_REPORT_QUEUE_SIZE 32
+
+/* Fixed-size queue of the input reports received from the device.
+
+   There is a single producer (read_callback()) and a single consumer
+   (the thread reading from the device), which don't need to lock anything
+   to push or pop a report. The slots are allocated once, when the device
+   is opened, and each holds up to input_ep_max_packet_size bytes.
+
+   head and tail are free-running counters, the slot of counter n is
+   n & (num_slots - 1). num_slots is a power of two, so the slots stay
+   in sequence when the counters wrap around, and is larger than the
+   capacity, so the slot the producer writes to never holds a queued
+   report. When the queue is full, the producer drops the oldest report
+   by advancing tail. Both sides advance tail with a compare-and-swap:
+   the consumer claims the oldest report this way before copying it,
+   after announcing the slot in reading. A slot being read is never
+   written to: should the producer wrap around to it meanwhile, the new
+   report is dropped instead. */
+struct input_ring {
+	uint8_t *slots;
+	size_t *lengths;
+	size_t slot_size;
+	unsigned int capacity;
+	unsigned int num_slots;
+	atomic_uint head; /* Written by the producer only */
+	atomic_uint tail;
+	atomic_uint reading; /* 1 + the slot the consumer copies from, 0 - none */
+};
+
+/* A file descriptor which any thread can make readable, to wake up
+   a thread waiting for it in poll(). This is an eventfd on Linux
+   and a non-blocking pipe on the other platforms. */
+struct hid_wakeup {
+	int read_fd;
+	int write_fd;
+};
+
+/* Size of the buffer used by hid_poller_run() for each report */
+#define POLLER_REPORT_SIZE 4096
+/* Maximum number of reports hid_poller_run() reads from a device at once */
+#define POLLER_BATCH 16
+
+struct hid_poller_entry {
+	hid_device *dev;
+	hid_poller_callback callback;
+	void *user_data;
+	int ready; /* the entry is in the ready list of the poller */
+	int removed;
+	struct hid_poller_entry *next;
+	struct hid_poller_entry *next_ready;
+};
+
+struct hid_poller_ {
+	pthread_mutex_t mutex; /* Protects the ready list */
+	struct hid_wakeup wakeup; /* Signaled when an entry is added to the ready list */
+	struct hid_poller_entry *ready_head;
+	struct hid_poller_entry *ready_tail;
+	int ready_count;
+
+	int running; /* hid_poller_run() is dispatching the reports */
+	struct hid_poller_entry *entries;
+	unsigned char *buffer;
+	size_t lengths[POLLER_BATCH];
 };
 
 
@@ -163,21 +242,59 @@ struct hid_device_ {
 	int product_index;
 	int serial_index;
 	struct hid_device_info* device_info;
+	struct hid_report_layout *report_layout; /* Compiled at the first hid_get_report_layout() */
+	unsigned char *report_descriptor; /* NULL until read, see cache_report_descriptor() */
+	size_t report_descriptor_length;
 
 	/* Whether blocking reads are used */
 	int blocking; /* boolean */
 
 	/* Read thread objects */
 	pthread_t thread;
-	pthread_mutex_t mutex; /* Protects input_reports */
-	pthread_cond_t condition;
+	pthread_mutex_t mutex; /* Used to wait on condition */
+	pthread_cond_t condition; /* Signaled when a report is queued and there are input_waiters */
 	pthread_barrier_t barrier; /* Ensures correct startup sequence */
 	int shutdown_thread;
 	int transfer_loop_finished;
-	struct libusb_transfer *transfer;
-
-	/* List of received input reports. */
-	struct input_report *input_reports;
+	/* Interrupt IN transfers kept in flight. libusb completes them in
+	   submission order and each is resubmitted from read_callback(),
+	   so the reports are queued in the order the device sent them. */
+	struct libusb_transfer *transfers[MAX_INPUT_TRANSFERS];
+	int num_transfers;
+	atomic_int transfers_in_flight;
+	/* The transfers are handled by the shared event thread,
+	   instead of a read thread of this device */
+	int shared_event_thread;
+
+	/* Queue of received input reports. */
+	struct input_ring input_reports;
+	/* Number of threads waiting on condition for a report */
+	atomic_int input_waiters;
+	/* Non-zero when the pollable descriptor or a poller
+	   need to know when the queue becomes (non-)empty */
+	atomic_int input_listeners;
+	/* What read_callback() does when input_reports is full */
+	hid_queue_policy queue_policy;
+	/* With HID_API_QUEUE_BLOCK, the completed transfers whose report
+	   didn't fit in the queue, oldest first. They are resubmitted by
+	   resume_parked_transfers() once there is room. Protected by mutex */
+	struct libusb_transfer *parked_transfers[MAX_INPUT_TRANSFERS];
+	atomic_int num_parked_transfers;
+	atomic_ullong dropped_reports;
+	/* The queues of the report IDs read with hid_read_report_id(),
+	   NULL for the IDs which go to input_reports. Replaced under the
+	   libusb event lock, see hid_set_report_id_queue() */
+	struct input_ring *report_id_queues[256];
+	int num_report_id_queues;
+
+	/* The poller this device is added to, if any */
+	hid_poller *poller;
+	struct hid_poller_entry *poller_entry; /* Protected by mutex */
+
+	/* Readable while input_reports is not empty,
+	   created by hid_get_pollable_fd(). Protected by mutex */
+	int has_pollable_fd;
+	struct hid_wakeup pollable_fd;
 
 	/* Was kernel driver detached by libusb */
 #ifdef DETACH_KERNEL_DRIVER
@@ -193,8 +310,87 @@ static struct hid_api_version api_version = {
 
 static libusb_context *usb_context = NULL;
 
+/* Number of interrupt IN transfers for the devices opened from now on */
+static int input_transfers = 1;
+
+/* Whether the devices opened from now on use the shared event thread */
+static int use_shared_event_thread = 0;
+
+/* Whether hid_enumerate() lists the devices known to the hotplug monitor,
+   see hid_set_enumeration_cache() */
+static int use_enumeration_cache = 0;
+
+/* See hid_set_enumeration_threads() */
+static int enumeration_threads = 1;
+static int enumeration_timeout_ms = -1;
+
+/* A single thread handling the libusb events for all the devices
+   opened with hid_libusb_set_shared_event_thread(1), started with the
+   first of them and stopped when the last one is closed. */
+static struct {
+	pthread_mutex_t mutex; /* Protects users, and starting/stopping the thread */
+	pthread_t thread;
+	int users;
+	int stop;
+} event_thread = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+
 uint16_t get_usb_code_for_current_locale(void);
-static int return_data(hid_device *dev, unsigned char *data, size_t length);
+static void notify_input(hid_device *dev);
+static int event_thread_acquire(void);
+static void event_thread_release(void);
+static void hotplug_stop(void);
+static int hotplug_copy_devices(const struct hid_enum_filter *filter, struct hid_device_info **devs);
+
+static int wakeup_init(struct hid_wakeup *wakeup)
+{
+#ifdef __linux__
+	wakeup->read_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	wakeup->write_fd = wakeup->read_fd;
+	return (wakeup->read_fd == -1)? -1: 0;
+#else
+	int fds[2];
+	if (pipe(fds) == -1)
+		return -1;
+	fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+	fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+	fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+	fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+	wakeup->read_fd = fds[0];
+	wakeup->write_fd = fds[1];
+	return 0;
+#endif
+}
+
+static void wakeup_signal(struct hid_wakeup *wakeup)
+{
+#ifdef __linux__
+	eventfd_write(wakeup->write_fd, 1);
+#else
+	/* A full pipe is readable already */
+	const unsigned char c = 0;
+	ssize_t res = write(wakeup->write_fd, &c, 1);
+	(void) res;
+#endif
+}
+
+static void wakeup_clear(struct hid_wakeup *wakeup)
+{
+#ifdef __linux__
+	eventfd_t value;
+	eventfd_read(wakeup->read_fd, &value);
+#else
+	unsigned char buf[64];
+	while (read(wakeup->read_fd, buf, sizeof(buf)) > 0)
+		;
+#endif
+}
+
+static void wakeup_destroy(struct hid_wakeup *wakeup)
+{
+	if (wakeup->write_fd != wakeup->read_fd)
+		close(wakeup->write_fd);
+	close(wakeup->read_fd);
+}
 
 static hid_device *new_hid_device(void)
 {
@@ -210,124 +406,143 @@ static hid_device *new_hid_device(void)
 
 static void free_hid_device(hid_device *dev)
 {
+	int i;
+
+	if (dev->has_pollable_fd)
+		wakeup_destroy(&dev->pollable_fd);
+
+	free(dev->input_reports.slots);
+	free(dev->input_reports.lengths);
+
+	for (i = 0; i < 256; i++) {
+		if (dev->report_id_queues[i]) {
+			free(dev->report_id_queues[i]->slots);
+			free(dev->report_id_queues[i]->lengths);
+			free(dev->report_id_queues[i]);
+		}
+	}
+
 	/* Clean up the thread objects */
 	pthread_barrier_destroy(&dev->barrier);
 	pthread_cond_destroy(&dev->condition);
 	pthread_mutex_destroy(&dev->mutex);
 
-	hid_free_enumeration(dev->device_info);
+	hidapi_free_device_info_list(dev->device_info);
+	free(dev->report_layout);
+	free(dev->report_descriptor);
 
 	/* Free the device itself */
 	free(dev);
 }
 
-#if 0
-/*TODO: Implement this function on hidapi/libusb.. */
-static void register_error(hid_device *dev, const char *op)
+static int input_ring_init(struct input_ring *ring, size_t slot_size, unsigned int capacity)
 {
+	if (capacity > UINT_MAX / 2)
+		capacity = UINT_MAX / 2;
+	ring->capacity = capacity;
+	ring->num_slots = 1;
+	while (ring->num_slots <= capacity)
+		ring->num_slots *= 2;
+	ring->slot_size = slot_size;
+	ring->slots = (uint8_t*) malloc(ring->num_slots * (slot_size? slot_size: 1));
+	ring->lengths = (size_t*) calloc(ring->num_slots, sizeof(size_t));
+	atomic_init(&ring->head, 0);
+	atomic_init(&ring->tail, 0);
+	atomic_init(&ring->reading, 0);
+	return (ring->slots && ring->lengths)? 0: -1;
+}
 
+static void input_ring_free(struct input_ring *ring)
+{
+	free(ring->slots);
+	free(ring->lengths);
 }
-#endif
 
-/* Get bytes from a HID Report Descriptor.
-   Only call with a num_bytes of 0, 1, 2, or 4. */
-static uint32_t get_bytes(uint8_t *rpt, size_t len, size_t num_bytes, size_t cur)
+static int input_ring_empty(struct input_ring *ring)
 {
-	/* Return if there aren't enough bytes. */
-	if (cur + num_bytes >= len)
-		return 0;
+	return atomic_load(&ring->head) == atomic_load(&ring->tail);
+}
 
-	if (num_bytes == 0)
-		return 0;
-	else if (num_bytes == 1) {
-		return rpt[cur+1];
-	}
-	else if (num_bytes == 2) {
-		return (rpt[cur+2] * 256 + rpt[cur+1]);
-	}
-	else if (num_bytes == 4) {
-		return (rpt[cur+4] * 0x01000000 +
-		        rpt[cur+3] * 0x00010000 +
-		        rpt[cur+2] * 0x00000100 +
-		        rpt[cur+1] * 0x00000001);
-	}
-	else
-		return 0;
+static int input_ring_full(struct input_ring *ring)
+{
+	return atomic_load(&ring->head) - atomic_load(&ring->tail) >= ring->capacity;
 }
 
-/* Retrieves the device's Usage Page and Usage from the report
-   descriptor. The algorithm is simple, as it just returns the first
-   Usage and Usage Page that it finds in the descriptor.
-   The return value is 0 on success and -1 on failure. */
-static int get_usage(uint8_t *report_descriptor, size_t size,
-                     unsigned short *usage_page, unsigned short *usage)
+/* Producer side. Returns 1 if the report is the only one queued now,
+   i.e. the queue went from empty to non-empty. When the queue is full
+   the oldest report is dropped, and *dropped is incremented. */
+static int input_ring_push(struct input_ring *ring, const uint8_t *data, size_t len, atomic_ullong *dropped)
 {
-	unsigned int i = 0;
-	int size_code;
-	int data_len, key_size;
-	int usage_found = 0, usage_page_found = 0;
+	unsigned int head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	unsigned int tail = atomic_load(&ring->tail);
+	unsigned int slot = head & (ring->num_slots - 1);
+
+	if (atomic_load(&ring->reading) == slot + 1) {
+		/* The consumer is still copying the report claimed
+		   num_slots reports ago out of this slot. A report
+		   claimed from now on can't be in this slot, as
+		   head - tail never exceeds the capacity. */
+		atomic_fetch_add(dropped, 1);
+		return 0;
+	}
 
-	while (i < size) {
-		int key = report_descriptor[i];
-		int key_cmd = key & 0xfc;
+	if (head - tail >= ring->capacity) {
+		/* Full, drop the oldest report. If this fails,
+		   the consumer has just taken it. */
+		if (atomic_compare_exchange_strong(&ring->tail, &tail, tail + 1))
+			atomic_fetch_add(dropped, 1);
+	}
 
-		//printf("key: %02hhx\n", key);
+	if (len > ring->slot_size)
+		len = ring->slot_size;
+	memcpy(ring->slots + (size_t) slot * ring->slot_size, data, len);
+	ring->lengths[slot] = len;
 
-		if ((key & 0xf0) == 0xf0) {
-			/* This is a Long Item. The next byte contains the
-			   length of the data section (value) for this key.
-			   See the HID specification, version 1.11, section
-			   6.2.2.3, titled "Long Items." */
-			if (i+1 < size)
-				data_len = report_descriptor[i+1];
-			else
-				data_len = 0; /* malformed report */
-			key_size = 3;
-		}
-		else {
-			/* This is a Short Item. The bottom two bits of the
-			   key contain the size code for the data section
-			   (value) for this key.  Refer to the HID
-			   specification, version 1.11, section 6.2.2.2,
-			   titled "Short Items." */
-			size_code = key & 0x3;
-			switch (size_code) {
-			case 0:
-			case 1:
-			case 2:
-				data_len = size_code;
-				break;
-			case 3:
-				data_len = 4;
-				break;
-			default:
-				/* Can't ever happen since size_code is & 0x3 */
-				data_len = 0;
-				break;
-			};
-			key_size = 1;
-		}
+	atomic_store(&ring->head, head + 1);
 
-		if (key_cmd == 0x4) {
-			*usage_page  = get_bytes(report_descriptor, size, data_len, i);
-			usage_page_found = 1;
-			//printf("Usage Page: %x\n", (uint32_t)*usage_page);
-		}
-		if (key_cmd == 0x8) {
-			*usage = get_bytes(report_descriptor, size, data_len, i);
-			usage_found = 1;
-			//printf("Usage: %x\n", (uint32_t)*usage);
+	/* tail is loaded after publishing head, see input_ring_pop() */
+	return atomic_load(&ring->tail) == head;
+}
+
+/* Consumer side. Copies the oldest report into data and
+   returns its (truncated) length, or -1 if the queue is empty. */
+static int input_ring_pop(struct input_ring *ring, unsigned char *data, size_t length)
+{
+	unsigned int tail = atomic_load(&ring->tail);
+
+	while (tail != atomic_load(&ring->head)) {
+		unsigned int slot = tail & (ring->num_slots - 1);
+		size_t len;
+
+		/* Announced before the report is claimed, so the producer
+		   either sees it or sees the claim, see input_ring_push() */
+		atomic_store(&ring->reading, slot + 1);
+		if (!atomic_compare_exchange_strong(&ring->tail, &tail, tail + 1)) {
+			/* The producer dropped the report, tail now holds the
+			   new value, try again with the next oldest one. */
+			continue;
 		}
 
-		if (usage_page_found && usage_found)
-			return 0; /* success */
+		len = ring->lengths[slot];
+		if (len > length)
+			len = length;
+		memcpy(data, ring->slots + (size_t) slot * ring->slot_size, len);
+		atomic_store(&ring->reading, 0);
 
-		/* Skip over this key and it's associated data */
-		i += data_len + key_size;
+		return (int) len;
 	}
 
-	return -1; /* failure */
+	atomic_store(&ring->reading, 0);
+	return -1;
+}
+
+#if 0
+/*TODO: Implement this function on hidapi/libusb.. */
+static void register_error(hid_device *dev, const char *op)
+{
+
 }
+#endif
 
 #if defined(__FreeBSD__) && __FreeBSD__ < 10
 /* The libusb version included in FreeBSD < 10 doesn't have this function. In
@@ -351,49 +566,190 @@ static inline int libusb_get_string_descriptor(libusb_device_handle *dev,
 #endif
 
 
-/* Get the first language the device says it reports. This comes from
-   USB string #0. */
-static uint16_t get_first_language(libusb_device_handle *dev)
+/* Cache of the string descriptors of the USB devices, so that asking
+   for the same strings again (during enumeration or with an open handle)
+   doesn't cost any control transfer. Entries are keyed by the libusb_device,
+   which is referenced while cached. They are dropped when the device is no
+   longer in the device list (see hid_enumerate()), and on hid_exit(). */
+struct cached_string {
+	uint8_t index;
+	uint16_t lang;
+	wchar_t *str;
+};
+
+struct string_cache_entry {
+	libusb_device *device;
+	/* The languages from USB string #0, -1 if not read yet */
+	int num_langids;
+	uint16_t langids[31];
+	struct cached_string *strings;
+	size_t num_strings;
+	struct string_cache_entry *next;
+};
+
+static pthread_mutex_t string_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct string_cache_entry *string_cache = NULL;
+
+/* string_cache_mutex must be locked */
+static struct string_cache_entry *string_cache_get(libusb_device *device)
 {
-	uint16_t buf[32];
-	int len;
+	struct string_cache_entry *entry;
 
-	/* Get the string from libusb. */
-	len = libusb_get_string_descriptor(dev,
-			0x0, /* String ID */
-			0x0, /* Language */
-			(unsigned char*)buf,
-			sizeof(buf));
-	if (len < 4)
-		return 0x0;
+	for (entry = string_cache; entry; entry = entry->next) {
+		if (entry->device == device)
+			return entry;
+	}
+
+	entry = (struct string_cache_entry*) calloc(1, sizeof(*entry));
+	if (!entry)
+		return NULL;
+	entry->device = libusb_ref_device(device);
+	entry->num_langids = -1;
+	entry->next = string_cache;
+	string_cache = entry;
+
+	return entry;
+}
+
+/* wcsdup(), which Bionic doesn't have */
+static wchar_t *dup_wide_string(const wchar_t *str)
+{
+	size_t size = (wcslen(str) + 1) * sizeof(wchar_t);
+	wchar_t *copy = (wchar_t*) malloc(size);
+	if (copy)
+		memcpy(copy, str, size);
+	return copy;
+}
 
-	return buf[1]; /* First two bytes are len and descriptor type. */
+static void string_cache_free_entry(struct string_cache_entry *entry)
+{
+	size_t i;
+	for (i = 0; i < entry->num_strings; i++)
+		free(entry->strings[i].str);
+	free(entry->strings);
+	libusb_unref_device(entry->device);
+	free(entry);
+}
+
+/* Drop the entries of the devices which aren't in the list anymore.
+   If devs is NULL, drop everything. */
+static void string_cache_prune(libusb_device **devs)
+{
+	struct string_cache_entry **cur;
+
+	pthread_mutex_lock(&string_cache_mutex);
+	cur = &string_cache;
+	while (*cur) {
+		struct string_cache_entry *entry = *cur;
+		int found = 0;
+		if (devs) {
+			libusb_device **d;
+			for (d = devs; *d && !found; d++)
+				found = (*d == entry->device);
+		}
+		if (found) {
+			cur = &entry->next;
+		}
+		else {
+			*cur = entry->next;
+			string_cache_free_entry(entry);
+		}
+	}
+	pthread_mutex_unlock(&string_cache_mutex);
 }
 
-static int is_language_supported(libusb_device_handle *dev, uint16_t lang)
+/* Get the language to ask the strings of the device in: the one of the
+   current locale if the device supports it, the first language the
+   device reports otherwise. The languages come from USB string #0,
+   which is read only once per device. */
+static uint16_t get_string_language(libusb_device_handle *dev)
 {
+	struct string_cache_entry *entry;
 	uint16_t buf[32];
+	uint16_t lang = get_usb_code_for_current_locale();
+	int num_langids;
 	int len;
 	int i;
 
-	/* Get the string from libusb. */
-	len = libusb_get_string_descriptor(dev,
-			0x0, /* String ID */
-			0x0, /* Language */
-			(unsigned char*)buf,
-			sizeof(buf));
-	if (len < 4)
-		return 0x0;
+	pthread_mutex_lock(&string_cache_mutex);
+	entry = string_cache_get(libusb_get_device(dev));
+	num_langids = entry? entry->num_langids: -1;
+	if (num_langids > 0)
+		memcpy(buf + 1, entry->langids, num_langids * sizeof(uint16_t));
+	pthread_mutex_unlock(&string_cache_mutex);
+
+	if (num_langids < 0) {
+		/* Get the string from libusb. */
+		len = libusb_get_string_descriptor(dev,
+				0x0, /* String ID */
+				0x0, /* Language */
+				(unsigned char*)buf,
+				sizeof(buf));
+		/* language IDs are two-bytes each, skipping two bytes of protocol data. */
+		num_langids = (len < 4)? 0: len / 2 - 1;
+
+		/* A failure isn't cached, the device may answer next time */
+		if (len >= 4) {
+			pthread_mutex_lock(&string_cache_mutex);
+			entry = string_cache_get(libusb_get_device(dev));
+			if (entry) {
+				memcpy(entry->langids, buf + 1, num_langids * sizeof(uint16_t));
+				entry->num_langids = num_langids;
+			}
+			pthread_mutex_unlock(&string_cache_mutex);
+		}
+	}
 
+	if (num_langids == 0)
+		return 0x0;
 
-	len /= 2; /* language IDs are two-bytes each. */
-	/* Start at index 1 because there are two bytes of protocol data. */
-	for (i = 1; i < len; i++) {
+	for (i = 1; i <= num_langids; i++) {
 		if (buf[i] == lang)
-			return 1;
+			return lang;
 	}
 
-	return 0;
+	return buf[1]; /* The first language */
+}
+
+/* Returns a newly allocated copy of the cached string, or NULL. */
+static wchar_t *string_cache_lookup(libusb_device_handle *dev, uint8_t idx, uint16_t lang)
+{
+	struct string_cache_entry *entry;
+	wchar_t *str = NULL;
+	size_t i;
+
+	pthread_mutex_lock(&string_cache_mutex);
+	entry = string_cache_get(libusb_get_device(dev));
+	for (i = 0; entry && i < entry->num_strings; i++) {
+		if (entry->strings[i].index == idx && entry->strings[i].lang == lang) {
+			str = dup_wide_string(entry->strings[i].str);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&string_cache_mutex);
+
+	return str;
+}
+
+static void string_cache_store(libusb_device_handle *dev, uint8_t idx, uint16_t lang, const wchar_t *str)
+{
+	struct string_cache_entry *entry;
+	struct cached_string *strings;
+
+	pthread_mutex_lock(&string_cache_mutex);
+	entry = string_cache_get(libusb_get_device(dev));
+	if (entry) {
+		strings = (struct cached_string*) realloc(entry->strings, (entry->num_strings + 1) * sizeof(*strings));
+		if (strings) {
+			entry->strings = strings;
+			strings[entry->num_strings].index = idx;
+			strings[entry->num_strings].lang = lang;
+			strings[entry->num_strings].str = dup_wide_string(str);
+			if (strings[entry->num_strings].str)
+				entry->num_strings++;
+		}
+	}
+	pthread_mutex_unlock(&string_cache_mutex);
 }
 
 
@@ -402,89 +758,32 @@ static int is_language_supported(libusb_device_handle *dev, uint16_t lang)
    by using free(). */
 static wchar_t *get_usb_string(libusb_device_handle *dev, uint8_t idx)
 {
-	char buf[512];
+	unsigned char buf[512];
 	int len;
 	wchar_t *str = NULL;
 
-#if !defined(__ANDROID__) && !defined(NO_ICONV) /* we don't use iconv on Android, or when it is explicitly disabled */
-	wchar_t wbuf[256];
-	/* iconv variables */
-	iconv_t ic;
-	size_t inbytes;
-	size_t outbytes;
-	size_t res;
-	ICONV_CONST char *inptr;
-	char *outptr;
-#endif
-
 	/* Determine which language to use. */
 	uint16_t lang;
-	lang = get_usb_code_for_current_locale();
-	if (!is_language_supported(dev, lang))
-		lang = get_first_language(dev);
+	lang = get_string_language(dev);
+
+	str = string_cache_lookup(dev, idx, lang);
+	if (str)
+		return str;
 
 	/* Get the string from libusb. */
 	len = libusb_get_string_descriptor(dev,
 			idx,
 			lang,
-			(unsigned char*)buf,
+			buf,
 			sizeof(buf));
 	if (len < 2) /* we always skip first 2 bytes */
 		return NULL;
 
-#if defined(__ANDROID__) || defined(NO_ICONV)
-
-	/* Bionic does not have iconv support nor wcsdup() function, so it
-	   has to be done manually.  The following code will only work for
-	   code points that can be represented as a single UTF-16 character,
-	   and will incorrectly convert any code points which require more
-	   than one UTF-16 character.
-
-	   Skip over the first character (2-bytes).  */
-	len -= 2;
-	str = (wchar_t*) malloc((len / 2 + 1) * sizeof(wchar_t));
-	int i;
-	for (i = 0; i < len / 2; i++) {
-		str[i] = buf[i * 2 + 2] | (buf[i * 2 + 3] << 8);
-	}
-	str[len / 2] = 0x00000000;
-
-#else
-
-	/* buf does not need to be explicitly NULL-terminated because
-	   it is only passed into iconv() which does not need it. */
-
-	/* Initialize iconv. */
-	ic = iconv_open("WCHAR_T", "UTF-16LE");
-	if (ic == (iconv_t)-1) {
-		LOG("iconv_open() failed\n");
-		return NULL;
-	}
-
-	/* Convert to native wchar_t (UTF-32 on glibc/BSD systems).
-	   Skip the first character (2-bytes). */
-	inptr = buf+2;
-	inbytes = len-2;
-	outptr = (char*) wbuf;
-	outbytes = sizeof(wbuf);
-	res = iconv(ic, &inptr, &inbytes, &outptr, &outbytes);
-	if (res == (size_t)-1) {
-		LOG("iconv() failed\n");
-		goto err;
-	}
-
-	/* Write the terminating NULL. */
-	wbuf[sizeof(wbuf)/sizeof(wbuf[0])-1] = 0x00000000;
-	if (outbytes >= sizeof(wbuf[0]))
-		*((wchar_t*)outptr) = 0x00000000;
-
-	/* Allocate and copy the string. */
-	str = wcsdup(wbuf);
-
-err:
-	iconv_close(ic);
+	/* Skip over the descriptor header (2 bytes). */
+	str = hidapi_utf16le_to_wchar(buf + 2, len - 2);
 
-#endif
+	if (str)
+		string_cache_store(dev, idx, lang, str);
 
 	return str;
 }
@@ -526,6 +825,75 @@ static char *make_path(libusb_device *dev, int config_number, int interface_numb
 	return strdup(str);
 }
 
+/* The location of an interface, as written by get_path() */
+struct usb_path {
+	uint8_t bus_number;
+	uint8_t port_numbers[8];
+	int num_ports;
+	uint8_t config_number;
+	uint8_t interface_number;
+};
+
+static int parse_path_number(const char **str, uint8_t *value)
+{
+	unsigned long number;
+	char *end;
+
+	if (**str < '0' || **str > '9')
+		return -1;
+
+	number = strtoul(*str, &end, 10);
+	if (number > 0xFF)
+		return -1;
+
+	*value = (uint8_t) number;
+	*str = end;
+	return 0;
+}
+
+/* Parses "bus-port[.port]*:config.interface". Returns -1 if the path
+   isn't one hidapi has made. */
+static int parse_path(const char *path, struct usb_path *result)
+{
+	const char *str = path;
+
+	if (parse_path_number(&str, &result->bus_number) < 0 || *str++ != '-')
+		return -1;
+
+	result->num_ports = 0;
+	do {
+		if (result->num_ports == (int) sizeof(result->port_numbers))
+			return -1;
+		if (parse_path_number(&str, &result->port_numbers[result->num_ports++]) < 0)
+			return -1;
+	} while (*str++ == '.');
+
+	if (str[-1] != ':')
+		return -1;
+
+	if (parse_path_number(&str, &result->config_number) < 0 || *str++ != '.')
+		return -1;
+	if (parse_path_number(&str, &result->interface_number) < 0 || *str != '\0')
+		return -1;
+
+	return 0;
+}
+
+/* Both the bus and port numbers are kept in memory by libusb,
+   no I/O is done to compare them. */
+static int device_matches_path(libusb_device *dev, const struct usb_path *path)
+{
+	uint8_t port_numbers[8];
+	int num_ports;
+
+	if (libusb_get_bus_number(dev) != path->bus_number)
+		return 0;
+
+	num_ports = libusb_get_port_numbers(dev, port_numbers, sizeof(port_numbers));
+	return num_ports == path->num_ports
+		&& memcmp(port_numbers, path->port_numbers, num_ports) == 0;
+}
+
 HID_API_EXPORT const struct hid_api_version* HID_API_CALL hid_version()
 {
 	return &api_version;
@@ -557,6 +925,8 @@ int HID_API_EXPORT hid_init(void)
 int HID_API_EXPORT hid_exit(void)
 {
 	if (usb_context) {
+		hotplug_stop();
+		string_cache_prune(NULL);
 		libusb_exit(usb_context);
 		usb_context = NULL;
 	}
@@ -587,27 +957,149 @@ static int hid_get_report_descriptor_libusb(libusb_device_handle *handle, int in
 	return res;
 }
 
+#ifdef __linux__
+/* Reads the report descriptor of a HID interface from sysfs, which needs
+   neither privileges nor the device to be opened. The interface is
+   /sys/bus/usb/devices/<path>, path being the one get_path() makes, and
+   the HID device under it is named <bus>:<vendor>:<product>.<instance>.
+   Returns the size of the descriptor, or -1 if no HID driver is bound. */
+static int get_report_descriptor_from_sysfs(const char *path, unsigned char *buf, size_t buf_size)
+{
+	char intf_path[96];
+	DIR *dir;
+	struct dirent *entry;
+	int res = -1;
+
+	snprintf(intf_path, sizeof(intf_path), "/sys/bus/usb/devices/%s", path);
+	dir = opendir(intf_path);
+	if (!dir)
+		return -1;
+
+	while (res < 0 && (entry = readdir(dir)) != NULL) {
+		char rpt_path[NAME_MAX + sizeof("/report_descriptor")];
+		ssize_t len;
+		int fd;
+
+		if (strlen(entry->d_name) < sizeof("0003:0000:0000.0") - 1
+		 || entry->d_name[4] != ':' || entry->d_name[9] != ':')
+			continue;
+
+		snprintf(rpt_path, sizeof(rpt_path), "%s/report_descriptor", entry->d_name);
+		fd = openat(dirfd(dir), rpt_path, O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+			continue;
+		len = read(fd, buf, buf_size);
+		close(fd);
+		if (len >= 0)
+			res = (int) len;
+	}
+
+	closedir(dir);
+	return res;
+}
+#endif /* __linux__ */
+
+/* Matches all the devices */
+static const struct hid_enum_filter enum_filter_all;
+
+static int usage_matches_filter(const struct hid_enum_filter *filter, unsigned short usage_page, unsigned short usage)
+{
+	return (filter->usage_page == 0 || filter->usage_page == usage_page)
+	    && (filter->usage == 0 || filter->usage == usage);
+}
+
+static int serial_number_matches_filter(const struct hid_enum_filter *filter, const wchar_t *serial_number)
+{
+	if (!filter->serial_number_prefix)
+		return 1;
+	return serial_number
+	    && wcsncmp(serial_number, filter->serial_number_prefix, wcslen(filter->serial_number_prefix)) == 0;
+}
+
+/* Non-zero if a record matches all the criteria of the filter */
+static int device_info_matches_filter(const struct hid_enum_filter *filter, const struct hid_device_info *info)
+{
+	return (filter->vendor_id == 0 || filter->vendor_id == info->vendor_id)
+	    && (filter->product_id == 0 || filter->product_id == info->product_id)
+	    && (filter->bus_type == HID_API_BUS_UNKNOWN || filter->bus_type == info->bus_type)
+	    && (!(filter->flags & HID_API_ENUM_MATCH_INTERFACE) || filter->interface_number == info->interface_number)
+	    && usage_matches_filter(filter, info->usage_page, info->usage)
+	    && serial_number_matches_filter(filter, info->serial_number);
+}
+
+#ifdef HIDAPI_READ_USAGES
+static struct hid_device_info *copy_device_info(const struct hid_device_info *info);
+
+/* Sets the usages of the record from the report descriptor of its
+   interface, as the hidraw backend does: the first pair matching the
+   filter completes the record, and a copy of it is made for each
+   additional pair (one per top-level collection), linked after it. */
+static void fill_device_info_usages(struct hid_device_info *info, const unsigned char *report_descriptor, size_t size, const struct hid_enum_filter *filter)
+{
+	struct hid_device_info *cur_dev = info;
+	unsigned short page = 0, usage = 0;
+	unsigned int pos = 0;
+	int have_usage = 0;
+
+	while (!hidapi_get_next_usage(report_descriptor, size, &pos, &page, &usage)) {
+		struct hid_device_info *tmp;
+
+		if (!usage_matches_filter(filter, page, usage))
+			continue;
+
+		if (!have_usage) {
+			info->usage_page = page;
+			info->usage = usage;
+			have_usage = 1;
+			continue;
+		}
+
+		/* Create new record for additional usage pairs */
+		tmp = copy_device_info(info);
+		if (!tmp)
+			continue;
+		tmp->usage_page = page;
+		tmp->usage = usage;
+
+		cur_dev->next = tmp;
+		cur_dev = tmp;
+	}
+}
+#endif /* HIDAPI_READ_USAGES */
+
+#ifdef __linux__
+/* Returns 0 if the report descriptor isn't in sysfs */
+static int fill_device_info_usages_from_sysfs(struct hid_device_info *info, const struct hid_enum_filter *filter)
+{
+	unsigned char report_descriptor[HID_API_MAX_REPORT_DESCRIPTOR_SIZE];
+	int size;
+
+	size = get_report_descriptor_from_sysfs(info->path, report_descriptor, sizeof(report_descriptor));
+	if (size < 0)
+		return 0;
+
+	fill_device_info_usages(info, report_descriptor, (size_t) size, filter);
+	return 1;
+}
+#endif /* __linux__ */
+
+#ifdef INVASIVE_GET_USAGE
 /**
  * Requires an opened device with *claimed interface*.
  */
-static void fill_device_info_usage(struct hid_device_info *cur_dev, libusb_device_handle *handle, int interface_num, uint16_t expected_report_descriptor_size)
+static void fill_device_info_usage(struct hid_device_info *cur_dev, libusb_device_handle *handle, int interface_num, uint16_t expected_report_descriptor_size, const struct hid_enum_filter *filter)
 {
 	unsigned char hid_report_descriptor[HID_API_MAX_REPORT_DESCRIPTOR_SIZE];
-	unsigned short page = 0, usage = 0;
 
 	int res = hid_get_report_descriptor_libusb(handle, interface_num, expected_report_descriptor_size, hid_report_descriptor, sizeof(hid_report_descriptor));
 	if (res >= 0) {
 		/* Parse the usage and usage page
 		   out of the report descriptor. */
-		get_usage(hid_report_descriptor, res,  &page, &usage);
+		fill_device_info_usages(cur_dev, hid_report_descriptor, (size_t) res, filter);
 	}
-
-	cur_dev->usage_page = page;
-	cur_dev->usage = usage;
 }
 
-#ifdef INVASIVE_GET_USAGE
-static void invasive_fill_device_info_usage(struct hid_device_info *cur_dev, libusb_device_handle *handle, int interface_num, uint16_t report_descriptor_size)
+static void invasive_fill_device_info_usage(struct hid_device_info *cur_dev, libusb_device_handle *handle, int interface_num, uint16_t report_descriptor_size, const struct hid_enum_filter *filter)
 {
 	int res = 0;
 
@@ -626,7 +1118,7 @@ static void invasive_fill_device_info_usage(struct hid_device_info *cur_dev, lib
 
 	res = libusb_claim_interface(handle, interface_num);
 	if (res >= 0) {
-		fill_device_info_usage(cur_dev, handle, interface_num, report_descriptor_size);
+		fill_device_info_usage(cur_dev, handle, interface_num, report_descriptor_size, filter);
 
 		/* Release the interface */
 		res = libusb_release_interface(handle, interface_num);
@@ -650,8 +1142,10 @@ static void invasive_fill_device_info_usage(struct hid_device_info *cur_dev, lib
 /**
  * Create and fill up most of hid_device_info fields.
  * usage_page/usage is not filled up.
+ * Returns NULL if the serial number doesn't match the filter,
+ * or can't be read to be checked (no handle).
  */
-static struct hid_device_info * create_device_info_for_device(libusb_device *device, libusb_device_handle *handle, struct libusb_device_descriptor *desc, int config_number, int interface_num)
+static struct hid_device_info * create_device_info_for_device(libusb_device *device, libusb_device_handle *handle, struct libusb_device_descriptor *desc, int config_number, int interface_num, const struct hid_enum_filter *filter)
 {
 	struct hid_device_info *cur_dev = calloc(1, sizeof(struct hid_device_info));
 	if (cur_dev == NULL) {
@@ -671,12 +1165,24 @@ static struct hid_device_info * create_device_info_for_device(libusb_device *dev
 	cur_dev->path = make_path(device, config_number, interface_num);
 
 	if (!handle) {
+		if (filter->serial_number_prefix) {
+			hidapi_free_device_info_list(cur_dev);
+			return NULL;
+		}
 		return cur_dev;
 	}
 
-	if (desc->iSerialNumber > 0)
+	if (desc->iSerialNumber > 0 && (!(filter->flags & HID_API_ENUM_SKIP_STRINGS) || filter->serial_number_prefix))
 		cur_dev->serial_number = get_usb_string(handle, desc->iSerialNumber);
 
+	if (!serial_number_matches_filter(filter, cur_dev->serial_number)) {
+		hidapi_free_device_info_list(cur_dev);
+		return NULL;
+	}
+
+	if (filter->flags & HID_API_ENUM_SKIP_STRINGS)
+		return cur_dev;
+
 	/* Manufacturer and Product strings */
 	if (desc->iManufacturer > 0)
 		cur_dev->manufacturer_string = get_usb_string(handle, desc->iManufacturer);
@@ -739,50 +1245,51 @@ static uint16_t get_report_descriptor_size_from_interface_descriptors(const stru
 	return result;
 }
 
-struct hid_device_info  HID_API_EXPORT *hid_enumerate(unsigned short vendor_id, unsigned short product_id)
+/* Creates the hid_device_info records of the HID interfaces of the device
+   matching the filter. The device is only opened if something has to be
+   read from it: the strings, or (with INVASIVE_GET_USAGE, when they
+   aren't in sysfs) the usages.
+   It is opened once, the handle serves all of its interfaces. */
+static struct hid_device_info *create_device_info_for_hid_interfaces(libusb_device *dev, struct libusb_device_descriptor *desc, const struct hid_enum_filter *filter)
 {
-	libusb_device **devs;
-	libusb_device *dev;
+	struct libusb_config_descriptor *conf_desc = NULL;
 	libusb_device_handle *handle = NULL;
-	ssize_t num_devs;
-	int i = 0;
-
-	struct hid_device_info *root = NULL; /* return object */
+	struct hid_device_info *root = NULL;
 	struct hid_device_info *cur_dev = NULL;
+	int need_handle = !(filter->flags & HID_API_ENUM_SKIP_STRINGS) || filter->serial_number_prefix;
+	int open_tried = 0;
+	int res;
+	int j, k;
 
-	if(hid_init() < 0)
-		return NULL;
-
-	num_devs = libusb_get_device_list(usb_context, &devs);
-	if (num_devs < 0)
-		return NULL;
-	while ((dev = devs[i++]) != NULL) {
-		struct libusb_device_descriptor desc;
-		struct libusb_config_descriptor *conf_desc = NULL;
-		int j, k;
+#ifdef HIDAPI_READ_USAGES
+	int read_usages = !(filter->flags & HID_API_ENUM_SKIP_USAGES) || filter->usage_page != 0 || filter->usage != 0;
+#endif
+#ifdef INVASIVE_GET_USAGE
+	if (read_usages)
+		need_handle = 1;
+#endif
 
-		int res = libusb_get_device_descriptor(dev, &desc);
-		unsigned short dev_vid = desc.idVendor;
-		unsigned short dev_pid = desc.idProduct;
+	res = libusb_get_active_config_descriptor(dev, &conf_desc);
+	if (res < 0)
+		libusb_get_config_descriptor(dev, 0, &conf_desc);
+	if (conf_desc) {
+		for (j = 0; j < conf_desc->bNumInterfaces; j++) {
+			const struct libusb_interface *intf = &conf_desc->interface[j];
+			for (k = 0; k < intf->num_altsetting; k++) {
+				const struct libusb_interface_descriptor *intf_desc;
+				intf_desc = &intf->altsetting[k];
+				if (intf_desc->bInterfaceClass == LIBUSB_CLASS_HID) {
+					struct hid_device_info *tmp;
 
-		if ((vendor_id != 0x0 && vendor_id != dev_vid) ||
-		    (product_id != 0x0 && product_id != dev_pid)) {
-			continue;
-		}
+					if ((filter->flags & HID_API_ENUM_MATCH_INTERFACE) && filter->interface_number != intf_desc->bInterfaceNumber)
+						continue;
 
-		res = libusb_get_active_config_descriptor(dev, &conf_desc);
-		if (res < 0)
-			libusb_get_config_descriptor(dev, 0, &conf_desc);
-		if (conf_desc) {
-			for (j = 0; j < conf_desc->bNumInterfaces; j++) {
-				const struct libusb_interface *intf = &conf_desc->interface[j];
-				for (k = 0; k < intf->num_altsetting; k++) {
-					const struct libusb_interface_descriptor *intf_desc;
-					intf_desc = &intf->altsetting[k];
-					if (intf_desc->bInterfaceClass == LIBUSB_CLASS_HID) {
-						struct hid_device_info *tmp;
-
-						res = libusb_open(dev, &handle);
+					/* Opened at the first matching HID interface,
+					   a failure isn't retried for the next ones */
+					if (need_handle && !open_tried) {
+						open_tried = 1;
+						if (libusb_open(dev, &handle) < 0)
+							handle = NULL;
 
 #ifdef __ANDROID__
 						if (handle) {
@@ -793,660 +1300,2184 @@ struct hid_device_info  HID_API_EXPORT *hid_enumerate(unsigned short vendor_id,
 							   Even if it is not going to be accepted into libusb master,
 							   having it here won't do any harm, since reading the device descriptor
 							   is as cheap as copy 18 bytes of data. */
-							libusb_get_device_descriptor(dev, &desc);
+							libusb_get_device_descriptor(dev, desc);
 						}
 #endif
+					}
+
+					tmp = create_device_info_for_device(dev, handle, desc, conf_desc->bConfigurationValue, intf_desc->bInterfaceNumber, filter);
+#ifdef HIDAPI_READ_USAGES
+					if (tmp && read_usages) {
+						int usages_read = 0;
+
+#ifdef __linux__
+						usages_read = fill_device_info_usages_from_sysfs(tmp, filter);
+#endif
 
-						tmp = create_device_info_for_device(dev, handle, &desc, conf_desc->bConfigurationValue, intf_desc->bInterfaceNumber);
-						if (tmp) {
 #ifdef INVASIVE_GET_USAGE
-							/* TODO: have a runtime check for this section. */
-
-							/*
-							This section is removed because it is too
-							invasive on the system. Getting a Usage Page
-							and Usage requires parsing the HID Report
-							descriptor. Getting a HID Report descriptor
-							involves claiming the interface. Claiming the
-							interface involves detaching the kernel driver.
-							Detaching the kernel driver is hard on the system
-							because it will unclaim interfaces (if another
-							app has them claimed) and the re-attachment of
-							the driver will sometimes change /dev entry names.
-							It is for these reasons that this section is
-							optional. For composite devices, use the interface
-							field in the hid_device_info struct to distinguish
-							between interfaces. */
-							if (handle) {
-								uint16_t report_descriptor_size = get_report_descriptor_size_from_interface_descriptors(intf_desc);
-
-								invasive_fill_device_info_usage(tmp, handle, intf_desc->bInterfaceNumber, report_descriptor_size);
-							}
+						/* TODO: have a runtime check for this section. */
+
+						/*
+						This section is removed because it is too
+						invasive on the system. Getting a Usage Page
+						and Usage requires parsing the HID Report
+						descriptor. Getting a HID Report descriptor
+						involves claiming the interface. Claiming the
+						interface involves detaching the kernel driver.
+						Detaching the kernel driver is hard on the system
+						because it will unclaim interfaces (if another
+						app has them claimed) and the re-attachment of
+						the driver will sometimes change /dev entry names.
+						It is for these reasons that this section is
+						optional. For composite devices, use the interface
+						field in the hid_device_info struct to distinguish
+						between interfaces. */
+						if (handle && !usages_read) {
+							uint16_t report_descriptor_size = get_report_descriptor_size_from_interface_descriptors(intf_desc);
+
+							invasive_fill_device_info_usage(tmp, handle, intf_desc->bInterfaceNumber, report_descriptor_size, filter);
+						}
 #endif /* INVASIVE_GET_USAGE */
+						(void) usages_read;
+
+						/* The first record has the first matching pair, if any.
+						   Usages which couldn't be read (e.g. no handle) are 0,
+						   so they never match a usage filter either. */
+						if (!usage_matches_filter(filter, tmp->usage_page, tmp->usage)) {
+							hidapi_free_device_info_list(tmp);
+							tmp = NULL;
+						}
+					}
+#endif /* HIDAPI_READ_USAGES */
 
-							if (cur_dev) {
-								cur_dev->next = tmp;
-							}
-							else {
-								root = tmp;
-							}
-							cur_dev = tmp;
+					if (tmp) {
+						if (cur_dev) {
+							cur_dev->next = tmp;
 						}
+						else {
+							root = tmp;
+						}
+						cur_dev = tmp;
 
-						if (res >= 0)
-							libusb_close(handle);
+						/* One record per top-level collection */
+						while (cur_dev->next != NULL) {
+							cur_dev = cur_dev->next;
+						}
 					}
-				} /* altsettings */
-			} /* interfaces */
-			libusb_free_config_descriptor(conf_desc);
-		}
+				}
+			} /* altsettings */
+		} /* interfaces */
+		libusb_free_config_descriptor(conf_desc);
 	}
 
-	libusb_free_device_list(devs, 1);
+	if (handle)
+		libusb_close(handle);
 
 	return root;
 }
 
-void  HID_API_EXPORT hid_free_enumeration(struct hid_device_info *devs)
+struct hid_device_info  HID_API_EXPORT *hid_enumerate(unsigned short vendor_id, unsigned short product_id)
 {
-	struct hid_device_info *d = devs;
-	while (d) {
-		struct hid_device_info *next = d->next;
-		free(d->path);
-		free(d->serial_number);
-		free(d->manufacturer_string);
-		free(d->product_string);
-		free(d);
-		d = next;
-	}
-}
+	struct hid_enum_filter filter;
 
-hid_device * hid_open(unsigned short vendor_id, unsigned short product_id, const wchar_t *serial_number)
-{
-	struct hid_device_info *devs, *cur_dev;
-	const char *path_to_open = NULL;
-	hid_device *handle = NULL;
+	memset(&filter, 0, sizeof(filter));
+	filter.vendor_id = vendor_id;
+	filter.product_id = product_id;
 
-	devs = hid_enumerate(vendor_id, product_id);
-	cur_dev = devs;
-	while (cur_dev) {
-		if (cur_dev->vendor_id == vendor_id &&
-		    cur_dev->product_id == product_id) {
-			if (serial_number) {
-				if (cur_dev->serial_number &&
-				    wcscmp(serial_number, cur_dev->serial_number) == 0) {
-					path_to_open = cur_dev->path;
-					break;
-				}
-			}
-			else {
-				path_to_open = cur_dev->path;
-				break;
-			}
-		}
-		cur_dev = cur_dev->next;
-	}
+	return hid_enumerate_ex(&filter);
+}
 
-	if (path_to_open) {
-		/* Open the device */
-		handle = hid_open_path(path_to_open);
-	}
+/* A device matching the VID/PID of the filter, to be read by enumerate_device() */
+struct enumerated_device {
+	libusb_device *device;
+	struct libusb_device_descriptor desc;
+	struct hid_device_info *info; /* NULL if not listed */
+};
 
-	hid_free_enumeration(devs);
+struct enumeration_job {
+	struct enumerated_device *devices;
+	const struct hid_enum_filter *filter;
+};
 
-	return handle;
+static void enumerate_device(size_t index, void *context)
+{
+	struct enumeration_job *job = (struct enumeration_job*) context;
+	struct enumerated_device *enumerated = &job->devices[index];
+
+	enumerated->info = create_device_info_for_hid_interfaces(enumerated->device, &enumerated->desc, job->filter);
 }
 
-static void read_callback(struct libusb_transfer *transfer)
+struct hid_device_info HID_API_EXPORT *hid_enumerate_ex(const struct hid_enum_filter *filter)
 {
-	hid_device *dev = transfer->user_data;
-	int res;
+	libusb_device **devs;
+	libusb_device *dev;
+	ssize_t num_devs;
+	size_t num_matching = 0;
+	size_t j;
+	int i = 0;
 
-	if (transfer->status == LIBUSB_TRANSFER_COMPLETED) {
+	struct enumeration_job job;
+	struct hid_device_info *root = NULL; /* return object */
+	struct hid_device_info *cur_dev = NULL;
+
+	if(hid_init() < 0)
+		return NULL;
 
-		struct input_report *rpt = (struct input_report*) malloc(sizeof(*rpt));
-		rpt->data = (uint8_t*) malloc(transfer->actual_length);
-		memcpy(rpt->data, transfer->buffer, transfer->actual_length);
-		rpt->len = transfer->actual_length;
-		rpt->next = NULL;
+	if (!filter)
+		filter = &enum_filter_all;
 
-		pthread_mutex_lock(&dev->mutex);
+	/* All the devices are USB devices */
+	if (filter->bus_type != HID_API_BUS_UNKNOWN && filter->bus_type != HID_API_BUS_USB)
+		return NULL;
+
+#ifndef HIDAPI_READ_USAGES
+	/* The usages aren't read, none of the devices has the requested one */
+	if (filter->usage_page != 0 || filter->usage != 0)
+		return NULL;
+#endif
+
+	/* Served from memory while the cache is up */
+	if (use_enumeration_cache && hotplug_copy_devices(filter, &root) == 0)
+		return hidapi_pack_device_info_list(root);
+
+	num_devs = libusb_get_device_list(usb_context, &devs);
+	if (num_devs < 0)
+		return NULL;
+
+	job.devices = (struct enumerated_device*) calloc((size_t) num_devs + 1, sizeof(*job.devices));
+	job.filter = filter;
+	if (!job.devices) {
+		libusb_free_device_list(devs, 1);
+		return NULL;
+	}
+
+	/* Forget the strings of the devices which are gone */
+	string_cache_prune(devs);
 
-		/* Attach the new report object to the end of the list. */
-		if (dev->input_reports == NULL) {
-			/* The list is empty. Put it at the root. */
-			dev->input_reports = rpt;
-			pthread_cond_signal(&dev->condition);
+	/* The device descriptors are in memory already,
+	   only the matching devices are opened (maybe concurrently) */
+	while ((dev = devs[i++]) != NULL) {
+		struct enumerated_device *enumerated = &job.devices[num_matching];
+
+		libusb_get_device_descriptor(dev, &enumerated->desc);
+
+		if ((filter->vendor_id != 0x0 && filter->vendor_id != enumerated->desc.idVendor) ||
+		    (filter->product_id != 0x0 && filter->product_id != enumerated->desc.idProduct)) {
+			continue;
 		}
-		else {
-			/* Find the end of the list and attach. */
-			struct input_report *cur = dev->input_reports;
-			int num_queued = 0;
-			while (cur->next != NULL) {
-				cur = cur->next;
-				num_queued++;
+
+		enumerated->device = dev;
+		num_matching++;
+	}
+
+	hidapi_parallel_for(num_matching, enumeration_threads, enumeration_timeout_ms, enumerate_device, &job);
+
+	/* In the order of the device list */
+	for (j = 0; j < num_matching; j++) {
+		struct hid_device_info *tmp = job.devices[j].info;
+
+		if (tmp) {
+			if (cur_dev) {
+				cur_dev->next = tmp;
+			}
+			else {
+				root = tmp;
 			}
-			cur->next = rpt;
+			cur_dev = tmp;
 
-			/* Pop one off if we've reached 30 in the queue. This
-			   way we don't grow forever if the user never reads
-			   anything from the device. */
-			if (num_queued > 30) {
-				return_data(dev, NULL, 0);
+			/* move the pointer to the tail of returned list */
+			while (cur_dev->next != NULL) {
+				cur_dev = cur_dev->next;
 			}
 		}
-		pthread_mutex_unlock(&dev->mutex);
-	}
-	else if (transfer->status == LIBUSB_TRANSFER_CANCELLED) {
-		dev->shutdown_thread = 1;
-	}
-	else if (transfer->status == LIBUSB_TRANSFER_NO_DEVICE) {
-		dev->shutdown_thread = 1;
-	}
-	else if (transfer->status == LIBUSB_TRANSFER_TIMED_OUT) {
-		//LOG("Timeout (normal)\n");
-	}
-	else {
-		LOG("Unknown transfer code: %d\n", transfer->status);
 	}
 
-	if (dev->shutdown_thread) {
-		dev->transfer_loop_finished = 1;
-		return;
-	}
+	free(job.devices);
+	libusb_free_device_list(devs, 1);
 
-	/* Re-submit the transfer object. */
-	res = libusb_submit_transfer(transfer);
-	if (res != 0) {
-		LOG("Unable to submit URB: (%d) %s\n", res, libusb_error_name(res));
-		dev->shutdown_thread = 1;
-		dev->transfer_loop_finished = 1;
-	}
+	/* A single allocation for all the records and their strings,
+	   freed at once by hid_free_enumeration() */
+	return hidapi_pack_device_info_list(root);
 }
 
+/* Gives the records of devs to the callback one at a time.
+   Returns non-zero if the callback stopped the enumeration. */
+static int report_device_info(struct hid_device_info *devs, hid_enumerate_callback_fn callback, void *user_data)
+{
+	struct hid_device_info *info;
+	struct hid_device_info *next;
+	int stop = 0;
 
-static void *read_thread(void *param)
+	for (info = devs; info && !stop; info = next) {
+		next = info->next;
+		info->next = NULL;
+		stop = callback(info, user_data);
+		info->next = next;
+	}
+
+	return stop;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_enumerate_each(const struct hid_enum_filter *filter, hid_enumerate_callback_fn callback, void *user_data)
 {
-	int res;
-	hid_device *dev = param;
-	uint8_t *buf;
-	const size_t length = dev->input_ep_max_packet_size;
+	libusb_device **devs;
+	libusb_device *dev;
+	ssize_t num_devs;
+	int stop = 0;
+	int i = 0;
 
-	/* Set up the transfer object. */
-	buf = (uint8_t*) malloc(length);
-	dev->transfer = libusb_alloc_transfer(0);
-	libusb_fill_interrupt_transfer(dev->transfer,
-		dev->device_handle,
-		dev->input_endpoint,
-		buf,
-		length,
-		read_callback,
-		dev,
-		5000/*timeout*/);
-
-	/* Make the first submission. Further submissions are made
-	   from inside read_callback() */
-	res = libusb_submit_transfer(dev->transfer);
-	if(res < 0) {
-                LOG("libusb_submit_transfer failed: %d %s. Stopping read_thread from running\n", res, libusb_error_name(res));
-                dev->shutdown_thread = 1;
-                dev->transfer_loop_finished = 1;
+	struct hid_device_info *infos;
+
+	if (!callback)
+		return -1;
+
+	if(hid_init() < 0)
+		return -1;
+
+	if (!filter)
+		filter = &enum_filter_all;
+
+	/* All the devices are USB devices */
+	if (filter->bus_type != HID_API_BUS_UNKNOWN && filter->bus_type != HID_API_BUS_USB)
+		return 0;
+
+#ifndef HIDAPI_READ_USAGES
+	/* The usages aren't read, none of the devices has the requested one */
+	if (filter->usage_page != 0 || filter->usage != 0)
+		return 0;
+#endif
+
+	/* Served from memory while the cache is up */
+	if (use_enumeration_cache && hotplug_copy_devices(filter, &infos) == 0) {
+		report_device_info(infos, callback, user_data);
+		hidapi_free_device_info_list(infos);
+		return 0;
 	}
 
-	/* Notify the main thread that the read thread is up and running. */
-	pthread_barrier_wait(&dev->barrier);
+	num_devs = libusb_get_device_list(usb_context, &devs);
+	if (num_devs < 0)
+		return -1;
 
-	/* Handle all the events. */
-	while (!dev->shutdown_thread) {
-		res = libusb_handle_events(usb_context);
-		if (res < 0) {
-			/* There was an error. */
-			LOG("read_thread(): (%d) %s\n", res, libusb_error_name(res));
+	/* Forget the strings of the devices which are gone */
+	string_cache_prune(devs);
 
-			/* Break out of this loop only on fatal error.*/
-			if (res != LIBUSB_ERROR_BUSY &&
-			    res != LIBUSB_ERROR_TIMEOUT &&
-			    res != LIBUSB_ERROR_OVERFLOW &&
-			    res != LIBUSB_ERROR_INTERRUPTED) {
-				dev->shutdown_thread = 1;
-				break;
-			}
+	/* Each device is reported before the next one is opened */
+	while (!stop && (dev = devs[i++]) != NULL) {
+		struct libusb_device_descriptor desc;
+
+		libusb_get_device_descriptor(dev, &desc);
+
+		if ((filter->vendor_id != 0x0 && filter->vendor_id != desc.idVendor) ||
+		    (filter->product_id != 0x0 && filter->product_id != desc.idProduct)) {
+			continue;
 		}
+
+		infos = create_device_info_for_hid_interfaces(dev, &desc, filter);
+		stop = report_device_info(infos, callback, user_data);
+		hidapi_free_device_info_list(infos);
 	}
 
-	/* Cancel any transfer that may be pending. This call will fail
-	   if no transfers are pending, but that's OK. */
-	libusb_cancel_transfer(dev->transfer);
+	libusb_free_device_list(devs, 1);
 
-	while (!dev->transfer_loop_finished)
-		libusb_handle_events_completed(usb_context, &dev->transfer_loop_finished);
+	return 0;
+}
 
-	/* Now that the read thread is stopping, Wake any threads which are
-	   waiting on data (in hid_read_timeout()). Do this under a mutex to
-	   make sure that a thread which is about to go to sleep waiting on
-	   the condition actually will go to sleep before the condition is
-	   signaled. */
-	pthread_mutex_lock(&dev->mutex);
-	pthread_cond_broadcast(&dev->condition);
-	pthread_mutex_unlock(&dev->mutex);
+void  HID_API_EXPORT hid_free_enumeration(struct hid_device_info *devs)
+{
+	/* The list is packed, see hid_enumerate_ex() */
+	free(devs);
+}
 
-	/* The dev->transfer->buffer and dev->transfer objects are cleaned up
-	   in hid_close(). They are not cleaned up here because this thread
-	   could end either due to a disconnect or due to a user
-	   call to hid_close(). In both cases the objects can be safely
-	   cleaned up after the call to pthread_join() (in hid_close()), but
-	   since hid_close() calls libusb_cancel_transfer(), on these objects,
-	   they can not be cleaned up here. */
+/* A registered hotplug callback, see hid_hotplug_register_callback() */
+struct hid_hotplug_callback {
+	hid_hotplug_callback_handle handle;
+	unsigned short vendor_id;
+	unsigned short product_id;
+	int events;
+	hid_hotplug_callback_fn callback; /* NULL once deregistered during a dispatch */
+	void *user_data;
+	struct hid_hotplug_callback *next;
+};
 
-	return NULL;
-}
+/* A connected device, with the records reported when it arrived */
+struct hotplug_device {
+	libusb_device *device;
+	struct hid_device_info *info;
+	struct hotplug_device *next;
+};
 
+/* An event received from libusb, not processed yet */
+struct hotplug_event {
+	libusb_device *device;
+	libusb_hotplug_event event;
+	struct hotplug_event *next;
+};
 
-static int hidapi_initialize_device(hid_device *dev, int config_number, const struct libusb_interface_descriptor *intf_desc)
+/* libusb hotplug callbacks run in the event handling thread, where
+   no synchronous I/O may be done. So they only queue the events, and
+   the hotplug thread reads the strings of the new devices and calls
+   the HIDAPI callbacks. Started with the first hotplug callback and
+   stopped by hid_exit(). */
+static struct {
+	pthread_once_t once;
+	/* Recursive, so that the callbacks may (de)register callbacks.
+	   Protects the fields up to the event queue. */
+	pthread_mutex_t mutex;
+	int running;
+	pthread_t thread;
+	libusb_hotplug_callback_handle libusb_handle;
+	struct hotplug_device *devices; /* Connected right now */
+	struct hid_hotplug_callback *callbacks;
+	hid_hotplug_callback_handle next_handle;
+	int dispatching;
+
+	pthread_mutex_t queue_mutex; /* Protects the fields below */
+	pthread_cond_t queue_condition;
+	struct hotplug_event *queue;
+	int stop;
+} hid_hotplug = {
+	.once = PTHREAD_ONCE_INIT,
+	.next_handle = 1,
+	.queue_mutex = PTHREAD_MUTEX_INITIALIZER,
+	.queue_condition = PTHREAD_COND_INITIALIZER,
+};
+
+static void hotplug_init_mutex(void)
 {
-	int i =0;
-	int res = 0;
-	struct libusb_device_descriptor desc;
-	libusb_get_device_descriptor(libusb_get_device(dev->device_handle), &desc);
+	pthread_mutexattr_t attr;
 
-#ifdef DETACH_KERNEL_DRIVER
-	/* Detach the kernel driver, but only if the
-	   device is managed by the kernel */
-	dev->is_driver_detached = 0;
-	if (libusb_kernel_driver_active(dev->device_handle, intf_desc->bInterfaceNumber) == 1) {
-		res = libusb_detach_kernel_driver(dev->device_handle, intf_desc->bInterfaceNumber);
-		if (res < 0) {
-			LOG("Unable to detach Kernel Driver: (%d) %s\n", res, libusb_error_name(res));
-			return 0;
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&hid_hotplug.mutex, &attr);
+	pthread_mutexattr_destroy(&attr);
+}
+
+/* hid_hotplug.mutex must be locked */
+static void hotplug_remove_deregistered(void)
+{
+	struct hid_hotplug_callback **cur = &hid_hotplug.callbacks;
+
+	while (*cur) {
+		struct hid_hotplug_callback *hotplug_cb = *cur;
+		if (hotplug_cb->callback) {
+			cur = &hotplug_cb->next;
 		}
 		else {
-			dev->is_driver_detached = 1;
-			LOG("Driver successfully detached from kernel.\n");
+			*cur = hotplug_cb->next;
+			free(hotplug_cb);
 		}
 	}
-#endif
-	res = libusb_claim_interface(dev->device_handle, intf_desc->bInterfaceNumber);
-	if (res < 0) {
-		LOG("can't claim interface %d: (%d) %s\n", intf_desc->bInterfaceNumber, res, libusb_error_name(res));
+}
 
-#ifdef DETACH_KERNEL_DRIVER
-		if (dev->is_driver_detached) {
-			res = libusb_attach_kernel_driver(dev->device_handle, intf_desc->bInterfaceNumber);
-			if (res < 0)
-				LOG("Failed to reattach the driver to kernel: (%d) %s\n", res, libusb_error_name(res));
-		}
-#endif
-		return 0;
-	}
+/* Calls the matching callbacks (or only the given one) for each of the records.
+   hid_hotplug.mutex must be locked. */
+static void hotplug_dispatch(struct hid_device_info *devs, hid_hotplug_event event, struct hid_hotplug_callback *only)
+{
+	struct hid_device_info *info;
 
-	/* Store off the string descriptor indexes */
-	dev->manufacturer_index = desc.iManufacturer;
-	dev->product_index      = desc.iProduct;
-	dev->serial_index       = desc.iSerialNumber;
+	hid_hotplug.dispatching++;
 
-	/* Store off the USB information */
-	dev->config_number = config_number;
-	dev->interface = intf_desc->bInterfaceNumber;
+	for (info = devs; info; ) {
+		struct hid_device_info *next = info->next;
+		struct hid_hotplug_callback *hotplug_cb;
 
-	dev->report_descriptor_size = get_report_descriptor_size_from_interface_descriptors(intf_desc);
+		/* Each interface is reported on its own */
+		info->next = NULL;
 
-	dev->input_endpoint = 0;
-	dev->input_ep_max_packet_size = 0;
-	dev->output_endpoint = 0;
+		for (hotplug_cb = only? only: hid_hotplug.callbacks; hotplug_cb; hotplug_cb = only? NULL: hotplug_cb->next) {
+			if (!hotplug_cb->callback || !(hotplug_cb->events & event))
+				continue;
+			if (hotplug_cb->vendor_id != 0 && hotplug_cb->vendor_id != info->vendor_id)
+				continue;
+			if (hotplug_cb->product_id != 0 && hotplug_cb->product_id != info->product_id)
+				continue;
 
-	/* Find the INPUT and OUTPUT endpoints. An
-	   OUTPUT endpoint is not required. */
-	for (i = 0; i < intf_desc->bNumEndpoints; i++) {
-		const struct libusb_endpoint_descriptor *ep
-			= &intf_desc->endpoint[i];
+			if (hotplug_cb->callback(hotplug_cb->handle, info, event, hotplug_cb->user_data))
+				hotplug_cb->callback = NULL;
+		}
 
-		/* Determine the type and direction of this
-		   endpoint. */
-		int is_interrupt =
-			(ep->bmAttributes & LIBUSB_TRANSFER_TYPE_MASK)
-		      == LIBUSB_TRANSFER_TYPE_INTERRUPT;
-		int is_output =
-			(ep->bEndpointAddress & LIBUSB_ENDPOINT_DIR_MASK)
-		      == LIBUSB_ENDPOINT_OUT;
-		int is_input =
-			(ep->bEndpointAddress & LIBUSB_ENDPOINT_DIR_MASK)
-		      == LIBUSB_ENDPOINT_IN;
+		info->next = next;
+		info = next;
+	}
 
-		/* Decide whether to use it for input or output. */
-		if (dev->input_endpoint == 0 &&
-		    is_interrupt && is_input) {
-			/* Use this endpoint for INPUT */
-			dev->input_endpoint = ep->bEndpointAddress;
-			dev->input_ep_max_packet_size = ep->wMaxPacketSize;
+	if (--hid_hotplug.dispatching == 0)
+		hotplug_remove_deregistered();
+}
+
+/* hid_hotplug.mutex must be locked, the device is referenced by the list */
+static void hotplug_add_device(libusb_device *device, struct hid_device_info *info)
+{
+	struct hotplug_device *hotplug_dev;
+	struct hotplug_device **last;
+
+	hotplug_dev = (struct hotplug_device*) calloc(1, sizeof(*hotplug_dev));
+	if (!hotplug_dev) {
+		hidapi_free_device_info_list(info);
+		return;
+	}
+
+	hotplug_dev->device = libusb_ref_device(device);
+	hotplug_dev->info = info;
+
+	/* After the devices known already, in the order they arrived */
+	for (last = &hid_hotplug.devices; *last; last = &(*last)->next)
+		;
+	*last = hotplug_dev;
+}
+
+static void hotplug_device_arrived(libusb_device *device)
+{
+	struct libusb_device_descriptor desc;
+	struct hid_device_info *info;
+	struct hotplug_device *hotplug_dev;
+
+	if (libusb_get_device_descriptor(device, &desc) < 0)
+		return;
+
+	/* Reading the strings happens without the lock held */
+	info = create_device_info_for_hid_interfaces(device, &desc, &enum_filter_all);
+	if (!info)
+		return;
+
+	pthread_mutex_lock(&hid_hotplug.mutex);
+
+	/* Already known, from the enumeration at startup */
+	for (hotplug_dev = hid_hotplug.devices; hotplug_dev; hotplug_dev = hotplug_dev->next) {
+		if (hotplug_dev->device == device) {
+			pthread_mutex_unlock(&hid_hotplug.mutex);
+			hidapi_free_device_info_list(info);
+			return;
 		}
-		if (dev->output_endpoint == 0 &&
-		    is_interrupt && is_output) {
-			/* Use this endpoint for OUTPUT */
-			dev->output_endpoint = ep->bEndpointAddress;
+	}
+
+	hotplug_dispatch(info, HID_API_HOTPLUG_EVENT_DEVICE_ARRIVED, NULL);
+	hotplug_add_device(device, info);
+
+	pthread_mutex_unlock(&hid_hotplug.mutex);
+}
+
+static void hotplug_device_left(libusb_device *device)
+{
+	struct hotplug_device **cur;
+	struct hotplug_device *gone = NULL;
+
+	pthread_mutex_lock(&hid_hotplug.mutex);
+
+	for (cur = &hid_hotplug.devices; *cur; cur = &(*cur)->next) {
+		if ((*cur)->device == device) {
+			gone = *cur;
+			*cur = gone->next;
+			break;
 		}
 	}
 
-	pthread_create(&dev->thread, NULL, read_thread, dev);
+	if (gone)
+		hotplug_dispatch(gone->info, HID_API_HOTPLUG_EVENT_DEVICE_LEFT, NULL);
 
-	/* Wait here for the read thread to be initialized. */
-	pthread_barrier_wait(&dev->barrier);
-	return 1;
+	pthread_mutex_unlock(&hid_hotplug.mutex);
+
+	if (gone) {
+		hidapi_free_device_info_list(gone->info);
+		libusb_unref_device(gone->device);
+		free(gone);
+	}
 }
 
+static int hotplug_libusb_callback(libusb_context *ctx, libusb_device *device, libusb_hotplug_event event, void *user_data)
+{
+	struct hotplug_event *hotplug_ev;
+	struct hotplug_event **last;
+
+	(void) ctx;
+	(void) user_data;
 
-hid_device * HID_API_EXPORT hid_open_path(const char *path)
+	hotplug_ev = (struct hotplug_event*) calloc(1, sizeof(*hotplug_ev));
+	if (!hotplug_ev) {
+		LOG("hotplug event lost: out of memory\n");
+		return 0;
+	}
+	hotplug_ev->device = libusb_ref_device(device);
+	hotplug_ev->event = event;
+
+	pthread_mutex_lock(&hid_hotplug.queue_mutex);
+	for (last = &hid_hotplug.queue; *last; last = &(*last)->next)
+		;
+	*last = hotplug_ev;
+	pthread_cond_signal(&hid_hotplug.queue_condition);
+	pthread_mutex_unlock(&hid_hotplug.queue_mutex);
+
+	return 0;
+}
+
+static void *hotplug_thread(void *param)
 {
-	hid_device *dev = NULL;
+	(void) param;
 
-	libusb_device **devs = NULL;
-	libusb_device *usb_dev = NULL;
-	int res = 0;
-	int d = 0;
-	int good_open = 0;
+	pthread_mutex_lock(&hid_hotplug.queue_mutex);
+	while (!hid_hotplug.stop) {
+		struct hotplug_event *hotplug_ev = hid_hotplug.queue;
+		if (!hotplug_ev) {
+			pthread_cond_wait(&hid_hotplug.queue_condition, &hid_hotplug.queue_mutex);
+			continue;
+		}
+		hid_hotplug.queue = hotplug_ev->next;
+		pthread_mutex_unlock(&hid_hotplug.queue_mutex);
 
-	if(hid_init() < 0)
+		if (hotplug_ev->event == LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED)
+			hotplug_device_arrived(hotplug_ev->device);
+		else
+			hotplug_device_left(hotplug_ev->device);
+
+		libusb_unref_device(hotplug_ev->device);
+		free(hotplug_ev);
+
+		pthread_mutex_lock(&hid_hotplug.queue_mutex);
+	}
+	pthread_mutex_unlock(&hid_hotplug.queue_mutex);
+
+	return NULL;
+}
+
+/* Free the known devices. Called with hid_hotplug.mutex locked. */
+static void hotplug_free_devices(void)
+{
+	struct hotplug_device *hotplug_dev = hid_hotplug.devices;
+
+	while (hotplug_dev) {
+		struct hotplug_device *next = hotplug_dev->next;
+		hidapi_free_device_info_list(hotplug_dev->info);
+		libusb_unref_device(hotplug_dev->device);
+		free(hotplug_dev);
+		hotplug_dev = next;
+	}
+	hid_hotplug.devices = NULL;
+}
+
+/* Free the events not handled by hotplug_thread(),
+   once libusb doesn't report any more of them. */
+static void hotplug_free_queue(void)
+{
+	struct hotplug_event *hotplug_ev = hid_hotplug.queue;
+
+	while (hotplug_ev) {
+		struct hotplug_event *next = hotplug_ev->next;
+		libusb_unref_device(hotplug_ev->device);
+		free(hotplug_ev);
+		hotplug_ev = next;
+	}
+	hid_hotplug.queue = NULL;
+}
+
+/* hid_hotplug.mutex must be locked */
+static int hotplug_start(void)
+{
+#if LIBUSB_API_VERSION >= 0x01000102
+	libusb_device **devs;
+	libusb_device *dev;
+	int res;
+	int i = 0;
+
+	if (hid_init() < 0)
+		return -1;
+
+	if (!libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG)) {
+		LOG("libusb doesn't support hotplug on this platform\n");
+		return -1;
+	}
+
+	/* libusb reports the events while handling them */
+	if (event_thread_acquire() < 0)
+		return -1;
+
+	/* Listen before enumerating, so that no device is missed
+	   (those found twice are ignored by hotplug_device_arrived()) */
+	hid_hotplug.stop = 0;
+	res = libusb_hotplug_register_callback(usb_context,
+		LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED | LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT,
+		0,
+		LIBUSB_HOTPLUG_MATCH_ANY, LIBUSB_HOTPLUG_MATCH_ANY, LIBUSB_HOTPLUG_MATCH_ANY,
+		hotplug_libusb_callback, NULL, &hid_hotplug.libusb_handle);
+	if (res != LIBUSB_SUCCESS) {
+		LOG("libusb_hotplug_register_callback() failed: (%d) %s\n", res, libusb_error_name(res));
+		event_thread_release();
+		return -1;
+	}
+
+	if (libusb_get_device_list(usb_context, &devs) >= 0) {
+		while ((dev = devs[i++]) != NULL) {
+			struct libusb_device_descriptor desc;
+			struct hid_device_info *info;
+
+			if (libusb_get_device_descriptor(dev, &desc) < 0)
+				continue;
+			info = create_device_info_for_hid_interfaces(dev, &desc, &enum_filter_all);
+			if (info)
+				hotplug_add_device(dev, info);
+		}
+		libusb_free_device_list(devs, 1);
+	}
+
+	if (pthread_create(&hid_hotplug.thread, NULL, hotplug_thread, NULL) != 0) {
+		libusb_hotplug_deregister_callback(usb_context, hid_hotplug.libusb_handle);
+		event_thread_release();
+		hotplug_free_queue();
+		hotplug_free_devices();
+		return -1;
+	}
+
+	hid_hotplug.running = 1;
+	return 0;
+#else
+	LOG("hotplug requires libusb 1.0.16 or later\n");
+	return -1;
+#endif
+}
+
+static struct hid_device_info *copy_device_info(const struct hid_device_info *info)
+{
+	struct hid_device_info *copy = (struct hid_device_info*) calloc(1, sizeof(*copy));
+	if (!copy)
 		return NULL;
 
-	dev = new_hid_device();
+	*copy = *info;
+	copy->next = NULL;
+	copy->path = strdup(info->path);
+	copy->serial_number = info->serial_number? dup_wide_string(info->serial_number): NULL;
+	copy->manufacturer_string = info->manufacturer_string? dup_wide_string(info->manufacturer_string): NULL;
+	copy->product_string = info->product_string? dup_wide_string(info->product_string): NULL;
+
+	if (!copy->path
+	 || (info->serial_number && !copy->serial_number)
+	 || (info->manufacturer_string && !copy->manufacturer_string)
+	 || (info->product_string && !copy->product_string)) {
+		hidapi_free_device_info_list(copy);
+		return NULL;
+	}
 
-	libusb_get_device_list(usb_context, &devs);
-	while ((usb_dev = devs[d++]) != NULL && !good_open) {
-		struct libusb_config_descriptor *conf_desc = NULL;
-		int j,k;
+	return copy;
+}
 
-		if (libusb_get_active_config_descriptor(usb_dev, &conf_desc) < 0)
-			continue;
-		for (j = 0; j < conf_desc->bNumInterfaces && !good_open; j++) {
-			const struct libusb_interface *intf = &conf_desc->interface[j];
-			for (k = 0; k < intf->num_altsetting && !good_open; k++) {
-				const struct libusb_interface_descriptor *intf_desc = &intf->altsetting[k];
-				if (intf_desc->bInterfaceClass == LIBUSB_CLASS_HID) {
-					char dev_path[64];
-					get_path(&dev_path, usb_dev, conf_desc->bConfigurationValue, intf_desc->bInterfaceNumber);
-					if (!strcmp(dev_path, path)) {
-						/* Matched Paths. Open this device */
-
-						/* OPEN HERE */
-						res = libusb_open(usb_dev, &dev->device_handle);
-						if (res < 0) {
-							LOG("can't open device\n");
-							break;
-						}
-						good_open = hidapi_initialize_device(dev, conf_desc->bConfigurationValue, intf_desc);
-						if (!good_open)
-							libusb_close(dev->device_handle);
-					}
+/* Copies the records of the connected devices matching the filter,
+   starting the monitor if needed. Returns -1 if the monitor can't run. */
+static int hotplug_copy_devices(const struct hid_enum_filter *filter, struct hid_device_info **devs)
+{
+	struct hotplug_device *hotplug_dev;
+	struct hid_device_info **last = devs;
+
+	pthread_once(&hid_hotplug.once, hotplug_init_mutex);
+	pthread_mutex_lock(&hid_hotplug.mutex);
+
+	if (!hid_hotplug.running && hotplug_start() < 0) {
+		pthread_mutex_unlock(&hid_hotplug.mutex);
+		return -1;
+	}
+
+	*devs = NULL;
+	for (hotplug_dev = hid_hotplug.devices; hotplug_dev; hotplug_dev = hotplug_dev->next) {
+		struct hid_device_info *info;
+		for (info = hotplug_dev->info; info; info = info->next) {
+			if (!device_info_matches_filter(filter, info))
+				continue;
+
+			*last = copy_device_info(info);
+			if (!*last)
+				continue;
+
+			if ((filter->flags & HID_API_ENUM_SKIP_USAGES) && filter->usage_page == 0 && filter->usage == 0) {
+				(*last)->usage_page = 0;
+				(*last)->usage = 0;
+			}
+			if (filter->flags & HID_API_ENUM_SKIP_STRINGS) {
+				free((*last)->manufacturer_string);
+				free((*last)->product_string);
+				(*last)->manufacturer_string = NULL;
+				(*last)->product_string = NULL;
+				if (!filter->serial_number_prefix) {
+					free((*last)->serial_number);
+					(*last)->serial_number = NULL;
 				}
 			}
+
+			last = &(*last)->next;
 		}
-		libusb_free_config_descriptor(conf_desc);
 	}
 
-	libusb_free_device_list(devs, 1);
+	pthread_mutex_unlock(&hid_hotplug.mutex);
 
-	/* If we have a good handle, return it. */
-	if (good_open) {
-		return dev;
+	return 0;
+}
+
+static void hotplug_stop(void)
+{
+	struct hid_hotplug_callback *hotplug_cb;
+
+	pthread_once(&hid_hotplug.once, hotplug_init_mutex);
+
+	pthread_mutex_lock(&hid_hotplug.mutex);
+	if (!hid_hotplug.running) {
+		pthread_mutex_unlock(&hid_hotplug.mutex);
+		return;
 	}
-	else {
-		/* Unable to open any devices. */
-		free_hid_device(dev);
-		return NULL;
+	hid_hotplug.running = 0;
+	pthread_mutex_unlock(&hid_hotplug.mutex);
+
+#if LIBUSB_API_VERSION >= 0x01000102
+	/* No more events get queued once this returns */
+	libusb_hotplug_deregister_callback(usb_context, hid_hotplug.libusb_handle);
+#endif
+	event_thread_release();
+
+	/* The thread may be waiting for hid_hotplug.mutex to report an event */
+	pthread_mutex_lock(&hid_hotplug.queue_mutex);
+	hid_hotplug.stop = 1;
+	pthread_cond_signal(&hid_hotplug.queue_condition);
+	pthread_mutex_unlock(&hid_hotplug.queue_mutex);
+	pthread_join(hid_hotplug.thread, NULL);
+
+	hotplug_free_queue();
+
+	pthread_mutex_lock(&hid_hotplug.mutex);
+	hotplug_cb = hid_hotplug.callbacks;
+	while (hotplug_cb) {
+		struct hid_hotplug_callback *next = hotplug_cb->next;
+		free(hotplug_cb);
+		hotplug_cb = next;
+	}
+	hid_hotplug.callbacks = NULL;
+	hotplug_free_devices();
+	pthread_mutex_unlock(&hid_hotplug.mutex);
+}
+
+int HID_API_EXPORT HID_API_CALL hid_hotplug_register_callback(unsigned short vendor_id, unsigned short product_id, int events, int flags, hid_hotplug_callback_fn callback, void *user_data, hid_hotplug_callback_handle *callback_handle)
+{
+	struct hid_hotplug_callback *hotplug_cb;
+	struct hid_hotplug_callback **last;
+
+	if (!callback || events == 0
+	 || (events & ~(HID_API_HOTPLUG_EVENT_DEVICE_ARRIVED | HID_API_HOTPLUG_EVENT_DEVICE_LEFT))
+	 || (flags & ~HID_API_HOTPLUG_ENUMERATE)) {
+		return -1;
+	}
+
+	hotplug_cb = (struct hid_hotplug_callback*) calloc(1, sizeof(*hotplug_cb));
+	if (!hotplug_cb)
+		return -1;
+
+	hotplug_cb->vendor_id = vendor_id;
+	hotplug_cb->product_id = product_id;
+	hotplug_cb->events = events;
+	hotplug_cb->callback = callback;
+	hotplug_cb->user_data = user_data;
+
+	pthread_once(&hid_hotplug.once, hotplug_init_mutex);
+	pthread_mutex_lock(&hid_hotplug.mutex);
+
+	if (!hid_hotplug.running && hotplug_start() < 0) {
+		pthread_mutex_unlock(&hid_hotplug.mutex);
+		free(hotplug_cb);
+		return -1;
+	}
+
+	hotplug_cb->handle = hid_hotplug.next_handle++;
+	for (last = &hid_hotplug.callbacks; *last; last = &(*last)->next)
+		;
+	*last = hotplug_cb;
+
+	if (callback_handle)
+		*callback_handle = hotplug_cb->handle;
+
+	if (flags & HID_API_HOTPLUG_ENUMERATE) {
+		struct hotplug_device *hotplug_dev;
+		for (hotplug_dev = hid_hotplug.devices; hotplug_dev; hotplug_dev = hotplug_dev->next)
+			hotplug_dispatch(hotplug_dev->info, HID_API_HOTPLUG_EVENT_DEVICE_ARRIVED, hotplug_cb);
 	}
+
+	pthread_mutex_unlock(&hid_hotplug.mutex);
+
+	return 0;
 }
 
+int HID_API_EXPORT HID_API_CALL hid_hotplug_deregister_callback(hid_hotplug_callback_handle callback_handle)
+{
+	struct hid_hotplug_callback **cur;
+	int res = -1;
 
-HID_API_EXPORT hid_device * HID_API_CALL hid_libusb_wrap_sys_device(intptr_t sys_dev, int interface_num)
+	pthread_once(&hid_hotplug.once, hotplug_init_mutex);
+	pthread_mutex_lock(&hid_hotplug.mutex);
+
+	for (cur = &hid_hotplug.callbacks; *cur; cur = &(*cur)->next) {
+		struct hid_hotplug_callback *hotplug_cb = *cur;
+		if (hotplug_cb->handle != callback_handle || !hotplug_cb->callback)
+			continue;
+
+		if (hid_hotplug.dispatching) {
+			/* Called from a callback, the list is being walked */
+			hotplug_cb->callback = NULL;
+		}
+		else {
+			*cur = hotplug_cb->next;
+			free(hotplug_cb);
+		}
+		res = 0;
+		break;
+	}
+
+	pthread_mutex_unlock(&hid_hotplug.mutex);
+
+	return res;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_set_enumeration_cache(int enable)
 {
-/* 0x01000107 is a LIBUSB_API_VERSION for 1.0.23 - version when libusb_wrap_sys_device was introduced */
-#if (!defined(HIDAPI_TARGET_LIBUSB_API_VERSION) || HIDAPI_TARGET_LIBUSB_API_VERSION >= 0x01000107) && (LIBUSB_API_VERSION >= 0x01000107)
-	hid_device *dev = NULL;
-	struct libusb_config_descriptor *conf_desc = NULL;
-	const struct libusb_interface_descriptor *selected_intf_desc = NULL;
-	int res = 0;
-	int j = 0, k = 0;
+	if (enable) {
+		/* Start monitoring right away, so that no change is missed */
+		pthread_once(&hid_hotplug.once, hotplug_init_mutex);
+		pthread_mutex_lock(&hid_hotplug.mutex);
+		if (!hid_hotplug.running && hotplug_start() < 0) {
+			pthread_mutex_unlock(&hid_hotplug.mutex);
+			return -1;
+		}
+		pthread_mutex_unlock(&hid_hotplug.mutex);
+	}
 
-	if(hid_init() < 0)
-		return NULL;
+	use_enumeration_cache = enable? 1: 0;
 
-	dev = new_hid_device();
+	return 0;
+}
 
-	res = libusb_wrap_sys_device(usb_context, sys_dev, &dev->device_handle);
-	if (res < 0) {
-		LOG("libusb_wrap_sys_device failed: %d %s\n", res, libusb_error_name(res));
-		goto err;
+int HID_API_EXPORT HID_API_CALL hid_set_enumeration_threads(int num_threads, int timeout_ms)
+{
+	if (num_threads < 0)
+		return -1;
+
+	enumeration_threads = num_threads;
+	enumeration_timeout_ms = (timeout_ms < 0)? -1: timeout_ms;
+
+	return 0;
+}
+
+hid_device * hid_open(unsigned short vendor_id, unsigned short product_id, const wchar_t *serial_number)
+{
+	struct hid_device_info *devs, *cur_dev;
+	struct hid_enum_filter filter;
+	const char *path_to_open = NULL;
+	hid_device *handle = NULL;
+
+	/* Only the path (and the serial number) is needed */
+	memset(&filter, 0, sizeof(filter));
+	filter.vendor_id = vendor_id;
+	filter.product_id = product_id;
+	filter.serial_number_prefix = serial_number;
+	filter.flags = HID_API_ENUM_SKIP_STRINGS | HID_API_ENUM_SKIP_USAGES;
+
+	devs = hid_enumerate_ex(&filter);
+	cur_dev = devs;
+	while (cur_dev) {
+		if (cur_dev->vendor_id == vendor_id &&
+		    cur_dev->product_id == product_id) {
+			if (serial_number) {
+				if (cur_dev->serial_number &&
+				    wcscmp(serial_number, cur_dev->serial_number) == 0) {
+					path_to_open = cur_dev->path;
+					break;
+				}
+			}
+			else {
+				path_to_open = cur_dev->path;
+				break;
+			}
+		}
+		cur_dev = cur_dev->next;
+	}
+
+	if (path_to_open) {
+		/* Open the device */
+		handle = hid_open_path(path_to_open);
+	}
+
+	hid_free_enumeration(devs);
+
+	return handle;
+}
+
+/* Wake any threads which are waiting on data (in hid_read_timeout()),
+   once all the transfers of the device are done. Do this under a mutex to
+   make sure that a thread which is about to go to sleep waiting on
+   the condition actually will go to sleep before the condition is
+   signaled. */
+static void input_transfers_finished(hid_device *dev)
+{
+	pthread_mutex_lock(&dev->mutex);
+	pthread_cond_broadcast(&dev->condition);
+	notify_input(dev);
+	pthread_mutex_unlock(&dev->mutex);
+}
+
+/* Called once a transfer is no longer submitted, for good.
+   Once all of them are, read_thread() (or hid_close()) knows
+   it is safe to stop. */
+static void input_transfer_done(hid_device *dev)
+{
+	if (atomic_fetch_sub(&dev->transfers_in_flight, 1) == 1) {
+		/* Without a read thread, nobody else tells the readers.
+		   hid_close() may free the device as soon as
+		   transfer_loop_finished is set, so this comes first. */
+		if (dev->shared_event_thread)
+			input_transfers_finished(dev);
+		dev->transfer_loop_finished = 1;
+	}
+}
+
+/* Called from read_callback() with the policy HID_API_QUEUE_BLOCK.
+   If the queue is full, or older reports are parked already, keeps
+   the transfer (with its report) aside and returns 1. It is then
+   resubmitted by resume_parked_transfers() once a report is read.
+   The callback never waits for the application: it runs with the
+   event lock of the libusb context held, which would stop the
+   transfers of all the other devices as well. */
+static int park_input_transfer(hid_device *dev, struct libusb_transfer *transfer)
+{
+	int parked = 0;
+
+	/* Only read_callback() adds transfers, so if there are
+	   none, no one can be added meanwhile */
+	if (atomic_load(&dev->num_parked_transfers) == 0 && !input_ring_full(&dev->input_reports))
+		return 0;
+
+	pthread_mutex_lock(&dev->mutex);
+	if (!dev->shutdown_thread && (atomic_load(&dev->num_parked_transfers) > 0 || input_ring_full(&dev->input_reports))) {
+		dev->parked_transfers[atomic_load(&dev->num_parked_transfers)] = transfer;
+		atomic_fetch_add(&dev->num_parked_transfers, 1);
+		parked = 1;
+	}
+	pthread_mutex_unlock(&dev->mutex);
+
+	return parked;
+}
+
+/* Queue the reports of the parked transfers while there is room
+   (or the policy is no longer HID_API_QUEUE_BLOCK), oldest first,
+   and resubmit them. Once the device is closing or disconnected
+   they are just released.
+   Returns the number of transfers released. */
+static int resume_parked_transfers(hid_device *dev)
+{
+	int released = 0;
+	int i;
+
+	pthread_mutex_lock(&dev->mutex);
+	while (atomic_load(&dev->num_parked_transfers) > 0) {
+		struct libusb_transfer *transfer = dev->parked_transfers[0];
+		int n = atomic_load(&dev->num_parked_transfers);
+
+		if (!dev->shutdown_thread) {
+			if (dev->queue_policy == HID_API_QUEUE_BLOCK && input_ring_full(&dev->input_reports))
+				break;
+
+			/* read_callback() doesn't push while there are parked
+			   transfers, so this is still the only producer */
+			input_ring_push(&dev->input_reports, transfer->buffer, transfer->actual_length, &dev->dropped_reports);
+			if (libusb_submit_transfer(transfer) == 0)
+				released--;
+			else
+				dev->shutdown_thread = 1;
+		}
+		released++;
+
+		for (i = 1; i < n; i++)
+			dev->parked_transfers[i - 1] = dev->parked_transfers[i];
+		atomic_fetch_sub(&dev->num_parked_transfers, 1);
+	}
+	pthread_mutex_unlock(&dev->mutex);
+
+	for (i = 0; i < released; i++)
+		input_transfer_done(dev);
+
+	return released;
+}
+
+static void read_callback(struct libusb_transfer *transfer)
+{
+	hid_device *dev = transfer->user_data;
+	int res;
+
+	if (transfer->status == LIBUSB_TRANSFER_COMPLETED) {
+
+		int was_empty;
+
+		if (dev->num_report_id_queues > 0 && transfer->actual_length > 0
+		 && dev->report_id_queues[transfer->buffer[0]]) {
+			/* Read with hid_read_report_id(), the oldest report
+			   of the ID is dropped when its queue is full */
+			input_ring_push(dev->report_id_queues[transfer->buffer[0]], transfer->buffer, transfer->actual_length, &dev->dropped_reports);
+
+			if (atomic_load(&dev->input_waiters) > 0) {
+				pthread_mutex_lock(&dev->mutex);
+				pthread_cond_broadcast(&dev->condition);
+				pthread_mutex_unlock(&dev->mutex);
+			}
+			goto resubmit;
+		}
+
+		if (dev->queue_policy == HID_API_QUEUE_DROP_NEWEST && input_ring_full(&dev->input_reports)) {
+			atomic_fetch_add(&dev->dropped_reports, 1);
+			goto resubmit;
+		}
+		if (dev->queue_policy == HID_API_QUEUE_BLOCK && park_input_transfer(dev, transfer))
+			return;
+
+		was_empty = input_ring_push(&dev->input_reports, transfer->buffer, transfer->actual_length, &dev->dropped_reports);
+
+		/* Only take the mutex if someone needs to be woken up */
+		if (atomic_load(&dev->input_waiters) > 0 || (was_empty && atomic_load(&dev->input_listeners) > 0)) {
+			pthread_mutex_lock(&dev->mutex);
+			/* The readers of the other queues wait on it as well */
+			if (dev->num_report_id_queues > 0)
+				pthread_cond_broadcast(&dev->condition);
+			else
+				pthread_cond_signal(&dev->condition);
+			if (was_empty)
+				notify_input(dev);
+			pthread_mutex_unlock(&dev->mutex);
+		}
+	}
+	else if (transfer->status == LIBUSB_TRANSFER_CANCELLED) {
+		dev->shutdown_thread = 1;
+	}
+	else if (transfer->status == LIBUSB_TRANSFER_NO_DEVICE) {
+		dev->shutdown_thread = 1;
+	}
+	else if (transfer->status == LIBUSB_TRANSFER_TIMED_OUT) {
+		//LOG("Timeout (normal)\n");
+	}
+	else {
+		LOG("Unknown transfer code: %d\n", transfer->status);
+	}
+
+resubmit:
+	if (!dev->shutdown_thread) {
+		/* Re-submit the transfer object. */
+		res = libusb_submit_transfer(transfer);
+		if (res == 0)
+			return;
+
+		LOG("Unable to submit URB: (%d) %s\n", res, libusb_error_name(res));
+		dev->shutdown_thread = 1;
+	}
+
+	input_transfer_done(dev);
+}
+
+static void *event_thread_main(void *param)
+{
+	(void) param;
+
+	while (!event_thread.stop) {
+		/* Woken up by libusb_interrupt_event_handler() to stop,
+		   the timeout only matters for older libusb versions. */
+		struct timeval tv = { 1, 0 };
+		int res = libusb_handle_events_timeout_completed(usb_context, &tv, &event_thread.stop);
+		if (res < 0 && res != LIBUSB_ERROR_INTERRUPTED && res != LIBUSB_ERROR_TIMEOUT) {
+			LOG("event_thread(): (%d) %s\n", res, libusb_error_name(res));
+		}
+	}
+
+	return NULL;
+}
+
+static int event_thread_acquire(void)
+{
+	int res = 0;
+
+	pthread_mutex_lock(&event_thread.mutex);
+	if (event_thread.users == 0) {
+		event_thread.stop = 0;
+		res = pthread_create(&event_thread.thread, NULL, event_thread_main, NULL);
+	}
+	if (res == 0)
+		event_thread.users++;
+	pthread_mutex_unlock(&event_thread.mutex);
+
+	return (res == 0)? 0: -1;
+}
+
+static void event_thread_release(void)
+{
+	pthread_mutex_lock(&event_thread.mutex);
+	if (--event_thread.users == 0) {
+		event_thread.stop = 1;
+#if LIBUSB_API_VERSION >= 0x01000105
+		libusb_interrupt_event_handler(usb_context);
+#endif
+		pthread_join(event_thread.thread, NULL);
+	}
+	pthread_mutex_unlock(&event_thread.mutex);
+}
+
+
+/* Set up and submit the interrupt IN transfers of the device */
+static void start_input_transfers(hid_device *dev)
+{
+	int res;
+	int i;
+	uint8_t *buf;
+	const size_t length = dev->input_ep_max_packet_size;
+
+	/* Set up the transfer objects. */
+	for (i = 0; i < dev->num_transfers; i++) {
+		buf = (uint8_t*) malloc(length);
+		dev->transfers[i] = libusb_alloc_transfer(0);
+		libusb_fill_interrupt_transfer(dev->transfers[i],
+			dev->device_handle,
+			dev->input_endpoint,
+			buf,
+			length,
+			read_callback,
+			dev,
+			5000/*timeout*/);
+	}
+
+	/* Make the first submissions. Further submissions are made
+	   from inside read_callback(), which may already run in the
+	   shared event thread while the others are submitted. */
+	atomic_store(&dev->transfers_in_flight, dev->num_transfers);
+	for (i = 0; i < dev->num_transfers; i++) {
+		res = libusb_submit_transfer(dev->transfers[i]);
+		if(res < 0) {
+			LOG("libusb_submit_transfer failed: %d %s. Stopping read_thread from running\n", res, libusb_error_name(res));
+			dev->shutdown_thread = 1;
+			if (atomic_fetch_sub(&dev->transfers_in_flight, dev->num_transfers - i) == dev->num_transfers - i)
+				dev->transfer_loop_finished = 1;
+			break;
+		}
+	}
+}
+
+static void *read_thread(void *param)
+{
+	int res;
+	int i;
+	hid_device *dev = param;
+
+	start_input_transfers(dev);
+
+	/* Notify the main thread that the read thread is up and running. */
+	pthread_barrier_wait(&dev->barrier);
+
+	/* Handle all the events. */
+	while (!dev->shutdown_thread) {
+		res = libusb_handle_events(usb_context);
+		if (res < 0) {
+			/* There was an error. */
+			LOG("read_thread(): (%d) %s\n", res, libusb_error_name(res));
+
+			/* Break out of this loop only on fatal error.*/
+			if (res != LIBUSB_ERROR_BUSY &&
+			    res != LIBUSB_ERROR_TIMEOUT &&
+			    res != LIBUSB_ERROR_OVERFLOW &&
+			    res != LIBUSB_ERROR_INTERRUPTED) {
+				dev->shutdown_thread = 1;
+				break;
+			}
+		}
+	}
+
+	/* Cancel any transfer that may be pending. This call will fail
+	   if no transfers are pending, but that's OK. */
+	for (i = 0; i < dev->num_transfers; i++)
+		libusb_cancel_transfer(dev->transfers[i]);
+	/* The parked ones are not submitted, so can't be cancelled */
+	resume_parked_transfers(dev);
+
+	while (!dev->transfer_loop_finished)
+		libusb_handle_events_completed(usb_context, &dev->transfer_loop_finished);
+
+	/* Now that the read thread is stopping, wake any threads which are
+	   waiting on data. */
+	input_transfers_finished(dev);
+
+	/* The dev->transfers[] buffers and objects are cleaned up
+	   in hid_close(). They are not cleaned up here because this thread
+	   could end either due to a disconnect or due to a user
+	   call to hid_close(). In both cases the objects can be safely
+	   cleaned up after the call to pthread_join() (in hid_close()), but
+	   since hid_close() calls libusb_cancel_transfer(), on these objects,
+	   they can not be cleaned up here. */
+
+	return NULL;
+}
+
+
+static int hidapi_initialize_device(hid_device *dev, int config_number, const struct libusb_interface_descriptor *intf_desc)
+{
+	int i =0;
+	int res = 0;
+	struct libusb_device_descriptor desc;
+	libusb_get_device_descriptor(libusb_get_device(dev->device_handle), &desc);
+
+#ifdef DETACH_KERNEL_DRIVER
+	/* Detach the kernel driver, but only if the
+	   device is managed by the kernel */
+	dev->is_driver_detached = 0;
+	if (libusb_kernel_driver_active(dev->device_handle, intf_desc->bInterfaceNumber) == 1) {
+		res = libusb_detach_kernel_driver(dev->device_handle, intf_desc->bInterfaceNumber);
+		if (res < 0) {
+			LOG("Unable to detach Kernel Driver: (%d) %s\n", res, libusb_error_name(res));
+			return 0;
+		}
+		else {
+			dev->is_driver_detached = 1;
+			LOG("Driver successfully detached from kernel.\n");
+		}
+	}
+#endif
+	res = libusb_claim_interface(dev->device_handle, intf_desc->bInterfaceNumber);
+	if (res < 0) {
+		LOG("can't claim interface %d: (%d) %s\n", intf_desc->bInterfaceNumber, res, libusb_error_name(res));
+
+#ifdef DETACH_KERNEL_DRIVER
+		if (dev->is_driver_detached) {
+			res = libusb_attach_kernel_driver(dev->device_handle, intf_desc->bInterfaceNumber);
+			if (res < 0)
+				LOG("Failed to reattach the driver to kernel: (%d) %s\n", res, libusb_error_name(res));
+		}
+#endif
+		return 0;
+	}
+
+	/* Store off the string descriptor indexes */
+	dev->manufacturer_index = desc.iManufacturer;
+	dev->product_index      = desc.iProduct;
+	dev->serial_index       = desc.iSerialNumber;
+
+	/* Store off the USB information */
+	dev->config_number = config_number;
+	dev->interface = intf_desc->bInterfaceNumber;
+
+	dev->report_descriptor_size = get_report_descriptor_size_from_interface_descriptors(intf_desc);
+
+	dev->input_endpoint = 0;
+	dev->input_ep_max_packet_size = 0;
+	dev->output_endpoint = 0;
+
+	/* Find the INPUT and OUTPUT endpoints. An
+	   OUTPUT endpoint is not required. */
+	for (i = 0; i < intf_desc->bNumEndpoints; i++) {
+		const struct libusb_endpoint_descriptor *ep
+			= &intf_desc->endpoint[i];
+
+		/* Determine the type and direction of this
+		   endpoint. */
+		int is_interrupt =
+			(ep->bmAttributes & LIBUSB_TRANSFER_TYPE_MASK)
+		      == LIBUSB_TRANSFER_TYPE_INTERRUPT;
+		int is_output =
+			(ep->bEndpointAddress & LIBUSB_ENDPOINT_DIR_MASK)
+		      == LIBUSB_ENDPOINT_OUT;
+		int is_input =
+			(ep->bEndpointAddress & LIBUSB_ENDPOINT_DIR_MASK)
+		      == LIBUSB_ENDPOINT_IN;
+
+		/* Decide whether to use it for input or output. */
+		if (dev->input_endpoint == 0 &&
+		    is_interrupt && is_input) {
+			/* Use this endpoint for INPUT */
+			dev->input_endpoint = ep->bEndpointAddress;
+			dev->input_ep_max_packet_size = ep->wMaxPacketSize;
+		}
+		if (dev->output_endpoint == 0 &&
+		    is_interrupt && is_output) {
+			/* Use this endpoint for OUTPUT */
+			dev->output_endpoint = ep->bEndpointAddress;
+		}
+	}
+
+	if (input_ring_init(&dev->input_reports, dev->input_ep_max_packet_size, INPUT_REPORT_QUEUE_SIZE) < 0) {
+		LOG("Unable to allocate the input report queue\n");
+		libusb_release_interface(dev->device_handle, intf_desc->bInterfaceNumber);
+#ifdef DETACH_KERNEL_DRIVER
+		if (dev->is_driver_detached) {
+			res = libusb_attach_kernel_driver(dev->device_handle, intf_desc->bInterfaceNumber);
+			if (res < 0)
+				LOG("Failed to reattach the driver to kernel: (%d) %s\n", res, libusb_error_name(res));
+		}
+#endif
+		return 0;
+	}
+
+	dev->num_transfers = input_transfers;
+
+	if (use_shared_event_thread && event_thread_acquire() == 0) {
+		/* No thread of our own to start */
+		dev->shared_event_thread = 1;
+		start_input_transfers(dev);
+		return 1;
+	}
+
+	pthread_create(&dev->thread, NULL, read_thread, dev);
+
+	/* Wait here for the read thread to be initialized. */
+	pthread_barrier_wait(&dev->barrier);
+	return 1;
+}
+
+
+hid_device * HID_API_EXPORT hid_open_path(const char *path)
+{
+	hid_device *dev = NULL;
+
+	libusb_device **devs = NULL;
+	libusb_device *usb_dev = NULL;
+	struct libusb_config_descriptor *conf_desc = NULL;
+	struct usb_path usb_path;
+	int res = 0;
+	int d = 0;
+	int j, k;
+	int good_open = 0;
+
+	if(hid_init() < 0)
+		return NULL;
+
+	if (!path || parse_path(path, &usb_path) < 0) {
+		LOG("invalid path\n");
+		return NULL;
+	}
+
+	if (libusb_get_device_list(usb_context, &devs) < 0)
+		return NULL;
+
+	/* The device is found by its location, only its own
+	   configuration descriptor is looked at */
+	while ((usb_dev = devs[d++]) != NULL) {
+		if (device_matches_path(usb_dev, &usb_path))
+			break;
+	}
+
+	/* The path only names interfaces of the active configuration */
+	if (usb_dev && libusb_get_active_config_descriptor(usb_dev, &conf_desc) == 0
+	 && conf_desc->bConfigurationValue != usb_path.config_number) {
+		libusb_free_config_descriptor(conf_desc);
+		conf_desc = NULL;
+	}
+
+	if (!conf_desc) {
+		libusb_free_device_list(devs, 1);
+		return NULL;
+	}
+
+	dev = new_hid_device();
+
+	for (j = 0; j < conf_desc->bNumInterfaces && !good_open; j++) {
+		const struct libusb_interface *intf = &conf_desc->interface[j];
+		for (k = 0; k < intf->num_altsetting && !good_open; k++) {
+			const struct libusb_interface_descriptor *intf_desc = &intf->altsetting[k];
+			if (intf_desc->bInterfaceClass == LIBUSB_CLASS_HID
+			 && intf_desc->bInterfaceNumber == usb_path.interface_number) {
+				/* Matched Paths. Open this device */
+
+				/* OPEN HERE */
+				res = libusb_open(usb_dev, &dev->device_handle);
+				if (res < 0) {
+					LOG("can't open device\n");
+					break;
+				}
+				good_open = hidapi_initialize_device(dev, conf_desc->bConfigurationValue, intf_desc);
+				if (!good_open)
+					libusb_close(dev->device_handle);
+			}
+		}
+	}
+
+	libusb_free_config_descriptor(conf_desc);
+	libusb_free_device_list(devs, 1);
+
+	/* If we have a good handle, return it. */
+	if (good_open) {
+		return dev;
+	}
+	else {
+		/* Unable to open any devices. */
+		free_hid_device(dev);
+		return NULL;
+	}
+}
+
+
+HID_API_EXPORT hid_device * HID_API_CALL hid_libusb_wrap_sys_device(intptr_t sys_dev, int interface_num)
+{
+/* 0x01000107 is a LIBUSB_API_VERSION for 1.0.23 - version when libusb_wrap_sys_device was introduced */
+#if (!defined(HIDAPI_TARGET_LIBUSB_API_VERSION) || HIDAPI_TARGET_LIBUSB_API_VERSION >= 0x01000107) && (LIBUSB_API_VERSION >= 0x01000107)
+	hid_device *dev = NULL;
+	struct libusb_config_descriptor *conf_desc = NULL;
+	const struct libusb_interface_descriptor *selected_intf_desc = NULL;
+	int res = 0;
+	int j = 0, k = 0;
+
+	if(hid_init() < 0)
+		return NULL;
+
+	dev = new_hid_device();
+
+	res = libusb_wrap_sys_device(usb_context, sys_dev, &dev->device_handle);
+	if (res < 0) {
+		LOG("libusb_wrap_sys_device failed: %d %s\n", res, libusb_error_name(res));
+		goto err;
+	}
+
+	res = libusb_get_active_config_descriptor(libusb_get_device(dev->device_handle), &conf_desc);
+	if (res < 0)
+		libusb_get_config_descriptor(libusb_get_device(dev->device_handle), 0, &conf_desc);
+
+	if (!conf_desc) {
+		LOG("Failed to get configuration descriptor: %d %s\n", res, libusb_error_name(res));
+		goto err;
+	}
+
+	/* find matching HID interface */
+	for (j = 0; j < conf_desc->bNumInterfaces && !selected_intf_desc; j++) {
+		const struct libusb_interface *intf = &conf_desc->interface[j];
+		for (k = 0; k < intf->num_altsetting; k++) {
+			const struct libusb_interface_descriptor *intf_desc = &intf->altsetting[k];
+			if (intf_desc->bInterfaceClass == LIBUSB_CLASS_HID) {
+				if (interface_num < 0 || interface_num == intf_desc->bInterfaceNumber) {
+					selected_intf_desc = intf_desc;
+					break;
+				}
+			}
+		}
+	}
+
+	if (!selected_intf_desc) {
+		if (interface_num < 0) {
+			LOG("Sys USB device doesn't contain a HID interface\n");
+		}
+		else {
+			LOG("Sys USB device doesn't contain a HID interface with number %d\n", interface_num);
+		}
+		goto err;
+	}
+
+	if (!hidapi_initialize_device(dev, conf_desc->bConfigurationValue, selected_intf_desc))
+		goto err;
+
+	return dev;
+
+err:
+	if (conf_desc)
+		libusb_free_config_descriptor(conf_desc);
+	if (dev->device_handle)
+		libusb_close(dev->device_handle);
+	free_hid_device(dev);
+#else
+	(void)sys_dev;
+	(void)interface_num;
+	LOG("libusb_wrap_sys_device is not available\n");
+#endif
+	return NULL;
+}
+
+void HID_API_EXPORT_CALL hid_libusb_set_input_transfers(int count)
+{
+	if (count < 1)
+		count = 1;
+	if (count > MAX_INPUT_TRANSFERS)
+		count = MAX_INPUT_TRANSFERS;
+	input_transfers = count;
+}
+
+int HID_API_EXPORT_CALL hid_libusb_get_input_transfers(void)
+{
+	return input_transfers;
+}
+
+void HID_API_EXPORT_CALL hid_libusb_set_shared_event_thread(int enable)
+{
+	use_shared_event_thread = enable? 1: 0;
+}
+
+int HID_API_EXPORT_CALL hid_libusb_get_shared_event_thread(void)
+{
+	return use_shared_event_thread;
+}
+
+
+int HID_API_EXPORT hid_write(hid_device *dev, const unsigned char *data, size_t length)
+{
+	int res;
+	int report_number;
+	int skipped_report_id = 0;
+
+	if (!data || (length ==0)) {
+		return -1;
+	}
+
+	report_number = data[0];
+
+	if (report_number == 0x0) {
+		data++;
+		length--;
+		skipped_report_id = 1;
+	}
+
+
+	if (dev->output_endpoint <= 0) {
+		/* No interrupt out endpoint. Use the Control Endpoint */
+		res = libusb_control_transfer(dev->device_handle,
+			LIBUSB_REQUEST_TYPE_CLASS|LIBUSB_RECIPIENT_INTERFACE|LIBUSB_ENDPOINT_OUT,
+			0x09/*HID Set_Report*/,
+			(2/*HID output*/ << 8) | report_number,
+			dev->interface,
+			(unsigned char *)data, length,
+			1000/*timeout millis*/);
+
+		if (res < 0)
+			return -1;
+
+		if (skipped_report_id)
+			length++;
+
+		return length;
+	}
+	else {
+		/* Use the interrupt out endpoint */
+		int actual_length;
+		res = libusb_interrupt_transfer(dev->device_handle,
+			dev->output_endpoint,
+			(unsigned char*)data,
+			length,
+			&actual_length, 1000);
+
+		if (res < 0)
+			return -1;
+
+		if (skipped_report_id)
+			actual_length++;
+
+		return actual_length;
+	}
+}
+
+/* Take the oldest input report out of the queue, see hid_read_timeout().
+   Returns -1 if the queue is empty. */
+static int return_data(hid_device *dev, unsigned char *data, size_t length)
+{
+	int len = input_ring_pop(&dev->input_reports, data, length);
+
+	if (len >= 0 && atomic_load(&dev->num_parked_transfers) > 0)
+		resume_parked_transfers(dev);
+
+	if (len >= 0 && atomic_load(&dev->input_listeners) > 0 && input_ring_empty(&dev->input_reports)) {
+		pthread_mutex_lock(&dev->mutex);
+		/* The descriptor stays readable after a disconnection,
+		   so the next read reports the error. */
+		if (dev->has_pollable_fd && !dev->shutdown_thread) {
+			wakeup_clear(&dev->pollable_fd);
+			/* A report may have been queued right before clearing */
+			if (!input_ring_empty(&dev->input_reports))
+				wakeup_signal(&dev->pollable_fd);
+		}
+		pthread_mutex_unlock(&dev->mutex);
+	}
+
+	return len;
+}
+
+static void cleanup_mutex(void *param)
+{
+	hid_device *dev = param;
+	atomic_fetch_sub(&dev->input_waiters, 1);
+	pthread_mutex_unlock(&dev->mutex);
+}
+
+/* Helper function, to share the waiting logic between hid_read_timeout(),
+   hid_read_batch() and hid_read_report_id(), for when the queue is empty.
+   This should be called with dev->mutex locked and input_waiters incremented,
+   so read_callback() signals the condition.
+   Returns 1 if there is an input report queued up, 0 if the timeout
+   expired (or milliseconds is 0) and -1 on error or disconnection. */
+static int wait_for_input_report(hid_device *dev, struct input_ring *ring, int milliseconds)
+{
+	/* There's an input report queued up. */
+	if (!input_ring_empty(ring))
+		return 1;
+
+	if (dev->shutdown_thread) {
+		/* This means the device has been disconnected.
+		   An error code of -1 should be returned. */
+		return -1;
+	}
+
+	if (milliseconds == -1) {
+		/* Blocking */
+		while (input_ring_empty(ring) && !dev->shutdown_thread) {
+			pthread_cond_wait(&dev->condition, &dev->mutex);
+		}
+		return input_ring_empty(ring)? -1: 1;
+	}
+	else if (milliseconds > 0) {
+		/* Non-blocking, but called with timeout. */
+		int res;
+		struct timespec ts;
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_sec += milliseconds / 1000;
+		ts.tv_nsec += (milliseconds % 1000) * 1000000;
+		if (ts.tv_nsec >= 1000000000L) {
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000L;
+		}
+
+		while (input_ring_empty(ring) && !dev->shutdown_thread) {
+			res = pthread_cond_timedwait(&dev->condition, &dev->mutex, &ts);
+			if (res == ETIMEDOUT) {
+				/* Timed out. */
+				return 0;
+			}
+			else if (res != 0) {
+				/* Error. */
+				return -1;
+			}
+
+			/* If we're here, there was a spurious wake up,
+			   new data or the read thread was shutdown.
+			   The loop condition sorts it out. */
+		}
+		return input_ring_empty(ring)? -1: 1;
+	}
+
+	/* Purely non-blocking */
+	return 0;
+}
+
+/* Wait until the queue is not empty. See wait_for_input_report(). */
+static int wait_for_input_report_locked(hid_device *dev, struct input_ring *ring, int milliseconds)
+{
+	/* by initialising this variable right here, GCC gives a compilation warning/error: */
+	/* error: variable ‘res’ might be clobbered by ‘longjmp’ or ‘vfork’ [-Werror=clobbered] */
+	int res; /* = -1; */
+
+	pthread_mutex_lock(&dev->mutex);
+	/* Incremented before the queue is checked again, under the mutex,
+	   so read_callback() either sees a waiter or we see its report. */
+	atomic_fetch_add(&dev->input_waiters, 1);
+	pthread_cleanup_push(&cleanup_mutex, dev);
+
+	res = wait_for_input_report(dev, ring, milliseconds);
+
+	pthread_cleanup_pop(1);
+
+	return res;
+}
+
+
+int HID_API_EXPORT hid_read_timeout(hid_device *dev, unsigned char *data, size_t length, int milliseconds)
+{
+#if 0
+	int transferred;
+	int res = libusb_interrupt_transfer(dev->device_handle, dev->input_endpoint, data, length, &transferred, 5000);
+	LOG("transferred: %d\n", transferred);
+	return transferred;
+#endif
+	int bytes_read;
+
+	/* Fast path, a report is queued up already */
+	bytes_read = return_data(dev, data, length);
+	if (bytes_read >= 0)
+		return bytes_read;
+
+	if (milliseconds == 0)
+		return dev->shutdown_thread? -1: 0;
+
+	bytes_read = wait_for_input_report_locked(dev, &dev->input_reports, milliseconds);
+	if (bytes_read > 0) {
+		/* Return the first one */
+		bytes_read = return_data(dev, data, length);
+	}
+
+	return bytes_read;
+}
+
+int HID_API_EXPORT hid_read_batch(hid_device *dev, unsigned char *data, size_t stride, size_t max_reports, size_t *lengths, int milliseconds)
+{
+	int res;
+	size_t count = 0;
+
+	if (!data || !stride || !lengths || !max_reports)
+		return -1;
+
+	/* Waits for the first report, like hid_read_timeout() */
+	res = return_data(dev, data, stride);
+	if (res < 0) {
+		if (milliseconds == 0)
+			return dev->shutdown_thread? -1: 0;
+
+		res = wait_for_input_report_locked(dev, &dev->input_reports, milliseconds);
+		if (res <= 0)
+			return res;
+		res = return_data(dev, data, stride);
+	}
+	lengths[count++] = (size_t) res;
+
+	/* Drain what is queued already, without taking any lock. */
+	while (count < max_reports) {
+		res = return_data(dev, data + count * stride, stride);
+		if (res < 0)
+			break;
+		lengths[count++] = (size_t) res;
+	}
+
+	return (int) count;
+}
+
+int HID_API_EXPORT hid_read(hid_device *dev, unsigned char *data, size_t length)
+{
+	return hid_read_timeout(dev, data, length, dev->blocking ? -1 : 0);
+}
+
+int HID_API_EXPORT hid_set_nonblocking(hid_device *dev, int nonblock)
+{
+	dev->blocking = !nonblock;
+
+	return 0;
+}
+
+int HID_API_EXPORT hid_get_pollable_fd(hid_device *dev)
+{
+	int res = 0;
+
+	pthread_mutex_lock(&dev->mutex);
+	if (!dev->has_pollable_fd) {
+		res = wakeup_init(&dev->pollable_fd);
+		if (res == 0) {
+			dev->has_pollable_fd = 1;
+			atomic_fetch_add(&dev->input_listeners, 1);
+			if (!input_ring_empty(&dev->input_reports) || dev->shutdown_thread)
+				wakeup_signal(&dev->pollable_fd);
+		}
+		else {
+			LOG("Unable to create the pollable descriptor: %s\n", strerror(errno));
+		}
+	}
+	pthread_mutex_unlock(&dev->mutex);
+
+	return (res == 0)? dev->pollable_fd.read_fd: -1;
+}
+
+int HID_API_EXPORT hid_read_report_id(hid_device *dev, unsigned char report_id, unsigned char *data, size_t length, int milliseconds)
+{
+	struct input_ring *ring = dev->report_id_queues[report_id];
+	int res;
+
+	if (!ring)
+		return -1;
+
+	res = input_ring_pop(ring, data, length);
+	if (res >= 0)
+		return res;
+
+	if (milliseconds == 0)
+		return dev->shutdown_thread? -1: 0;
+
+	res = wait_for_input_report_locked(dev, ring, milliseconds);
+	if (res > 0)
+		res = input_ring_pop(ring, data, length);
+
+	return res;
+}
+
+/* read_callback() is only called by the thread which handles
+   the libusb events, so holding the event lock keeps it out
+   while the queues are replaced. */
+static void lock_input_queues(void)
+{
+#if LIBUSB_API_VERSION >= 0x01000105
+	/* Don't wait for the event thread to time out */
+	libusb_interrupt_event_handler(usb_context);
+#endif
+	libusb_lock_events(usb_context);
+}
+
+static void unlock_input_queues(void)
+{
+	libusb_unlock_events(usb_context);
+}
+
+int HID_API_EXPORT hid_set_input_queue(hid_device *dev, size_t max_reports, size_t max_bytes, hid_queue_policy policy)
+{
+	struct input_ring ring;
+	unsigned char *buf;
+	size_t slot_size = dev->input_reports.slot_size? dev->input_reports.slot_size: 1;
+	size_t capacity = max_reports;
+	int len;
+
+	if (max_reports == 0 || (unsigned) policy > HID_API_QUEUE_BLOCK)
+		return -1;
+
+	/* See hid_set_report_id_queue() */
+	if (policy == HID_API_QUEUE_BLOCK && dev->num_report_id_queues > 0)
+		return -1;
+
+	/* The slots have a fixed size, so the byte budget limits their number */
+	if (max_bytes > 0 && capacity > max_bytes / slot_size)
+		capacity = max_bytes / slot_size;
+	if (capacity == 0)
+		capacity = 1;
+	if (capacity > UINT_MAX - 1)
+		capacity = UINT_MAX - 1;
+
+	buf = (unsigned char*) malloc(slot_size);
+	if (!buf || input_ring_init(&ring, dev->input_reports.slot_size, (unsigned int) capacity) < 0) {
+		free(buf);
+		input_ring_free(&ring);
+		return -1;
+	}
+
+	lock_input_queues();
+
+	/* Move the queued reports over, dropping the oldest ones
+	   if they don't fit. This thread is the only consumer. */
+	while ((len = input_ring_pop(&dev->input_reports, buf, slot_size)) >= 0)
+		input_ring_push(&ring, buf, (size_t) len, &dev->dropped_reports);
+
+	input_ring_free(&dev->input_reports);
+	dev->input_reports.slots = ring.slots;
+	dev->input_reports.lengths = ring.lengths;
+	dev->input_reports.slot_size = ring.slot_size;
+	dev->input_reports.capacity = ring.capacity;
+	dev->input_reports.num_slots = ring.num_slots;
+	atomic_store(&dev->input_reports.head, atomic_load(&ring.head));
+	atomic_store(&dev->input_reports.tail, atomic_load(&ring.tail));
+	dev->queue_policy = policy;
+
+	unlock_input_queues();
+
+	/* There may be room for the parked transfers now */
+	resume_parked_transfers(dev);
+
+	free(buf);
+	return 0;
+}
+
+int HID_API_EXPORT hid_set_report_id_queue(hid_device *dev, unsigned char report_id, size_t max_reports)
+{
+	struct input_ring *ring = NULL;
+	struct input_ring *old;
+	unsigned char *buf;
+	size_t slot_size = dev->input_reports.slot_size;
+	int len;
+
+	/* Without report IDs, the first byte is data */
+	if (report_id == 0 || slot_size == 0)
+		return -1;
+
+	/* The reports of the ID would wait behind the parked transfers */
+	if (max_reports > 0 && dev->queue_policy == HID_API_QUEUE_BLOCK)
+		return -1;
+
+	buf = (unsigned char*) malloc(slot_size);
+	if (!buf)
+		return -1;
+
+	if (max_reports > 0) {
+		if (max_reports > UINT_MAX - 1)
+			max_reports = UINT_MAX - 1;
+		ring = (struct input_ring*) calloc(1, sizeof(struct input_ring));
+		if (!ring || input_ring_init(ring, slot_size, (unsigned int) max_reports) < 0) {
+			if (ring)
+				input_ring_free(ring);
+			free(ring);
+			free(buf);
+			return -1;
+		}
 	}
 
-	res = libusb_get_active_config_descriptor(libusb_get_device(dev->device_handle), &conf_desc);
-	if (res < 0)
-		libusb_get_config_descriptor(libusb_get_device(dev->device_handle), 0, &conf_desc);
+	lock_input_queues();
 
-	if (!conf_desc) {
-		LOG("Failed to get configuration descriptor: %d %s\n", res, libusb_error_name(res));
-		goto err;
+	/* The reports queued already stay in their queue, dropping
+	   the oldest ones if they don't fit. Once the queue of
+	   the ID is removed, they go back to input_reports. */
+	old = dev->report_id_queues[report_id];
+	if (old) {
+		struct input_ring *dest = ring? ring: &dev->input_reports;
+		while ((len = input_ring_pop(old, buf, slot_size)) >= 0)
+			input_ring_push(dest, buf, (size_t) len, &dev->dropped_reports);
 	}
 
-	/* find matching HID interface */
-	for (j = 0; j < conf_desc->bNumInterfaces && !selected_intf_desc; j++) {
-		const struct libusb_interface *intf = &conf_desc->interface[j];
-		for (k = 0; k < intf->num_altsetting; k++) {
-			const struct libusb_interface_descriptor *intf_desc = &intf->altsetting[k];
-			if (intf_desc->bInterfaceClass == LIBUSB_CLASS_HID) {
-				if (interface_num < 0 || interface_num == intf_desc->bInterfaceNumber) {
-					selected_intf_desc = intf_desc;
-					break;
-				}
-			}
-		}
-	}
+	dev->report_id_queues[report_id] = ring;
+	if (ring && !old)
+		dev->num_report_id_queues++;
+	else if (!ring && old)
+		dev->num_report_id_queues--;
 
-	if (!selected_intf_desc) {
-		if (interface_num < 0) {
-			LOG("Sys USB device doesn't contain a HID interface\n");
-		}
-		else {
-			LOG("Sys USB device doesn't contain a HID interface with number %d\n", interface_num);
-		}
-		goto err;
+	unlock_input_queues();
+
+	if (old && !ring && !input_ring_empty(&dev->input_reports)) {
+		pthread_mutex_lock(&dev->mutex);
+		pthread_cond_broadcast(&dev->condition);
+		notify_input(dev);
+		pthread_mutex_unlock(&dev->mutex);
 	}
 
-	if (!hidapi_initialize_device(dev, conf_desc->bConfigurationValue, selected_intf_desc))
-		goto err;
+	if (old) {
+		input_ring_free(old);
+		free(old);
+	}
+	free(buf);
+	return 0;
+}
 
-	return dev;
+int HID_API_EXPORT hid_get_dropped_reports(hid_device *dev, unsigned long long *count)
+{
+	if (!count)
+		return -1;
 
-err:
-	if (conf_desc)
-		libusb_free_config_descriptor(conf_desc);
-	if (dev->device_handle)
-		libusb_close(dev->device_handle);
-	free_hid_device(dev);
-#else
-	(void)sys_dev;
-	(void)interface_num;
-	LOG("libusb_wrap_sys_device is not available\n");
-#endif
-	return NULL;
+	*count = atomic_load(&dev->dropped_reports);
+	return 0;
 }
 
 
-int HID_API_EXPORT hid_write(hid_device *dev, const unsigned char *data, size_t length)
+/* Signal the pollable descriptor of the device and put its poller entry,
+   if any, in the ready list of its poller.
+   Called with dev->mutex locked, whenever the device gets Input reports
+   to be read after its queue was empty, or its read thread ends. */
+static void notify_input(hid_device *dev)
 {
-	int res;
-	int report_number;
-	int skipped_report_id = 0;
+	struct hid_poller_entry *entry = dev->poller_entry;
+	hid_poller *poller;
 
-	if (!data || (length ==0)) {
-		return -1;
-	}
+	if (dev->has_pollable_fd)
+		wakeup_signal(&dev->pollable_fd);
 
-	report_number = data[0];
+	if (!entry)
+		return;
 
-	if (report_number == 0x0) {
-		data++;
-		length--;
-		skipped_report_id = 1;
+	poller = dev->poller;
+	pthread_mutex_lock(&poller->mutex);
+	if (!entry->ready) {
+		entry->ready = 1;
+		entry->next_ready = NULL;
+		if (poller->ready_tail)
+			poller->ready_tail->next_ready = entry;
+		else
+			poller->ready_head = entry;
+		poller->ready_tail = entry;
+		poller->ready_count++;
+		wakeup_signal(&poller->wakeup);
 	}
+	pthread_mutex_unlock(&poller->mutex);
+}
 
+/* Take the first entry out of the ready list of the poller. */
+static struct hid_poller_entry *poller_pop_ready(hid_poller *poller)
+{
+	struct hid_poller_entry *entry;
 
-	if (dev->output_endpoint <= 0) {
-		/* No interrupt out endpoint. Use the Control Endpoint */
-		res = libusb_control_transfer(dev->device_handle,
-			LIBUSB_REQUEST_TYPE_CLASS|LIBUSB_RECIPIENT_INTERFACE|LIBUSB_ENDPOINT_OUT,
-			0x09/*HID Set_Report*/,
-			(2/*HID output*/ << 8) | report_number,
-			dev->interface,
-			(unsigned char *)data, length,
-			1000/*timeout millis*/);
+	pthread_mutex_lock(&poller->mutex);
+	entry = poller->ready_head;
+	if (entry) {
+		poller->ready_head = entry->next_ready;
+		if (!poller->ready_head)
+			poller->ready_tail = NULL;
+		poller->ready_count--;
+		entry->ready = 0;
+	}
+	pthread_mutex_unlock(&poller->mutex);
 
-		if (res < 0)
-			return -1;
+	return entry;
+}
 
-		if (skipped_report_id)
-			length++;
+hid_poller HID_API_EXPORT * HID_API_CALL hid_poller_new(void)
+{
+	hid_poller *poller = (hid_poller*) calloc(1, sizeof(hid_poller));
+	if (!poller)
+		return NULL;
 
-		return length;
+	poller->buffer = (unsigned char*) malloc(POLLER_REPORT_SIZE * POLLER_BATCH);
+	if (!poller->buffer) {
+		free(poller);
+		return NULL;
 	}
-	else {
-		/* Use the interrupt out endpoint */
-		int actual_length;
-		res = libusb_interrupt_transfer(dev->device_handle,
-			dev->output_endpoint,
-			(unsigned char*)data,
-			length,
-			&actual_length, 1000);
 
-		if (res < 0)
-			return -1;
+	if (wakeup_init(&poller->wakeup) < 0) {
+		LOG("Unable to create the poller wakeup descriptor: %s\n", strerror(errno));
+		free(poller->buffer);
+		free(poller);
+		return NULL;
+	}
 
-		if (skipped_report_id)
-			actual_length++;
+	pthread_mutex_init(&poller->mutex, NULL);
 
-		return actual_length;
-	}
+	return poller;
 }
 
-/* Helper function, to simplify hid_read().
-   This should be called with dev->mutex locked. */
-static int return_data(hid_device *dev, unsigned char *data, size_t length)
+int HID_API_EXPORT HID_API_CALL hid_poller_add(hid_poller *poller, hid_device *dev, hid_poller_callback callback, void *user_data)
 {
-	/* Copy the data out of the linked list item (rpt) into the
-	   return buffer (data), and delete the liked list item. */
-	struct input_report *rpt = dev->input_reports;
-	size_t len = (length < rpt->len)? length: rpt->len;
-	if (len > 0)
-		memcpy(data, rpt->data, len);
-	dev->input_reports = rpt->next;
-	free(rpt->data);
-	free(rpt);
-	return len;
-}
+	struct hid_poller_entry *entry;
 
-static void cleanup_mutex(void *param)
-{
-	hid_device *dev = param;
+	if (!poller || !dev || !callback || dev->poller)
+		return -1;
+
+	entry = (struct hid_poller_entry*) calloc(1, sizeof(struct hid_poller_entry));
+	if (!entry)
+		return -1;
+	entry->dev = dev;
+	entry->callback = callback;
+	entry->user_data = user_data;
+
+	entry->next = poller->entries;
+	poller->entries = entry;
+
+	pthread_mutex_lock(&dev->mutex);
+	dev->poller = poller;
+	dev->poller_entry = entry;
+	atomic_fetch_add(&dev->input_listeners, 1);
+	/* Reports queued before the device was added */
+	if (!input_ring_empty(&dev->input_reports) || dev->shutdown_thread)
+		notify_input(dev);
 	pthread_mutex_unlock(&dev->mutex);
-}
 
+	return 0;
+}
 
-int HID_API_EXPORT hid_read_timeout(hid_device *dev, unsigned char *data, size_t length, int milliseconds)
+int HID_API_EXPORT HID_API_CALL hid_poller_remove(hid_poller *poller, hid_device *dev)
 {
-#if 0
-	int transferred;
-	int res = libusb_interrupt_transfer(dev->device_handle, dev->input_endpoint, data, length, &transferred, 5000);
-	LOG("transferred: %d\n", transferred);
-	return transferred;
-#endif
-	/* by initialising this variable right here, GCC gives a compilation warning/error: */
-	/* error: variable ‘bytes_read’ might be clobbered by ‘longjmp’ or ‘vfork’ [-Werror=clobbered] */
-	int bytes_read; /* = -1; */
+	struct hid_poller_entry *entry;
 
-	pthread_mutex_lock(&dev->mutex);
-	pthread_cleanup_push(&cleanup_mutex, dev);
+	if (!poller || !dev || dev->poller != poller)
+		return -1;
 
-	bytes_read = -1;
+	/* Once this is done, the read thread doesn't touch the entry anymore */
+	pthread_mutex_lock(&dev->mutex);
+	entry = dev->poller_entry;
+	dev->poller_entry = NULL;
+	dev->poller = NULL;
+	atomic_fetch_sub(&dev->input_listeners, 1);
+	pthread_mutex_unlock(&dev->mutex);
 
-	/* There's an input report queued up. Return it. */
-	if (dev->input_reports) {
-		/* Return the first one */
-		bytes_read = return_data(dev, data, length);
-		goto ret;
+	pthread_mutex_lock(&poller->mutex);
+	if (entry->ready) {
+		struct hid_poller_entry **cur = &poller->ready_head;
+		struct hid_poller_entry *prev = NULL;
+		while (*cur != entry) {
+			prev = *cur;
+			cur = &(*cur)->next_ready;
+		}
+		*cur = entry->next_ready;
+		if (poller->ready_tail == entry)
+			poller->ready_tail = prev;
+		poller->ready_count--;
+		entry->ready = 0;
 	}
+	pthread_mutex_unlock(&poller->mutex);
 
-	if (dev->shutdown_thread) {
-		/* This means the device has been disconnected.
-		   An error code of -1 should be returned. */
-		bytes_read = -1;
-		goto ret;
-	}
+	entry->removed = 1;
+	entry->dev = NULL;
 
-	if (milliseconds == -1) {
-		/* Blocking */
-		while (!dev->input_reports && !dev->shutdown_thread) {
-			pthread_cond_wait(&dev->condition, &dev->mutex);
-		}
-		if (dev->input_reports) {
-			bytes_read = return_data(dev, data, length);
-		}
+	/* hid_poller_run() may still be dispatching the entry */
+	if (!poller->running) {
+		struct hid_poller_entry **cur = &poller->entries;
+		while (*cur != entry)
+			cur = &(*cur)->next;
+		*cur = entry->next;
+		free(entry);
 	}
-	else if (milliseconds > 0) {
-		/* Non-blocking, but called with timeout. */
+
+	return 0;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_poller_run(hid_poller *poller, int milliseconds)
+{
+	struct hid_poller_entry **cur;
+	int count = 0;
+	int pending;
+
+	if (!poller)
+		return -1;
+
+	pthread_mutex_lock(&poller->mutex);
+	pending = poller->ready_count;
+	pthread_mutex_unlock(&poller->mutex);
+
+	if (pending == 0 && milliseconds != 0) {
+		struct pollfd fds;
 		int res;
-		struct timespec ts;
-		clock_gettime(CLOCK_REALTIME, &ts);
-		ts.tv_sec += milliseconds / 1000;
-		ts.tv_nsec += (milliseconds % 1000) * 1000000;
-		if (ts.tv_nsec >= 1000000000L) {
-			ts.tv_sec++;
-			ts.tv_nsec -= 1000000000L;
+
+		fds.fd = poller->wakeup.read_fd;
+		fds.events = POLLIN;
+		fds.revents = 0;
+		res = poll(&fds, 1, milliseconds);
+		if (res == -1 && errno != EINTR) {
+			LOG("hid_poller_run(): poll failed: %s\n", strerror(errno));
+			return -1;
 		}
+	}
 
-		while (!dev->input_reports && !dev->shutdown_thread) {
-			res = pthread_cond_timedwait(&dev->condition, &dev->mutex, &ts);
-			if (res == 0) {
-				if (dev->input_reports) {
-					bytes_read = return_data(dev, data, length);
-					break;
-				}
+	/* Entries made ready after this point signal the wakeup again,
+	   the ready list itself is what tells which devices have data. */
+	wakeup_clear(&poller->wakeup);
 
-				/* If we're here, there was a spurious wake up
-				   or the read thread was shutdown. Run the
-				   loop again (ie: don't break). */
-			}
-			else if (res == ETIMEDOUT) {
-				/* Timed out. */
-				bytes_read = 0;
+	pthread_mutex_lock(&poller->mutex);
+	pending = poller->ready_count;
+	pthread_mutex_unlock(&poller->mutex);
+
+	poller->running = 1;
+
+	/* Only the entries which are ready now are dispatched, so that
+	   a device that keeps sending reports can't stall this call. */
+	while (pending-- > 0) {
+		struct hid_poller_entry *entry = poller_pop_ready(poller);
+		hid_device *dev;
+		int res;
+
+		if (!entry)
+			break;
+		dev = entry->dev;
+
+		do {
+			res = hid_read_batch(dev, poller->buffer, POLLER_REPORT_SIZE, POLLER_BATCH, poller->lengths, 0);
+			if (res < 0) {
+				/* The device was disconnected */
+				hid_poller_remove(poller, dev);
+				entry->callback(dev, NULL, 0, entry->user_data);
 				break;
 			}
-			else {
-				/* Error. */
-				bytes_read = -1;
-				break;
+
+			for (int i = 0; i < res && !entry->removed; i++) {
+				entry->callback(dev, poller->buffer + i * POLLER_REPORT_SIZE, poller->lengths[i], entry->user_data);
+				count++;
 			}
-		}
-	}
-	else {
-		/* Purely non-blocking */
-		bytes_read = 0;
+		} while (res == POLLER_BATCH && !entry->removed);
 	}
 
-ret:
-	pthread_mutex_unlock(&dev->mutex);
-	pthread_cleanup_pop(0);
+	poller->running = 0;
 
-	return bytes_read;
-}
+	/* Free the entries removed by the callbacks */
+	cur = &poller->entries;
+	while (*cur) {
+		struct hid_poller_entry *entry = *cur;
+		if (entry->removed) {
+			*cur = entry->next;
+			free(entry);
+		}
+		else {
+			cur = &entry->next;
+		}
+	}
 
-int HID_API_EXPORT hid_read(hid_device *dev, unsigned char *data, size_t length)
-{
-	return hid_read_timeout(dev, data, length, dev->blocking ? -1 : 0);
+	return count;
 }
 
-int HID_API_EXPORT hid_set_nonblocking(hid_device *dev, int nonblock)
+void HID_API_EXPORT HID_API_CALL hid_poller_free(hid_poller *poller)
 {
-	dev->blocking = !nonblock;
+	if (!poller)
+		return;
 
-	return 0;
+	while (poller->entries)
+		hid_poller_remove(poller, poller->entries->dev);
+
+	wakeup_destroy(&poller->wakeup);
+	pthread_mutex_destroy(&poller->mutex);
+	free(poller->buffer);
+	free(poller);
 }
 
 
@@ -1542,20 +3573,46 @@ int HID_API_EXPORT HID_API_CALL hid_get_input_report(hid_device *dev, unsigned c
 
 void HID_API_EXPORT hid_close(hid_device *dev)
 {
+	int i;
+
 	if (!dev)
 		return;
 
+	if (dev->poller)
+		hid_poller_remove(dev->poller, dev);
+
 	/* Cause read_thread() to stop. */
+	pthread_mutex_lock(&dev->mutex);
 	dev->shutdown_thread = 1;
-	libusb_cancel_transfer(dev->transfer);
+	pthread_mutex_unlock(&dev->mutex);
+	for (i = 0; i < dev->num_transfers; i++)
+		libusb_cancel_transfer(dev->transfers[i]);
+	/* The parked transfers are not submitted, so can't be cancelled */
+#if LIBUSB_API_VERSION >= 0x01000105
+	/* read_thread() may not get any other event */
+	if (resume_parked_transfers(dev) > 0 && !dev->shared_event_thread)
+		libusb_interrupt_event_handler(usb_context);
+#else
+	resume_parked_transfers(dev);
+#endif
 
-	/* Wait for read_thread() to end. */
-	pthread_join(dev->thread, NULL);
+	if (dev->shared_event_thread) {
+		/* Wait for the cancelled transfers to complete */
+		while (!dev->transfer_loop_finished)
+			libusb_handle_events_completed(usb_context, &dev->transfer_loop_finished);
+		event_thread_release();
+	}
+	else {
+		/* Wait for read_thread() to end. */
+		pthread_join(dev->thread, NULL);
+	}
 
 	/* Clean up the Transfer objects allocated in read_thread(). */
-	free(dev->transfer->buffer);
-	dev->transfer->buffer = NULL;
-	libusb_free_transfer(dev->transfer);
+	for (i = 0; i < dev->num_transfers; i++) {
+		free(dev->transfers[i]->buffer);
+		dev->transfers[i]->buffer = NULL;
+		libusb_free_transfer(dev->transfers[i]);
+	}
 
 	/* release the interface */
 	libusb_release_interface(dev->device_handle, dev->interface);
@@ -1572,13 +3629,6 @@ void HID_API_EXPORT hid_close(hid_device *dev)
 	/* Close the handle */
 	libusb_close(dev->device_handle);
 
-	/* Clear out the queue of received reports. */
-	pthread_mutex_lock(&dev->mutex);
-	while (dev->input_reports) {
-		return_data(dev, NULL, 0);
-	}
-	pthread_mutex_unlock(&dev->mutex);
-
 	free_hid_device(dev);
 }
 
@@ -1598,23 +3648,87 @@ int HID_API_EXPORT_CALL hid_get_serial_number_string(hid_device *dev, wchar_t *s
 	return hid_get_indexed_string(dev, dev->serial_index, string, maxlen);
 }
 
+/* Reads the report descriptor of the device, only once */
+static int cache_report_descriptor(hid_device *dev)
+{
+	unsigned char report_descriptor[HID_API_MAX_REPORT_DESCRIPTOR_SIZE];
+	int res;
+
+	if (dev->report_descriptor)
+		return 0;
+
+	res = hid_get_report_descriptor_libusb(dev->device_handle, dev->interface, dev->report_descriptor_size, report_descriptor, sizeof(report_descriptor));
+	if (res < 0)
+		return -1;
+
+	dev->report_descriptor = (unsigned char*) malloc(res? (size_t) res: 1);
+	if (!dev->report_descriptor)
+		return -1;
+	memcpy(dev->report_descriptor, report_descriptor, (size_t) res);
+	dev->report_descriptor_length = (size_t) res;
+
+	return 0;
+}
+
 HID_API_EXPORT struct hid_device_info *HID_API_CALL hid_get_device_info(hid_device *dev) {
 	if (!dev->device_info) {
 		struct libusb_device_descriptor desc;
 		libusb_device *usb_device = libusb_get_device(dev->device_handle);
 		libusb_get_device_descriptor(usb_device, &desc);
 
-		dev->device_info = create_device_info_for_device(usb_device, dev->device_handle, &desc, dev->config_number, dev->interface);
+		dev->device_info = create_device_info_for_device(usb_device, dev->device_handle, &desc, dev->config_number, dev->interface, &enum_filter_all);
 		// device error already set by create_device_info_for_device, if any
 
-		if (dev->device_info) {
-			fill_device_info_usage(dev->device_info, dev->device_handle, dev->interface, dev->report_descriptor_size);
+		if (dev->device_info && cache_report_descriptor(dev) == 0) {
+			unsigned short page = 0, usage = 0;
+			unsigned int pos = 0;
+
+			/* The usages of the first top-level collection */
+			if (hidapi_get_next_usage(dev->report_descriptor, dev->report_descriptor_length, &pos, &page, &usage) == 0) {
+				dev->device_info->usage_page = page;
+				dev->device_info->usage = usage;
+			}
 		}
 	}
 
 	return dev->device_info;
 }
 
+int HID_API_EXPORT_CALL hid_get_report_descriptor(hid_device *dev, unsigned char *buf, size_t buf_size)
+{
+	size_t copy_len;
+
+	if (cache_report_descriptor(dev) < 0)
+		return -1;
+
+	copy_len = dev->report_descriptor_length;
+	if (copy_len > buf_size)
+		copy_len = buf_size;
+	memcpy(buf, dev->report_descriptor, copy_len);
+
+	return (int) copy_len;
+}
+
+HID_API_EXPORT const struct hid_report_layout * HID_API_CALL hid_get_report_layout(hid_device *dev)
+{
+	if (dev->report_layout)
+		return dev->report_layout;
+
+	if (cache_report_descriptor(dev) < 0)
+		return NULL;
+
+	dev->report_layout = hidapi_compile_report_layout(dev->report_descriptor, dev->report_descriptor_length);
+	if (!dev->report_layout)
+		LOG("can't compile the report descriptor\n");
+
+	return dev->report_layout;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_decode_report(const struct hid_report_layout *layout, const unsigned char *report, size_t length, int *values, size_t max_values)
+{
+	return hidapi_decode_report(layout, report, length, values, max_values);
+}
+
 int HID_API_EXPORT_CALL hid_get_indexed_string(hid_device *dev, int string_index, wchar_t *string, size_t maxlen)
 {
 	wchar_t *str;
@@ -1782,18 +3896,41 @@ static struct lang_map_entry lang_map[] = {
 	LANG(NULL, NULL, 0x0),
 };
 
+/* The result of the last lookup in lang_map, see get_usb_code_for_current_locale() */
+static pthread_mutex_t locale_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static char locale_cache_name[64];
+static uint16_t locale_cache_code = 0x0;
+
+static uint16_t lookup_usb_code_for_locale(const char *locale);
+
 uint16_t get_usb_code_for_current_locale(void)
 {
 	char *locale;
-	char search_string[64];
-	char *ptr;
-	struct lang_map_entry *lang;
+	uint16_t code;
 
 	/* Get the current locale. */
 	locale = setlocale(0, NULL);
 	if (!locale)
 		return 0x0;
 
+	/* The locale rarely changes, don't scan lang_map every time */
+	pthread_mutex_lock(&locale_cache_mutex);
+	if (locale_cache_name[0] == '\0' || strncmp(locale_cache_name, locale, sizeof(locale_cache_name) - 1) != 0) {
+		strncpy(locale_cache_name, locale, sizeof(locale_cache_name) - 1);
+		locale_cache_code = lookup_usb_code_for_locale(locale);
+	}
+	code = locale_cache_code;
+	pthread_mutex_unlock(&locale_cache_mutex);
+
+	return code;
+}
+
+static uint16_t lookup_usb_code_for_locale(const char *locale)
+{
+	char search_string[64];
+	char *ptr;
+	struct lang_map_entry *lang;
+
 	/* Make a copy of the current locale string. */
 	strncpy(search_string, locale, sizeof(search_string));
 	search_string[sizeof(search_string)-1] = '\0';
@@ -49,6 +49,61 @@ extern "C" {
 		*/
 		HID_API_EXPORT hid_device * HID_API_CALL hid_libusb_wrap_sys_device(intptr_t sys_dev, int interface_num);
 
+		/** @brief Changes the number of interrupt IN transfers kept in flight
+			for all further calls to @ref hid_open, @ref hid_open_path
+			and @ref hid_libusb_wrap_sys_device.
+
+			With a single transfer, no transfer is queued between the completion
+			of a transfer and its resubmission, and devices with a high polling
+			rate may lose reports. Keeping more transfers in flight avoids that,
+			at the cost of one buffer of the endpoint's max packet size each.
+			The reports are still returned in the order they were sent.
+
+			Since version 0.14.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 14, 0)
+
+			@ingroup API
+			@param count The number of transfers, from 1 (the default) to 16.
+				Values out of range are clamped.
+		*/
+		void HID_API_EXPORT_CALL hid_libusb_set_input_transfers(int count);
+
+		/** @brief Getter for option set by @ref hid_libusb_set_input_transfers.
+
+			Since version 0.14.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 14, 0)
+
+			@ingroup API
+			@return The number of interrupt IN transfers the devices opened from now on use.
+		*/
+		int HID_API_EXPORT_CALL hid_libusb_get_input_transfers(void);
+
+		/** @brief Changes how the devices opened by all further calls to
+			@ref hid_open, @ref hid_open_path and @ref hid_libusb_wrap_sys_device
+			handle their transfers.
+
+			By default each opened device gets a thread of its own, which
+			handles the libusb events. With this option enabled, a single
+			thread handles the events of all such devices instead, which saves
+			a thread per device, and the cost of starting it in hid_open().
+			The thread is started with the first of these devices and
+			stopped when the last of them is closed.
+
+			Since version 0.14.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 14, 0)
+
+			@ingroup API
+			@param enable When set to 0 (the default) - each device gets its own thread.
+				Otherwise - all further devices share a single thread.
+		*/
+		void HID_API_EXPORT_CALL hid_libusb_set_shared_event_thread(int enable);
+
+		/** @brief Getter for option set by @ref hid_libusb_set_shared_event_thread.
+
+			Since version 0.14.0, @ref HID_API_VERSION >= HID_API_MAKE_VERSION(0, 14, 0)
+
+			@ingroup API
+			@return 1 if the devices opened from now on share a single event thread.
+		*/
+		int HID_API_EXPORT_CALL hid_libusb_get_shared_event_thread(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -24,25 +24,46 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <limits.h>
 #include <locale.h>
 #include <errno.h>
+#include <stdarg.h>
 
 /* Unix */
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/ioctl.h>
+#include <sys/sysmacros.h>
 #include <sys/utsname.h>
+#include <dirent.h>
 #include <fcntl.h>
 #include <poll.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 
 /* Linux */
 #include <linux/hidraw.h>
 #include <linux/version.h>
 #include <linux/input.h>
+#ifdef HIDAPI_NO_LIBUDEV
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#else
 #include <libudev.h>
+#endif
+
+#ifdef HIDAPI_USE_IO_URING
+#include <stdint.h>
+#include <liburing.h>
+#endif
 
 #include "hidapi.h"
+#include "hidapi_device_info.h"
+#include "hidapi_parallel.h"
+#include "hidapi_report_descriptor.h"
+#include "hidapi_utf.h"
 
 #ifdef HIDAPI_ALLOW_BUILD_WORKAROUND_KERNEL_2_6_39
 /* This definitions first appeared in Linux Kernel 2.6.39 in linux/hidraw.h.
@@ -68,11 +89,84 @@
 #define HIDIOCGINPUT(len)    _IOC(_IOC_WRITE|_IOC_READ, 'H', 0x0A, len)
 #endif
 
+/* Maximum size of a report read from hidraw */
+#define HIDRAW_MAX_REPORT_SIZE 4096
+
+#ifdef HIDAPI_USE_IO_URING
+/* Number of input report buffers provided to the kernel for each device.
+   Must be a power of 2. */
+#define HIDRAW_URING_BUFFERS 16
+/* Size of each of the input report buffers. */
+#define HIDRAW_URING_BUFFER_SIZE HIDRAW_MAX_REPORT_SIZE
+/* Maximum number of devices served by the io_uring engine at the same time,
+   devices opened above that use the plain poll()/read() path. */
+#define HIDRAW_URING_MAX_DEVICES 1024
+#define HIDRAW_URING_QUEUE_DEPTH 256
+#endif
+
+/* Size of the buffer used by hid_poller_run() for each report */
+#define HIDRAW_POLLER_REPORT_SIZE HIDRAW_MAX_REPORT_SIZE
+/* Maximum number of reports hid_poller_run() reads from a device at once */
+#define HIDRAW_POLLER_BATCH 16
+/* Maximum number of devices hid_poller_run() waits for at once */
+#define HIDRAW_POLLER_EVENTS 64
+
+struct hid_poller_entry;
+
+/* Queue of the input reports moved out of the kernel buffer on each read,
+   see hid_set_input_queue(). Each record is the length of the report
+   (2 bytes) followed by the report, records wrap around the end of the
+   buffer. The buffer grows as needed, up to max_bytes.
+   Only used by the thread reading from the device, so no locking. */
+struct input_queue {
+	unsigned char *buffer;
+	size_t size;
+	size_t start; /* Offset of the oldest record */
+	size_t used;
+	size_t count;
+	size_t max_reports;
+	size_t max_bytes; /* 0 - no limit */
+	hid_queue_policy policy;
+	/* With HID_API_QUEUE_BLOCK, a report read from the kernel
+	   which didn't fit in the queue yet */
+	unsigned char *pending;
+	int pending_length; /* -1 - none */
+};
+
 struct hid_device_ {
 	int device_handle;
 	int blocking;
 	wchar_t *last_error_str;
 	struct hid_device_info* device_info;
+	struct hid_report_layout *report_layout; /* Compiled at the first hid_get_report_layout() */
+	unsigned char *report_descriptor; /* NULL until read, see cache_report_descriptor() */
+	size_t report_descriptor_size;
+	hid_poller *poller;
+	struct hid_poller_entry *poller_entry;
+	struct input_queue *input_queue; /* NULL - reports are read from the kernel directly */
+	/* The queues of the report IDs read with hid_read_report_id(),
+	   NULL until the first hid_set_report_id_queue(), then 256 entries */
+	struct input_queue **report_id_queues;
+	int num_report_id_queues;
+	unsigned long long dropped_reports;
+#ifdef HIDAPI_USE_IO_URING
+	/* Buffer group of this device in the io_uring engine,
+	   -1 if the device is read with poll()/read() */
+	int uring_bgid;
+	struct io_uring_buf_ring *uring_buf_ring;
+	unsigned char *uring_buffers;
+	/* FIFO of the buffers holding completed, not yet read, reports */
+	unsigned short uring_ready_bid[HIDRAW_URING_BUFFERS];
+	unsigned int uring_ready_len[HIDRAW_URING_BUFFERS];
+	unsigned int uring_ready_head;
+	unsigned int uring_ready_count;
+	int uring_armed; /* a read request is outstanding */
+	int uring_closing;
+	int uring_error; /* errno of the read that failed, which stops reading */
+	int uring_event_fd; /* readable while there are completed reports or an error */
+	pthread_mutex_t uring_mutex; /* Protects all of the uring_ fields above */
+	pthread_cond_t uring_condition;
+#endif
 };
 
 static struct hid_api_version api_version = {
@@ -82,6 +176,8 @@ static struct hid_api_version api_version = {
 };
 
 static wchar_t *last_global_error_str = NULL;
+/* The devices may be read from several threads, see hid_set_enumeration_threads() */
+static pthread_mutex_t global_error_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 
 static hid_device *new_hid_device(void)
@@ -95,42 +191,24 @@ static hid_device *new_hid_device(void)
 	dev->blocking = 1;
 	dev->last_error_str = NULL;
 	dev->device_info = NULL;
+	dev->report_layout = NULL;
+	dev->report_descriptor = NULL;
+#ifdef HIDAPI_USE_IO_URING
+	dev->uring_bgid = -1;
+#endif
 
 	return dev;
 }
 
 
-/* The caller must free the returned string with free(). */
-static wchar_t *utf8_to_wchar_t(const char *utf8)
-{
-	wchar_t *ret = NULL;
-
-	if (utf8) {
-		size_t wlen = mbstowcs(NULL, utf8, 0);
-		if ((size_t) -1 == wlen) {
-			return wcsdup(L"");
-		}
-		ret = (wchar_t*) calloc(wlen+1, sizeof(wchar_t));
-		if (ret == NULL) {
-			/* as much as we can do at this point */
-			return NULL;
-		}
-		mbstowcs(ret, utf8, wlen+1);
-		ret[wlen] = 0x0000;
-	}
-
-	return ret;
-}
-
-
-/* Makes a copy of the given error message (and decoded according to the
- * currently locale) into the wide string pointer pointed by error_str.
+/* Makes a copy of the given error message (decoded as UTF-8)
+ * into the wide string pointer pointed by error_str.
  * The last stored error string is freed.
  * Use register_error_str(NULL) to free the error message completely. */
 static void register_error_str(wchar_t **error_str, const char *msg)
 {
 	free(*error_str);
-	*error_str = utf8_to_wchar_t(msg);
+	*error_str = hidapi_utf8_to_wchar(msg);
 }
 
 /* Semilar to register_error_str, but allows passing a format string with va_list args into this function. */
@@ -149,7 +227,9 @@ static void register_error_str_vformat(wchar_t **error_str, const char *format,
  * Use register_global_error(NULL) to indicate "no error". */
 static void register_global_error(const char *msg)
 {
+	pthread_mutex_lock(&global_error_mutex);
 	register_error_str(&last_global_error_str, msg);
+	pthread_mutex_unlock(&global_error_mutex);
 }
 
 /* Similar to register_global_error, but allows passing a format string into this function. */
@@ -157,7 +237,9 @@ static void register_global_error_format(const char *format, ...)
 {
 	va_list args;
 	va_start(args, format);
+	pthread_mutex_lock(&global_error_mutex);
 	register_error_str_vformat(&last_global_error_str, format, args);
+	pthread_mutex_unlock(&global_error_mutex);
 	va_end(args);
 }
 
@@ -180,185 +262,119 @@ static void register_device_error_format(hid_device *dev, const char *format, ..
 	va_end(args);
 }
 
-/* Get an attribute value from a udev_device and return it as a whar_t
-   string. The returned string must be freed with free() when done.*/
-static wchar_t *copy_udev_string(struct udev_device *dev, const char *udev_name)
-{
-	return utf8_to_wchar_t(udev_device_get_sysattr_value(dev, udev_name));
-}
+/* Devices are read from sysfs directly, relative to the directory of
+   the device (dirfd), rather than through libudev: the attributes are
+   the same, without the cost of a udev context and of building
+   udev_device objects for every parent. */
 
-/*
- * Gets the size of the HID item at the given position
- * Returns 1 if successful, 0 if an invalid key
- * Sets data_len and key_size when successful
- */
-static int get_hid_item_size(__u8 *report_descriptor, unsigned int pos, __u32 size, int *data_len, int *key_size)
+/* Reads an attribute (a file) of the sysfs directory dirfd.
+   Returns a newly allocated string without the trailing newline,
+   or NULL if the attribute can't be read. */
+static char *read_sysfs_attribute(int dirfd, const char *name)
 {
-	int key = report_descriptor[pos];
-	int size_code;
+	char buf[4096]; /* The size limit of sysfs attributes */
+	ssize_t len;
+	int fd;
 
-	/*
-	 * This is a Long Item. The next byte contains the
-	 * length of the data section (value) for this key.
-	 * See the HID specification, version 1.11, section
-	 * 6.2.2.3, titled "Long Items."
-	 */
-	if ((key & 0xf0) == 0xf0) {
-		if (pos + 1 < size)
-		{
-			*data_len = report_descriptor[pos + 1];
-			*key_size = 3;
-			return 1;
-		}
-		*data_len = 0; /* malformed report */
-		*key_size = 0;
-	}
+	fd = openat(dirfd, name, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return NULL;
 
-	/*
-	 * This is a Short Item. The bottom two bits of the
-	 * key contain the size code for the data section
-	 * (value) for this key. Refer to the HID
-	 * specification, version 1.11, section 6.2.2.2,
-	 * titled "Short Items."
-	 */
-	size_code = key & 0x3;
-	switch (size_code) {
-	case 0:
-	case 1:
-	case 2:
-		*data_len = size_code;
-		*key_size = 1;
-		return 1;
-	case 3:
-		*data_len = 4;
-		*key_size = 1;
-		return 1;
-	default:
-		/* Can't ever happen since size_code is & 0x3 */
-		*data_len = 0;
-		*key_size = 0;
-		break;
-	};
+	len = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (len < 0)
+		return NULL;
 
-	/* malformed report */
-	return 0;
+	while (len > 0 && buf[len - 1] == '\n')
+		len--;
+	buf[len] = '\0';
+
+	return strdup(buf);
 }
 
-/*
- * Get bytes from a HID Report Descriptor.
- * Only call with a num_bytes of 0, 1, 2, or 4.
- */
-static __u32 get_hid_report_bytes(__u8 *rpt, size_t len, size_t num_bytes, size_t cur)
+/* Get an attribute value of a sysfs directory and return it as a whar_t
+   string. The returned string must be freed with free() when done.*/
+static wchar_t *copy_sysfs_string(int dirfd, const char *name)
 {
-	/* Return if there aren't enough bytes. */
-	if (cur + num_bytes >= len)
-		return 0;
-
-	if (num_bytes == 0)
-		return 0;
-	else if (num_bytes == 1)
-		return rpt[cur + 1];
-	else if (num_bytes == 2)
-		return (rpt[cur + 2] * 256 + rpt[cur + 1]);
-	else if (num_bytes == 4)
-		return (
-			rpt[cur + 4] * 0x01000000 +
-			rpt[cur + 3] * 0x00010000 +
-			rpt[cur + 2] * 0x00000100 +
-			rpt[cur + 1] * 0x00000001
-		);
-	else
-		return 0;
+	char *str = read_sysfs_attribute(dirfd, name);
+	wchar_t *ret = hidapi_utf8_to_wchar(str);
+	free(str);
+	return ret;
 }
 
-/*
- * Retrieves the device's Usage Page and Usage from the report descriptor.
- * The algorithm returns the current Usage Page/Usage pair whenever a new
- * Collection is found and a Usage Local Item is currently in scope.
- * Usage Local Items are consumed by each Main Item (See. 6.2.2.8).
- * The algorithm should give similar results as Apple's:
- *   https://developer.apple.com/documentation/iokit/kiohiddeviceusagepairskey?language=objc
- * Physical Collections are also matched (macOS does the same).
- *
- * This function can be called repeatedly until it returns non-0
- * Usage is found. pos is the starting point (initially 0) and will be updated
- * to the next search position.
- *
- * The return value is 0 when a pair is found.
- * 1 when finished processing descriptor.
- * -1 on a malformed report.
- */
-static int get_next_hid_usage(__u8 *report_descriptor, __u32 size, unsigned int *pos, unsigned short *usage_page, unsigned short *usage)
+/* Returns the value of key in the "KEY=value" lines of a uevent,
+   as a pointer into the uevent (up to the end of the line), or NULL. */
+static const char *find_uevent_value(const char *uevent, const char *key, size_t *value_len)
 {
-	int data_len, key_size;
-	int initial = *pos == 0; /* Used to handle case where no top-level application collection is defined */
-	int usage_pair_ready = 0;
-
-	/* Usage is a Local Item, it must be set before each Main Item (Collection) before a pair is returned */
-	int usage_found = 0;
+	size_t key_len = strlen(key);
+	const char *line = uevent;
+
+	while (line && *line) {
+		const char *end = strchr(line, '\n');
+		if (strncmp(line, key, key_len) == 0 && line[key_len] == '=') {
+			const char *value = line + key_len + 1;
+			*value_len = end? (size_t) (end - value): strlen(value);
+			return value;
+		}
+		line = end? end + 1: NULL;
+	}
 
-	while (*pos < size) {
-		int key = report_descriptor[*pos];
-		int key_cmd = key & 0xfc;
+	return NULL;
+}
 
-		/* Determine data_len and key_size */
-		if (!get_hid_item_size(report_descriptor, *pos, size, &data_len, &key_size))
-			return -1; /* malformed report */
+/* Opens the closest parent of the sysfs device directory dirfd which
+   has the given DEVTYPE (e.g. "usb_device"). Returns -1 if there is none. */
+static int open_sysfs_parent_with_devtype(int dirfd, const char *devtype)
+{
+	struct stat sysfs_stat;
+	struct stat parent_stat;
+	int parent;
+	int depth;
 
-		switch (key_cmd) {
-		case 0x4: /* Usage Page 6.2.2.7 (Global) */
-			*usage_page = get_hid_report_bytes(report_descriptor, size, data_len, *pos);
-			break;
+	if (fstat(dirfd, &sysfs_stat) < 0)
+		return -1;
 
-		case 0x8: /* Usage 6.2.2.8 (Local) */
-			*usage = get_hid_report_bytes(report_descriptor, size, data_len, *pos);
-			usage_found = 1;
-			break;
+	parent = openat(dirfd, "..", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
 
-		case 0xa0: /* Collection 6.2.2.4 (Main) */
-			/* A Usage Item (Local) must be found for the pair to be valid */
-			if (usage_found)
-				usage_pair_ready = 1;
+	/* Up to the root of sysfs (a different file system is above it) */
+	for (depth = 0; parent >= 0 && depth < 32; depth++) {
+		char *uevent;
+		const char *value;
+		size_t value_len = 0;
+		int next;
 
-			/* Usage is a Local Item, unset it */
-			usage_found = 0;
+		if (fstat(parent, &parent_stat) < 0 || parent_stat.st_dev != sysfs_stat.st_dev)
 			break;
 
-		case 0x80: /* Input 6.2.2.4 (Main) */
-		case 0x90: /* Output 6.2.2.4 (Main) */
-		case 0xb0: /* Feature 6.2.2.4 (Main) */
-		case 0xc0: /* End Collection 6.2.2.4 (Main) */
-			/* Usage is a Local Item, unset it */
-			usage_found = 0;
-			break;
+		uevent = read_sysfs_attribute(parent, "uevent");
+		value = uevent? find_uevent_value(uevent, "DEVTYPE", &value_len): NULL;
+		if (value && value_len == strlen(devtype) && strncmp(value, devtype, value_len) == 0) {
+			free(uevent);
+			return parent;
 		}
+		free(uevent);
 
-		/* Skip over this key and its associated data */
-		*pos += data_len + key_size;
-
-		/* Return usage pair */
-		if (usage_pair_ready)
-			return 0;
+		next = openat(parent, "..", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		close(parent);
+		parent = next;
 	}
 
-	/* If no top-level application collection is found and usage page/usage pair is found, pair is valid
-	   https://docs.microsoft.com/en-us/windows-hardware/drivers/hid/top-level-collections */
-	if (initial && usage_found)
-		return 0; /* success */
+	if (parent >= 0)
+		close(parent);
 
-	return 1; /* finished processing */
+	return -1;
 }
 
 /*
  * Retrieves the hidraw report descriptor from a file.
  * When using this form, <sysfs_path>/device/report_descriptor, elevated priviledges are not required.
  */
-static int get_hid_report_descriptor(const char *rpt_path, struct hidraw_report_descriptor *rpt_desc)
+static int get_hid_report_descriptor(int dirfd, const char *rpt_path, struct hidraw_report_descriptor *rpt_desc)
 {
 	int rpt_handle;
 	ssize_t res;
 
-	rpt_handle = open(rpt_path, O_RDONLY | O_CLOEXEC);
+	rpt_handle = openat(dirfd, rpt_path, O_RDONLY | O_CLOEXEC);
 	if (rpt_handle < 0) {
 		register_global_error_format("open failed (%s): %s", rpt_path, strerror(errno));
 		return -1;
@@ -381,106 +397,6 @@ static int get_hid_report_descriptor(const char *rpt_path, struct hidraw_report_
 	return (int) res;
 }
 
-/* return size of the descriptor, or -1 on failure */
-static int get_hid_report_descriptor_from_sysfs(const char *sysfs_path, struct hidraw_report_descriptor *rpt_desc)
-{
-	int res = -1;
-	/* Construct <sysfs_path>/device/report_descriptor */
-	size_t rpt_path_len = strlen(sysfs_path) + 25 + 1;
-	char* rpt_path = (char*) calloc(1, rpt_path_len);
-	snprintf(rpt_path, rpt_path_len, "%s/device/report_descriptor", sysfs_path);
-
-	res = get_hid_report_descriptor(rpt_path, rpt_desc);
-	free(rpt_path);
-
-	return res;
-}
-
-/* return non-zero if successfully parsed */
-static int parse_hid_vid_pid_from_uevent(const char *uevent, unsigned *bus_type, unsigned short *vendor_id, unsigned short *product_id)
-{
-	char tmp[1024];
-	size_t uevent_len = strlen(uevent);
-	if (uevent_len > sizeof(tmp) - 1)
-		uevent_len = sizeof(tmp) - 1;
-	memcpy(tmp, uevent, sizeof(tmp));
-	tmp[uevent_len] = '\0';
-
-	char *saveptr = NULL;
-	char *line;
-	char *key;
-	char *value;
-
-	line = strtok_r(tmp, "\n", &saveptr);
-	while (line != NULL) {
-		/* line: "KEY=value" */
-		key = line;
-		value = strchr(line, '=');
-		if (!value) {
-			goto next_line;
-		}
-		*value = '\0';
-		value++;
-
-		if (strcmp(key, "HID_ID") == 0) {
-			/**
-			 *        type vendor   product
-			 * HID_ID=0003:000005AC:00008242
-			 **/
-			int ret = sscanf(value, "%x:%hx:%hx", bus_type, vendor_id, product_id);
-			if (ret == 3) {
-				return 1;
-			}
-		}
-
-next_line:
-		line = strtok_r(NULL, "\n", &saveptr);
-	}
-
-	register_global_error("Couldn't find/parse HID_ID");
-	return 0;
-}
-
-/* return non-zero if successfully parsed */
-static int parse_hid_vid_pid_from_uevent_path(const char *uevent_path, unsigned *bus_type, unsigned short *vendor_id, unsigned short *product_id)
-{
-	int handle;
-	ssize_t res;
-
-	handle = open(uevent_path, O_RDONLY | O_CLOEXEC);
-	if (handle < 0) {
-		register_global_error_format("open failed (%s): %s", uevent_path, strerror(errno));
-		return 0;
-	}
-
-	char buf[1024];
-	res = read(handle, buf, sizeof(buf));
-	close(handle);
-
-	if (res < 0) {
-		register_global_error_format("read failed (%s): %s", uevent_path, strerror(errno));
-		return 0;
-	}
-
-	buf[res] = '\0';
-	return parse_hid_vid_pid_from_uevent(buf, bus_type, vendor_id, product_id);
-}
-
-/* return non-zero if successfully read/parsed */
-static int parse_hid_vid_pid_from_sysfs(const char *sysfs_path, unsigned *bus_type, unsigned short *vendor_id, unsigned short *product_id)
-{
-	int res = 0;
-	/* Construct <sysfs_path>/device/uevent */
-	size_t uevent_path_len = strlen(sysfs_path) + 14 + 1;
-	char* uevent_path = (char*) calloc(1, uevent_path_len);
-	snprintf(uevent_path, uevent_path_len, "%s/device/uevent", sysfs_path);
-
-	res = parse_hid_vid_pid_from_uevent_path(uevent_path, bus_type, vendor_id, product_id);
-	free(uevent_path);
-
-	return res;
-}
-
 /*
  * The caller is responsible for free()ing the (newly-allocated) character
  * strings pointed to by serial_number_utf8 and product_name_utf8 after use.
@@ -543,45 +459,105 @@ next_line:
 }
 
 
-static struct hid_device_info * create_device_info_for_device(struct udev_device *raw_dev)
+/* Matches all the devices */
+static const struct hid_enum_filter enum_filter_all;
+
+static int usage_matches_filter(const struct hid_enum_filter *filter, unsigned short usage_page, unsigned short usage)
+{
+	return (filter->usage_page == 0 || filter->usage_page == usage_page)
+	    && (filter->usage == 0 || filter->usage == usage);
+}
+
+static int serial_number_matches_filter(const struct hid_enum_filter *filter, const wchar_t *serial_number)
+{
+	if (!filter->serial_number_prefix)
+		return 1;
+	return serial_number
+	    && wcsncmp(serial_number, filter->serial_number_prefix, wcslen(filter->serial_number_prefix)) == 0;
+}
+
+/* Non-zero if a record matches all the criteria of the filter */
+static int device_info_matches_filter(const struct hid_enum_filter *filter, const struct hid_device_info *info)
+{
+	return (filter->vendor_id == 0 || filter->vendor_id == info->vendor_id)
+	    && (filter->product_id == 0 || filter->product_id == info->product_id)
+	    && (filter->bus_type == HID_API_BUS_UNKNOWN || filter->bus_type == info->bus_type)
+	    && (!(filter->flags & HID_API_ENUM_MATCH_INTERFACE) || filter->interface_number == info->interface_number)
+	    && usage_matches_filter(filter, info->usage_page, info->usage)
+	    && serial_number_matches_filter(filter, info->serial_number);
+}
+
+static struct hid_device_info *copy_device_info(const struct hid_device_info *info)
+{
+	struct hid_device_info *copy = (struct hid_device_info*) calloc(1, sizeof(*copy));
+	if (!copy)
+		return NULL;
+
+	*copy = *info;
+	copy->next = NULL;
+	copy->path = strdup(info->path);
+	copy->serial_number = info->serial_number? wcsdup(info->serial_number): NULL;
+	copy->manufacturer_string = info->manufacturer_string? wcsdup(info->manufacturer_string): NULL;
+	copy->product_string = info->product_string? wcsdup(info->product_string): NULL;
+
+	if (!copy->path
+	 || (info->serial_number && !copy->serial_number)
+	 || (info->manufacturer_string && !copy->manufacturer_string)
+	 || (info->product_string && !copy->product_string)) {
+		hidapi_free_device_info_list(copy);
+		return NULL;
+	}
+
+	return copy;
+}
+
+/* Creates the records of a hidraw device matching the filter,
+   from its sysfs directory (e.g. /sys/class/hidraw/hidraw0).
+   The criteria are checked from the cheapest (the uevent of the
+   HID device) to the most expensive (the report descriptor), so that
+   the other devices are rejected before reading more of them. */
+static struct hid_device_info * create_device_info_for_device(int sysfs_dirfd, const struct hid_enum_filter *filter)
 {
 	struct hid_device_info *root = NULL;
 	struct hid_device_info *cur_dev = NULL;
 
-	const char *sysfs_path;
-	const char *dev_path;
-	const char *str;
-	struct udev_device *hid_dev; /* The device's HID udev node. */
-	struct udev_device *usb_dev; /* The device's USB udev node. */
-	struct udev_device *intf_dev; /* The device's interface (in the USB sense). */
+	char dev_path[64];
+	const char *dev_name;
+	size_t dev_name_len = 0;
+	char *str;
+	char *uevent;
+	int hid_dirfd; /* The device's HID sysfs directory. */
+	int usb_dirfd = -1; /* The device's USB sysfs directory. */
+	int intf_dirfd; /* The device's interface (in the USB sense). */
 	unsigned short dev_vid;
 	unsigned short dev_pid;
 	char *serial_number_utf8 = NULL;
 	char *product_name_utf8 = NULL;
+	wchar_t *serial_number = NULL;
 	unsigned bus_type;
+	hid_bus_type dev_bus_type;
+	int interface_number = -1;
+	int skip_strings = filter->flags & HID_API_ENUM_SKIP_STRINGS;
+	int filter_on_usage = filter->usage_page != 0 || filter->usage != 0;
+	int have_usage = 0;
 	int result;
 	struct hidraw_report_descriptor report_desc;
 
-	sysfs_path = udev_device_get_syspath(raw_dev);
-	dev_path = udev_device_get_devnode(raw_dev);
-
-	hid_dev = udev_device_get_parent_with_subsystem_devtype(
-		raw_dev,
-		"hid",
-		NULL);
-
-	if (!hid_dev) {
+	hid_dirfd = openat(sysfs_dirfd, "device", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (hid_dirfd < 0) {
 		/* Unable to find parent hid device. */
-		goto end;
+		return NULL;
 	}
 
-	result = parse_uevent_info(
-		udev_device_get_sysattr_value(hid_dev, "uevent"),
+	uevent = read_sysfs_attribute(hid_dirfd, "uevent");
+	result = uevent && parse_uevent_info(
+		uevent,
 		&bus_type,
 		&dev_vid,
 		&dev_pid,
 		&serial_number_utf8,
 		&product_name_utf8);
+	free(uevent);
 
 	if (!result) {
 		/* parse_uevent_info() failed for at least one field. */
@@ -590,16 +566,76 @@ static struct hid_device_info * create_device_info_for_device(struct udev_device
 
 	/* Filter out unhandled devices right away */
 	switch (bus_type) {
+		case BUS_USB:
+			dev_bus_type = HID_API_BUS_USB;
+			break;
 		case BUS_BLUETOOTH:
+			dev_bus_type = HID_API_BUS_BLUETOOTH;
+			break;
 		case BUS_I2C:
-		case BUS_USB:
+			dev_bus_type = HID_API_BUS_I2C;
+			break;
 		case BUS_SPI:
+			dev_bus_type = HID_API_BUS_SPI;
 			break;
 
 		default:
 			goto end;
 	}
 
+	if ((filter->vendor_id != 0 && filter->vendor_id != dev_vid)
+	 || (filter->product_id != 0 && filter->product_id != dev_pid)
+	 || (filter->bus_type != HID_API_BUS_UNKNOWN && filter->bus_type != dev_bus_type))
+		goto end;
+
+	/* Serial Number */
+	if (!skip_strings || filter->serial_number_prefix) {
+		serial_number = hidapi_utf8_to_wchar(serial_number_utf8);
+		if (!serial_number_matches_filter(filter, serial_number))
+			goto end;
+	}
+
+	if (dev_bus_type == HID_API_BUS_USB) {
+		/* The HID device directory contains information about
+			the HID device. In order to get information about the
+			USB device, get the parent device with the devtype
+			"usb_device". This will be several levels up the tree,
+			but the function will find it. */
+		usb_dirfd = open_sysfs_parent_with_devtype(hid_dirfd, "usb_device");
+
+		if (usb_dirfd >= 0) {
+			/* Get a handle to the interface's sysfs directory. */
+			intf_dirfd = open_sysfs_parent_with_devtype(hid_dirfd, "usb_interface");
+			if (intf_dirfd >= 0) {
+				str = read_sysfs_attribute(intf_dirfd, "bInterfaceNumber");
+				interface_number = (str)? strtol(str, NULL, 16): -1;
+				free(str);
+				close(intf_dirfd);
+			}
+		}
+		else {
+			/* uhid USB devices
+			 * Since this is a virtual hid interface, no USB information will
+			 * be available. */
+			dev_bus_type = HID_API_BUS_UNKNOWN;
+			if (filter->bus_type != HID_API_BUS_UNKNOWN)
+				goto end;
+		}
+	}
+
+	if ((filter->flags & HID_API_ENUM_MATCH_INTERFACE) && filter->interface_number != interface_number)
+		goto end;
+
+	/* The device node is named after the kernel device (DEVNAME=hidraw0) */
+	uevent = read_sysfs_attribute(sysfs_dirfd, "uevent");
+	dev_name = uevent? find_uevent_value(uevent, "DEVNAME", &dev_name_len): NULL;
+	if (!dev_name || dev_name_len == 0 || dev_name_len >= sizeof(dev_path) - 5) {
+		free(uevent);
+		goto end;
+	}
+	snprintf(dev_path, sizeof(dev_path), "/dev/%.*s", (int) dev_name_len, dev_name);
+	free(uevent);
+
 	/* Create the record. */
 	root = (struct hid_device_info*) calloc(1, sizeof(struct hid_device_info));
 	if (!root)
@@ -609,146 +645,97 @@ static struct hid_device_info * create_device_info_for_device(struct udev_device
 
 	/* Fill out the record */
 	cur_dev->next = NULL;
-	cur_dev->path = dev_path? strdup(dev_path): NULL;
+	cur_dev->path = strdup(dev_path);
 
 	/* VID/PID */
 	cur_dev->vendor_id = dev_vid;
 	cur_dev->product_id = dev_pid;
 
 	/* Serial Number */
-	cur_dev->serial_number = utf8_to_wchar_t(serial_number_utf8);
+	cur_dev->serial_number = serial_number;
+	serial_number = NULL;
 
 	/* Release Number */
 	cur_dev->release_number = 0x0;
 
 	/* Interface Number */
-	cur_dev->interface_number = -1;
-
-	switch (bus_type) {
-		case BUS_USB:
-			/* The device pointed to by raw_dev contains information about
-				the hidraw device. In order to get information about the
-				USB device, get the parent device with the
-				subsystem/devtype pair of "usb"/"usb_device". This will
-				be several levels up the tree, but the function will find
-				it. */
-			usb_dev = udev_device_get_parent_with_subsystem_devtype(
-					raw_dev,
-					"usb",
-					"usb_device");
-
-			/* uhid USB devices
-			 * Since this is a virtual hid interface, no USB information will
-			 * be available. */
-			if (!usb_dev) {
-				/* Manufacturer and Product strings */
-				cur_dev->manufacturer_string = wcsdup(L"");
-				cur_dev->product_string = utf8_to_wchar_t(product_name_utf8);
-				break;
-			}
-
-			cur_dev->manufacturer_string = copy_udev_string(usb_dev, "manufacturer");
-			cur_dev->product_string = copy_udev_string(usb_dev, "product");
-
-			cur_dev->bus_type = HID_API_BUS_USB;
-
-			str = udev_device_get_sysattr_value(usb_dev, "bcdDevice");
-			cur_dev->release_number = (str)? strtol(str, NULL, 16): 0x0;
-
-			/* Get a handle to the interface's udev node. */
-			intf_dev = udev_device_get_parent_with_subsystem_devtype(
-					raw_dev,
-					"usb",
-					"usb_interface");
-			if (intf_dev) {
-				str = udev_device_get_sysattr_value(intf_dev, "bInterfaceNumber");
-				cur_dev->interface_number = (str)? strtol(str, NULL, 16): -1;
-			}
+	cur_dev->interface_number = interface_number;
 
-			break;
-
-		case BUS_BLUETOOTH:
-			cur_dev->manufacturer_string = wcsdup(L"");
-			cur_dev->product_string = utf8_to_wchar_t(product_name_utf8);
-
-			cur_dev->bus_type = HID_API_BUS_BLUETOOTH;
-
-			break;
-		case BUS_I2C:
-			cur_dev->manufacturer_string = wcsdup(L"");
-			cur_dev->product_string = utf8_to_wchar_t(product_name_utf8);
-
-			cur_dev->bus_type = HID_API_BUS_I2C;
+	cur_dev->bus_type = dev_bus_type;
 
-			break;
-
-		case BUS_SPI:
-			cur_dev->manufacturer_string = wcsdup(L"");
-			cur_dev->product_string = utf8_to_wchar_t(product_name_utf8);
-
-			cur_dev->bus_type = HID_API_BUS_SPI;
-
-			break;
+	if (usb_dirfd >= 0) {
+		if (!skip_strings) {
+			cur_dev->manufacturer_string = copy_sysfs_string(usb_dirfd, "manufacturer");
+			cur_dev->product_string = copy_sysfs_string(usb_dirfd, "product");
+		}
 
-		default:
-			/* Unknown device type - this should never happen, as we
-			 * check for USB and Bluetooth devices above */
-			break;
+		str = read_sysfs_attribute(usb_dirfd, "bcdDevice");
+		cur_dev->release_number = (str)? strtol(str, NULL, 16): 0x0;
+		free(str);
+	}
+	else if (!skip_strings) {
+		/* Manufacturer and Product strings */
+		cur_dev->manufacturer_string = wcsdup(L"");
+		cur_dev->product_string = hidapi_utf8_to_wchar(product_name_utf8);
 	}
 
 	/* Usage Page and Usage */
-	result = get_hid_report_descriptor_from_sysfs(sysfs_path, &report_desc);
-	if (result >= 0) {
-		unsigned short page = 0, usage = 0;
-		unsigned int pos = 0;
-		/*
-		 * Parse the first usage and usage page
-		 * out of the report descriptor.
-		 */
-		if (!get_next_hid_usage(report_desc.value, report_desc.size, &pos, &page, &usage)) {
-			cur_dev->usage_page = page;
-			cur_dev->usage = usage;
-		}
-
-		/*
-		 * Parse any additional usage and usage pages
-		 * out of the report descriptor.
-		 */
-		while (!get_next_hid_usage(report_desc.value, report_desc.size, &pos, &page, &usage)) {
-			/* Create new record for additional usage pairs */
-			struct hid_device_info *tmp = (struct hid_device_info*) calloc(1, sizeof(struct hid_device_info));
-			struct hid_device_info *prev_dev = cur_dev;
+	if (!(filter->flags & HID_API_ENUM_SKIP_USAGES) || filter_on_usage) {
+		result = get_hid_report_descriptor(hid_dirfd, "report_descriptor", &report_desc);
+		if (result >= 0) {
+			unsigned short page = 0, usage = 0;
+			unsigned int pos = 0;
+
+			/*
+			 * Parse the usage and usage pages out of the report
+			 * descriptor: the first matching pair completes the
+			 * record, a new record is created for each additional one.
+			 */
+			while (!hidapi_get_next_usage(report_desc.value, report_desc.size, &pos, &page, &usage)) {
+				struct hid_device_info *tmp;
+
+				if (!usage_matches_filter(filter, page, usage))
+					continue;
+
+				if (!have_usage) {
+					root->usage_page = page;
+					root->usage = usage;
+					have_usage = 1;
+					continue;
+				}
 
-			if (!tmp)
-				continue;
-			cur_dev->next = tmp;
-			cur_dev = tmp;
+				/* Create new record for additional usage pairs */
+				tmp = copy_device_info(root);
+				if (!tmp)
+					continue;
+				tmp->usage_page = page;
+				tmp->usage = usage;
 
-			/* Update fields */
-			cur_dev->path = dev_path? strdup(dev_path): NULL;
-			cur_dev->vendor_id = dev_vid;
-			cur_dev->product_id = dev_pid;
-			cur_dev->serial_number = prev_dev->serial_number? wcsdup(prev_dev->serial_number): NULL;
-			cur_dev->release_number = prev_dev->release_number;
-			cur_dev->interface_number = prev_dev->interface_number;
-			cur_dev->manufacturer_string = prev_dev->manufacturer_string? wcsdup(prev_dev->manufacturer_string): NULL;
-			cur_dev->product_string = prev_dev->product_string? wcsdup(prev_dev->product_string): NULL;
-			cur_dev->usage_page = page;
-			cur_dev->usage = usage;
-			cur_dev->bus_type = prev_dev->bus_type;
+				cur_dev->next = tmp;
+				cur_dev = tmp;
+			}
 		}
 	}
 
+	if (filter_on_usage && !have_usage) {
+		hidapi_free_device_info_list(root);
+		root = NULL;
+	}
+
 end:
+	free(serial_number);
 	free(serial_number_utf8);
 	free(product_name_utf8);
+	if (usb_dirfd >= 0)
+		close(usb_dirfd);
+	close(hid_dirfd);
 
 	return root;
 }
 
 static struct hid_device_info * create_device_info_for_hid_device(hid_device *dev) {
-	struct udev *udev;
-	struct udev_device *udev_dev;
+	char sysfs_path[64];
+	int sysfs_dirfd;
 	struct stat s;
 	int ret = -1;
 	struct hid_device_info *root = NULL;
@@ -762,17 +749,12 @@ static struct hid_device_info * create_device_info_for_hid_device(hid_device *de
 		return NULL;
 	}
 
-	/* Create the udev object */
-	udev = udev_new();
-	if (!udev) {
-		register_device_error(dev, "Couldn't create udev context");
-		return NULL;
-	}
-
-	/* Open a udev device from the dev_t. 'c' means character device. */
-	udev_dev = udev_device_new_from_devnum(udev, 'c', s.st_rdev);
-	if (udev_dev) {
-		root = create_device_info_for_device(udev_dev);
+	/* The sysfs directory of the character device, from the dev_t */
+	snprintf(sysfs_path, sizeof(sysfs_path), "/sys/dev/char/%u:%u", major(s.st_rdev), minor(s.st_rdev));
+	sysfs_dirfd = open(sysfs_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (sysfs_dirfd >= 0) {
+		root = create_device_info_for_device(sysfs_dirfd, &enum_filter_all);
+		close(sysfs_dirfd);
 	}
 
 	if (!root) {
@@ -780,9 +762,6 @@ static struct hid_device_info * create_device_info_for_hid_device(hid_device *de
 		register_device_error(dev, "Couldn't create hid_device_info");
 	}
 
-	udev_device_unref(udev_dev);
-	udev_unref(udev);
-
 	return root;
 }
 
@@ -796,293 +775,2206 @@ HID_API_EXPORT const char* HID_API_CALL hid_version_str()
 	return HID_API_VERSION_STR;
 }
 
-int HID_API_EXPORT hid_init(void)
+#ifdef HIDAPI_USE_IO_URING
+/*
+ * io_uring engine.
+ *
+ * A single io_uring instance, serviced by a single thread, keeps a read
+ * outstanding on the hidraw handle of every opened device.
+ * Multishot reads (Linux >= 6.7) are used when available, a single shot
+ * read which is re-armed after each completion otherwise.
+ * The reports are read into buffers provided to the kernel through a
+ * registered buffer ring per device (Linux >= 5.19), so no system call is
+ * needed to queue a buffer, and the completions of all devices are
+ * collected in batches by the engine thread.
+ *
+ * If the engine cannot be set up, all devices use the poll()/read() path.
+ */
+
+/* user_data of requests which are not device reads */
+#define HIDRAW_URING_TAG_IGNORE 0
+#define HIDRAW_URING_TAG_STOP 1
+
+static struct {
+	pthread_mutex_t mutex; /* Protects everything below and the submission queue */
+	int state; /* 0 - not started, 1 - running, -1 - unavailable */
+	int multishot;
+	pthread_t thread;
+	struct io_uring ring;
+	unsigned char bgids[HIDRAW_URING_MAX_DEVICES / 8];
+} uring_engine = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+
+/* uring_engine.mutex must be locked. */
+static struct io_uring_sqe *uring_get_sqe(void)
 {
-	const char *locale;
+	struct io_uring_sqe *sqe = io_uring_get_sqe(&uring_engine.ring);
+	if (!sqe) {
+		/* The submission queue is full, flush it and try again */
+		io_uring_submit(&uring_engine.ring);
+		sqe = io_uring_get_sqe(&uring_engine.ring);
+	}
+	return sqe;
+}
 
-	/* indicate no error */
-	register_global_error(NULL);
+/* Queue a read request for the device, without submitting it.
+   dev->uring_mutex and uring_engine.mutex must be locked. */
+static int uring_prep_read(hid_device *dev)
+{
+	struct io_uring_sqe *sqe = uring_get_sqe();
+	if (!sqe)
+		return -1;
 
-	/* Set the locale if it's not set. */
-	locale = setlocale(LC_CTYPE, NULL);
-	if (!locale)
-		setlocale(LC_CTYPE, "");
+	if (uring_engine.multishot) {
+		io_uring_prep_read_multishot(sqe, dev->device_handle, 0, (uint64_t) -1, dev->uring_bgid);
+	}
+	else {
+		io_uring_prep_read(sqe, dev->device_handle, NULL, HIDRAW_URING_BUFFER_SIZE, (uint64_t) -1);
+		sqe->flags |= IOSQE_BUFFER_SELECT;
+		sqe->buf_group = (__u16) dev->uring_bgid;
+	}
+	io_uring_sqe_set_data64(sqe, (uint64_t) (uintptr_t) dev);
 
+	dev->uring_armed = 1;
 	return 0;
 }
 
-int HID_API_EXPORT hid_exit(void)
+/* Submit a read request for the device.
+   dev->uring_mutex must be locked. */
+static void uring_arm_read(hid_device *dev)
 {
-	/* Free global error message */
-	register_global_error(NULL);
+	pthread_mutex_lock(&uring_engine.mutex);
+	if (uring_prep_read(dev) == 0)
+		io_uring_submit(&uring_engine.ring);
+	pthread_mutex_unlock(&uring_engine.mutex);
+}
 
-	return 0;
+/* Give a buffer back to the kernel.
+   dev->uring_mutex must be locked. */
+static void uring_return_buffer(hid_device *dev, unsigned short bid)
+{
+	io_uring_buf_ring_add(dev->uring_buf_ring,
+		dev->uring_buffers + (size_t) bid * HIDRAW_URING_BUFFER_SIZE,
+		HIDRAW_URING_BUFFER_SIZE, bid,
+		io_uring_buf_ring_mask(HIDRAW_URING_BUFFERS), 0);
+	io_uring_buf_ring_advance(dev->uring_buf_ring, 1);
 }
 
-struct hid_device_info  HID_API_EXPORT *hid_enumerate(unsigned short vendor_id, unsigned short product_id)
+/* Called by the engine thread for each completed read.
+   Returns 1 if a new request was queued and has to be submitted. */
+static int uring_handle_completion(hid_device *dev, const struct io_uring_cqe *cqe)
 {
-	struct udev *udev;
-	struct udev_enumerate *enumerate;
-	struct udev_list_entry *devices, *dev_list_entry;
+	int queued = 0;
+
+	pthread_mutex_lock(&dev->uring_mutex);
+
+	if (cqe->res > 0 && (cqe->flags & IORING_CQE_F_BUFFER)) {
+		unsigned int tail = (dev->uring_ready_head + dev->uring_ready_count) % HIDRAW_URING_BUFFERS;
+		/* There is never more completed reports than buffers */
+		dev->uring_ready_bid[tail] = (unsigned short) (cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+		dev->uring_ready_len[tail] = (unsigned int) cqe->res;
+		if (dev->uring_ready_count++ == 0)
+			eventfd_write(dev->uring_event_fd, 1);
+		pthread_cond_broadcast(&dev->uring_condition);
+	}
+	else if (cqe->res == -ENOBUFS) {
+		/* Every buffer holds a report which wasn't read yet. The
+		   kernel keeps queueing the reports meanwhile, and the
+		   read is re-armed as soon as a buffer is given back. */
+	}
+	else if (cqe->res != -ECANCELED) {
+		/* Reading from hidraw fails with EIO once the device is
+		   disconnected. A zero-length read is not expected either. */
+		dev->uring_error = (cqe->res < 0)? -cqe->res: EIO;
+		eventfd_write(dev->uring_event_fd, 1);
+		pthread_cond_broadcast(&dev->uring_condition);
+	}
 
-	struct hid_device_info *root = NULL; /* return object */
+	if (!(cqe->flags & IORING_CQE_F_MORE)) {
+		/* This request is finished */
+		dev->uring_armed = 0;
+
+		if (!dev->uring_closing && !dev->uring_error
+		    && dev->uring_ready_count < HIDRAW_URING_BUFFERS) {
+			pthread_mutex_lock(&uring_engine.mutex);
+			queued = (uring_prep_read(dev) == 0);
+			pthread_mutex_unlock(&uring_engine.mutex);
+		}
+
+		/* hid_close() may be waiting for the request to finish */
+		pthread_cond_broadcast(&dev->uring_condition);
+	}
+
+	pthread_mutex_unlock(&dev->uring_mutex);
+
+	return queued;
+}
+
+static void *uring_engine_thread(void *param)
+{
+	(void) param;
+
+	for (;;) {
+		struct io_uring_cqe *cqe;
+		unsigned head;
+		unsigned count = 0;
+		int queued = 0;
+		int stop = 0;
+
+		int res = io_uring_wait_cqe(&uring_engine.ring, &cqe);
+		if (res == -EINTR)
+			continue;
+		if (res < 0)
+			break;
+
+		/* Handle every completion available, then submit
+		   all the re-armed reads with a single system call. */
+		io_uring_for_each_cqe(&uring_engine.ring, head, cqe) {
+			uint64_t tag = io_uring_cqe_get_data64(cqe);
+			if (tag == HIDRAW_URING_TAG_STOP)
+				stop = 1;
+			else if (tag != HIDRAW_URING_TAG_IGNORE)
+				queued |= uring_handle_completion((hid_device *) (uintptr_t) tag, cqe);
+			count++;
+		}
+		io_uring_cq_advance(&uring_engine.ring, count);
+
+		if (queued) {
+			pthread_mutex_lock(&uring_engine.mutex);
+			io_uring_submit(&uring_engine.ring);
+			pthread_mutex_unlock(&uring_engine.mutex);
+		}
+
+		if (stop)
+			break;
+	}
+
+	return NULL;
+}
+
+/* uring_engine.mutex must be locked. Returns 0 if the engine is running. */
+static int uring_engine_start(void)
+{
+	struct io_uring_params params;
+	struct io_uring_probe *probe;
+
+	if (uring_engine.state != 0)
+		return (uring_engine.state > 0)? 0: -1;
+
+	/* Don't try again, unless hid_exit() is called */
+	uring_engine.state = -1;
+
+	memset(&params, 0, sizeof(params));
+	params.flags = IORING_SETUP_CQSIZE;
+	params.cq_entries = HIDRAW_URING_MAX_DEVICES * 4;
+	if (io_uring_queue_init_params(HIDRAW_URING_QUEUE_DEPTH, &uring_engine.ring, &params) < 0)
+		return -1;
+
+	probe = io_uring_get_probe_ring(&uring_engine.ring);
+	uring_engine.multishot = probe && io_uring_opcode_supported(probe, IORING_OP_READ_MULTISHOT);
+	if (probe)
+		io_uring_free_probe(probe);
+
+	memset(uring_engine.bgids, 0, sizeof(uring_engine.bgids));
+
+	if (pthread_create(&uring_engine.thread, NULL, uring_engine_thread, NULL) != 0) {
+		io_uring_queue_exit(&uring_engine.ring);
+		return -1;
+	}
+
+	uring_engine.state = 1;
+	return 0;
+}
+
+static void uring_engine_stop(void)
+{
+	pthread_mutex_lock(&uring_engine.mutex);
+
+	if (uring_engine.state > 0) {
+		struct io_uring_sqe *sqe = uring_get_sqe();
+		if (sqe) {
+			io_uring_prep_nop(sqe);
+			io_uring_sqe_set_data64(sqe, HIDRAW_URING_TAG_STOP);
+			io_uring_submit(&uring_engine.ring);
+
+			pthread_mutex_unlock(&uring_engine.mutex);
+			pthread_join(uring_engine.thread, NULL);
+			pthread_mutex_lock(&uring_engine.mutex);
+
+			io_uring_queue_exit(&uring_engine.ring);
+			uring_engine.state = 0;
+		}
+	}
+	else {
+		/* Allow another attempt after hid_init() */
+		uring_engine.state = 0;
+	}
+
+	pthread_mutex_unlock(&uring_engine.mutex);
+}
+
+/* Start reading the device through the engine.
+   If this fails, the device keeps using the poll()/read() path. */
+static void uring_attach_device(hid_device *dev)
+{
+	int bgid = -1;
+	int flags;
+	int res;
+	unsigned short bid;
+
+	pthread_mutex_lock(&uring_engine.mutex);
+	if (uring_engine_start() == 0) {
+		for (int i = 0; i < HIDRAW_URING_MAX_DEVICES; i++) {
+			if (!(uring_engine.bgids[i / 8] & (1 << (i % 8)))) {
+				uring_engine.bgids[i / 8] |= (unsigned char) (1 << (i % 8));
+				bgid = i;
+				break;
+			}
+		}
+	}
+	pthread_mutex_unlock(&uring_engine.mutex);
+
+	if (bgid < 0)
+		return;
+
+	/* The engine only ever issues reads that don't block */
+	flags = fcntl(dev->device_handle, F_GETFL);
+	if (flags == -1 || fcntl(dev->device_handle, F_SETFL, flags | O_NONBLOCK) == -1)
+		goto err;
+
+	dev->uring_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (dev->uring_event_fd == -1)
+		goto err_flags;
+
+	dev->uring_buffers = (unsigned char *) malloc((size_t) HIDRAW_URING_BUFFERS * HIDRAW_URING_BUFFER_SIZE);
+	if (!dev->uring_buffers)
+		goto err_event;
+
+	dev->uring_buf_ring = io_uring_setup_buf_ring(&uring_engine.ring, HIDRAW_URING_BUFFERS, bgid, 0, &res);
+	if (!dev->uring_buf_ring)
+		goto err_event;
+
+	pthread_mutex_init(&dev->uring_mutex, NULL);
+	pthread_cond_init(&dev->uring_condition, NULL);
+	dev->uring_bgid = bgid;
+
+	pthread_mutex_lock(&dev->uring_mutex);
+	for (bid = 0; bid < HIDRAW_URING_BUFFERS; bid++)
+		uring_return_buffer(dev, bid);
+	uring_arm_read(dev);
+	pthread_mutex_unlock(&dev->uring_mutex);
+	return;
+
+err_event:
+	close(dev->uring_event_fd);
+err_flags:
+	fcntl(dev->device_handle, F_SETFL, flags);
+err:
+	free(dev->uring_buffers);
+	dev->uring_buffers = NULL;
+	pthread_mutex_lock(&uring_engine.mutex);
+	uring_engine.bgids[bgid / 8] &= (unsigned char) ~(1 << (bgid % 8));
+	pthread_mutex_unlock(&uring_engine.mutex);
+}
+
+static void uring_detach_device(hid_device *dev)
+{
+	int bgid = dev->uring_bgid;
+
+	pthread_mutex_lock(&dev->uring_mutex);
+	dev->uring_closing = 1;
+	if (dev->uring_armed) {
+		struct io_uring_sqe *sqe;
+
+		pthread_mutex_lock(&uring_engine.mutex);
+		sqe = uring_get_sqe();
+		if (sqe) {
+			io_uring_prep_cancel64(sqe, (uint64_t) (uintptr_t) dev, 0);
+			io_uring_sqe_set_data64(sqe, HIDRAW_URING_TAG_IGNORE);
+			io_uring_submit(&uring_engine.ring);
+		}
+		pthread_mutex_unlock(&uring_engine.mutex);
+
+		/* The engine thread must be done with this device before it's freed */
+		while (dev->uring_armed)
+			pthread_cond_wait(&dev->uring_condition, &dev->uring_mutex);
+	}
+	pthread_mutex_unlock(&dev->uring_mutex);
+
+	pthread_mutex_lock(&uring_engine.mutex);
+	io_uring_free_buf_ring(&uring_engine.ring, dev->uring_buf_ring, HIDRAW_URING_BUFFERS, bgid);
+	uring_engine.bgids[bgid / 8] &= (unsigned char) ~(1 << (bgid % 8));
+	pthread_mutex_unlock(&uring_engine.mutex);
+
+	free(dev->uring_buffers);
+	close(dev->uring_event_fd);
+	pthread_cond_destroy(&dev->uring_condition);
+	pthread_mutex_destroy(&dev->uring_mutex);
+	dev->uring_bgid = -1;
+}
+
+/* Read up to max_reports completed reports of a device served by the engine,
+   waiting for the first one the same way as hid_read_timeout(). */
+static int uring_read_reports(hid_device *dev, unsigned char *data, size_t stride, size_t max_reports, size_t *lengths, int milliseconds)
+{
+	int res = 0;
+	struct timespec ts;
+	size_t count = 0;
+
+	if (milliseconds > 0) {
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_sec += milliseconds / 1000;
+		ts.tv_nsec += (milliseconds % 1000) * 1000000;
+		if (ts.tv_nsec >= 1000000000L) {
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000L;
+		}
+	}
+
+	pthread_mutex_lock(&dev->uring_mutex);
+
+	while (dev->uring_ready_count == 0 && !dev->uring_error && milliseconds != 0) {
+		if (milliseconds > 0)
+			res = pthread_cond_timedwait(&dev->uring_condition, &dev->uring_mutex, &ts);
+		else
+			res = pthread_cond_wait(&dev->uring_condition, &dev->uring_mutex);
+		if (res != 0)
+			break;
+	}
+
+	while (dev->uring_ready_count > 0 && count < max_reports) {
+		unsigned short bid = dev->uring_ready_bid[dev->uring_ready_head];
+		size_t len = dev->uring_ready_len[dev->uring_ready_head];
+		if (len > stride)
+			len = stride;
+
+		memcpy(data + count * stride, dev->uring_buffers + (size_t) bid * HIDRAW_URING_BUFFER_SIZE, len);
+		lengths[count++] = len;
+
+		dev->uring_ready_head = (dev->uring_ready_head + 1) % HIDRAW_URING_BUFFERS;
+		dev->uring_ready_count--;
+		uring_return_buffer(dev, bid);
+	}
+
+	if (dev->uring_ready_count == 0 && !dev->uring_error) {
+		eventfd_t value;
+		eventfd_read(dev->uring_event_fd, &value);
+	}
+
+	if (count > 0) {
+		res = (int) count;
+		/* The read request ended because all the buffers were in use */
+		if (!dev->uring_armed && !dev->uring_error && !dev->uring_closing)
+			uring_arm_read(dev);
+	}
+	else if (dev->uring_error) {
+		register_device_error_format(dev, "hid_read_timeout: %s (device disconnected?)", strerror(dev->uring_error));
+		res = -1;
+	}
+	else if (res == ETIMEDOUT || milliseconds == 0) {
+		res = 0;
+	}
+	else {
+		register_device_error(dev, strerror(res));
+		res = -1;
+	}
+
+	pthread_mutex_unlock(&dev->uring_mutex);
+
+	return res;
+}
+#endif /* HIDAPI_USE_IO_URING */
+
+/* The file descriptor which becomes readable when Input reports
+   of the device are available to be read. */
+static int get_input_fd(hid_device *dev)
+{
+#ifdef HIDAPI_USE_IO_URING
+	if (dev->uring_bgid >= 0)
+		return dev->uring_event_fd;
+#endif
+	return dev->device_handle;
+}
+
+/* A registered hotplug callback, see hid_hotplug_register_callback() */
+struct hid_hotplug_callback {
+	hid_hotplug_callback_handle handle;
+	unsigned short vendor_id;
+	unsigned short product_id;
+	int events;
+	hid_hotplug_callback_fn callback; /* NULL once deregistered during a dispatch */
+	void *user_data;
+	struct hid_hotplug_callback *next;
+};
+
+/* The device monitor and the thread reading from it, started with the
+   first hotplug callback and stopped by hid_exit().
+   The monitor is a udev monitor, which reports the devices once the udev
+   rules (e.g. the permissions of the device node) are applied. Without
+   libudev, the kernel uevents are read directly instead. */
+static struct {
+	pthread_once_t once;
+	/* Recursive, so that the callbacks may (de)register callbacks.
+	   Protects everything below. */
+	pthread_mutex_t mutex;
+	int running;
+	pthread_t thread;
+	int wakeup_fd;
+#ifdef HIDAPI_NO_LIBUDEV
+	int monitor_fd; /* NETLINK_KOBJECT_UEVENT socket */
+#else
+	struct udev *udev;
+	struct udev_monitor *monitor;
+#endif
+	/* The devices connected right now */
+	struct hid_device_info *devices;
+	struct hid_hotplug_callback *callbacks;
+	hid_hotplug_callback_handle next_handle;
+	int dispatching;
+} hid_hotplug = {
+	.once = PTHREAD_ONCE_INIT,
+	.wakeup_fd = -1,
+#ifdef HIDAPI_NO_LIBUDEV
+	.monitor_fd = -1,
+#endif
+	.next_handle = 1,
+};
+
+/* Whether hid_enumerate() lists the devices known to the hotplug monitor,
+   see hid_set_enumeration_cache() */
+static int use_enumeration_cache = 0;
+
+static void hotplug_init_mutex(void)
+{
+	pthread_mutexattr_t attr;
+
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&hid_hotplug.mutex, &attr);
+	pthread_mutexattr_destroy(&attr);
+}
+
+/* hid_hotplug.mutex must be locked */
+static void hotplug_remove_deregistered(void)
+{
+	struct hid_hotplug_callback **cur = &hid_hotplug.callbacks;
+
+	while (*cur) {
+		struct hid_hotplug_callback *hotplug_cb = *cur;
+		if (hotplug_cb->callback) {
+			cur = &hotplug_cb->next;
+		}
+		else {
+			*cur = hotplug_cb->next;
+			free(hotplug_cb);
+		}
+	}
+}
+
+/* Calls the matching callbacks (or only the given one) for each of the devices.
+   hid_hotplug.mutex must be locked. */
+static void hotplug_dispatch(struct hid_device_info *devs, hid_hotplug_event event, struct hid_hotplug_callback *only)
+{
+	struct hid_device_info *info;
+
+	hid_hotplug.dispatching++;
+
+	for (info = devs; info; ) {
+		struct hid_device_info *next = info->next;
+		struct hid_hotplug_callback *hotplug_cb;
+
+		/* Each device is reported on its own */
+		info->next = NULL;
+
+		for (hotplug_cb = only? only: hid_hotplug.callbacks; hotplug_cb; hotplug_cb = only? NULL: hotplug_cb->next) {
+			if (!hotplug_cb->callback || !(hotplug_cb->events & event))
+				continue;
+			if (hotplug_cb->vendor_id != 0 && hotplug_cb->vendor_id != info->vendor_id)
+				continue;
+			if (hotplug_cb->product_id != 0 && hotplug_cb->product_id != info->product_id)
+				continue;
+
+			if (hotplug_cb->callback(hotplug_cb->handle, info, event, hotplug_cb->user_data))
+				hotplug_cb->callback = NULL;
+		}
+
+		info->next = next;
+		info = next;
+	}
+
+	if (--hid_hotplug.dispatching == 0)
+		hotplug_remove_deregistered();
+}
+
+static void hotplug_device_arrived(int sysfs_dirfd)
+{
+	struct hid_device_info *devs;
+	struct hid_device_info *info;
+	struct hid_device_info **last;
+
+	/* Reading the device happens without the lock held */
+	devs = create_device_info_for_device(sysfs_dirfd, &enum_filter_all);
+	if (!devs)
+		return;
+
+	pthread_mutex_lock(&hid_hotplug.mutex);
+
+	/* Already known, from the enumeration at startup */
+	for (info = hid_hotplug.devices; info; info = info->next) {
+		if (strcmp(info->path, devs->path) == 0) {
+			pthread_mutex_unlock(&hid_hotplug.mutex);
+			hidapi_free_device_info_list(devs);
+			return;
+		}
+	}
+
+	hotplug_dispatch(devs, HID_API_HOTPLUG_EVENT_DEVICE_ARRIVED, NULL);
+
+	/* Keep the records for when the device leaves,
+	   after the ones of the devices known already */
+	for (last = &hid_hotplug.devices; *last; last = &(*last)->next)
+		;
+	*last = devs;
+
+	pthread_mutex_unlock(&hid_hotplug.mutex);
+}
+
+static void hotplug_device_left(const char *dev_path)
+{
+	struct hid_device_info *gone = NULL;
+	struct hid_device_info **cur;
+
+	if (!dev_path)
+		return;
+
+	pthread_mutex_lock(&hid_hotplug.mutex);
+
+	/* All the records (one per usage) of the device */
+	cur = &hid_hotplug.devices;
+	while (*cur) {
+		struct hid_device_info *info = *cur;
+		if (strcmp(info->path, dev_path) == 0) {
+			*cur = info->next;
+			info->next = gone;
+			gone = info;
+		}
+		else {
+			cur = &info->next;
+		}
+	}
+
+	if (gone)
+		hotplug_dispatch(gone, HID_API_HOTPLUG_EVENT_DEVICE_LEFT, NULL);
+
+	pthread_mutex_unlock(&hid_hotplug.mutex);
+
+	hidapi_free_device_info_list(gone);
+}
+
+#ifdef HIDAPI_NO_LIBUDEV
+
+/* hid_hotplug.mutex must be locked */
+static int hotplug_monitor_open(void)
+{
+	struct sockaddr_nl addr;
+
+	hid_hotplug.monitor_fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+	if (hid_hotplug.monitor_fd < 0) {
+		register_global_error_format("Couldn't create uevent socket: %s", strerror(errno));
+		return -1;
+	}
+
+	/* The kernel uevents */
+	memset(&addr, 0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+	addr.nl_groups = 1;
+	if (bind(hid_hotplug.monitor_fd, (struct sockaddr*) &addr, sizeof(addr)) < 0) {
+		register_global_error_format("Couldn't bind uevent socket: %s", strerror(errno));
+		close(hid_hotplug.monitor_fd);
+		hid_hotplug.monitor_fd = -1;
+		return -1;
+	}
+
+	return 0;
+}
+
+static int hotplug_monitor_fd(void)
+{
+	return hid_hotplug.monitor_fd;
+}
+
+/* Reads one uevent: "ACTION@DEVPATH" followed by "KEY=value" strings */
+static void hotplug_monitor_receive(void)
+{
+	char buf[8192];
+	struct sockaddr_nl addr;
+	struct iovec iov;
+	struct msghdr msg;
+	const char *action = NULL;
+	const char *devpath = NULL;
+	const char *devname = NULL;
+	const char *subsystem = NULL;
+	char *cur;
+	ssize_t len;
+
+	iov.iov_base = buf;
+	iov.iov_len = sizeof(buf) - 1;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_name = &addr;
+	msg.msg_namelen = sizeof(addr);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+
+	len = recvmsg(hid_hotplug.monitor_fd, &msg, 0);
+	/* Only the kernel is trusted */
+	if (len <= 0 || addr.nl_pid != 0)
+		return;
+	buf[len] = '\0';
+
+	for (cur = buf + strlen(buf) + 1; cur < buf + len; cur += strlen(cur) + 1) {
+		if (strncmp(cur, "ACTION=", 7) == 0)
+			action = cur + 7;
+		else if (strncmp(cur, "DEVPATH=", 8) == 0)
+			devpath = cur + 8;
+		else if (strncmp(cur, "DEVNAME=", 8) == 0)
+			devname = cur + 8;
+		else if (strncmp(cur, "SUBSYSTEM=", 10) == 0)
+			subsystem = cur + 10;
+	}
+
+	if (!action || !subsystem || strcmp(subsystem, "hidraw") != 0)
+		return;
+
+	if (strcmp(action, "add") == 0 && devpath) {
+		char sysfs_path[PATH_MAX];
+		int sysfs_dirfd;
+
+		snprintf(sysfs_path, sizeof(sysfs_path), "/sys%s", devpath);
+		sysfs_dirfd = open(sysfs_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		if (sysfs_dirfd >= 0) {
+			hotplug_device_arrived(sysfs_dirfd);
+			close(sysfs_dirfd);
+		}
+	}
+	else if (strcmp(action, "remove") == 0 && devname) {
+		char dev_path[64];
+
+		snprintf(dev_path, sizeof(dev_path), "/dev/%s", devname);
+		hotplug_device_left(dev_path);
+	}
+}
+
+/* hid_hotplug.mutex must be locked */
+static void hotplug_monitor_close(void)
+{
+	if (hid_hotplug.monitor_fd >= 0)
+		close(hid_hotplug.monitor_fd);
+	hid_hotplug.monitor_fd = -1;
+}
+
+#else /* HIDAPI_NO_LIBUDEV */
+
+/* hid_hotplug.mutex must be locked */
+static int hotplug_monitor_open(void)
+{
+	hid_hotplug.udev = udev_new();
+	if (!hid_hotplug.udev) {
+		register_global_error("Couldn't create udev context");
+		return -1;
+	}
+
+	hid_hotplug.monitor = udev_monitor_new_from_netlink(hid_hotplug.udev, "udev");
+	if (!hid_hotplug.monitor) {
+		register_global_error("Couldn't create udev monitor");
+		udev_unref(hid_hotplug.udev);
+		hid_hotplug.udev = NULL;
+		return -1;
+	}
+
+	if (udev_monitor_filter_add_match_subsystem_devtype(hid_hotplug.monitor, "hidraw", NULL) < 0
+	 || udev_monitor_enable_receiving(hid_hotplug.monitor) < 0) {
+		register_global_error("Couldn't enable the udev monitor");
+		udev_monitor_unref(hid_hotplug.monitor);
+		hid_hotplug.monitor = NULL;
+		udev_unref(hid_hotplug.udev);
+		hid_hotplug.udev = NULL;
+		return -1;
+	}
+
+	return 0;
+}
+
+static int hotplug_monitor_fd(void)
+{
+	return udev_monitor_get_fd(hid_hotplug.monitor);
+}
+
+static void hotplug_monitor_receive(void)
+{
+	struct udev_device *raw_dev;
+	const char *action;
+
+	raw_dev = udev_monitor_receive_device(hid_hotplug.monitor);
+	if (!raw_dev)
+		return;
+
+	action = udev_device_get_action(raw_dev);
+	if (action && strcmp(action, "add") == 0) {
+		int sysfs_dirfd = open(udev_device_get_syspath(raw_dev), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		if (sysfs_dirfd >= 0) {
+			hotplug_device_arrived(sysfs_dirfd);
+			close(sysfs_dirfd);
+		}
+	}
+	else if (action && strcmp(action, "remove") == 0) {
+		hotplug_device_left(udev_device_get_devnode(raw_dev));
+	}
+
+	udev_device_unref(raw_dev);
+}
+
+/* hid_hotplug.mutex must be locked */
+static void hotplug_monitor_close(void)
+{
+	if (hid_hotplug.monitor)
+		udev_monitor_unref(hid_hotplug.monitor);
+	hid_hotplug.monitor = NULL;
+	udev_unref(hid_hotplug.udev);
+	hid_hotplug.udev = NULL;
+}
+
+#endif /* HIDAPI_NO_LIBUDEV */
+
+static void *hotplug_thread(void *param)
+{
+	struct pollfd fds[2];
+
+	(void) param;
+
+	fds[0].fd = hotplug_monitor_fd();
+	fds[0].events = POLLIN;
+	fds[1].fd = hid_hotplug.wakeup_fd;
+	fds[1].events = POLLIN;
+
+	while (1) {
+		if (poll(fds, 2, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		/* Stopped by hid_exit() */
+		if (fds[1].revents)
+			break;
+
+		if (fds[0].revents & POLLIN)
+			hotplug_monitor_receive();
+	}
+
+	return NULL;
+}
+
+static int scan_devices(const struct hid_enum_filter *filter, struct hid_device_info **devs);
+
+/* hid_hotplug.mutex must be locked */
+static int hotplug_start(void)
+{
+	/* Listen before enumerating, so that no device is missed
+	   (those found twice are ignored by hotplug_device_arrived()) */
+	if (hotplug_monitor_open() < 0)
+		return -1;
+
+	hid_hotplug.wakeup_fd = eventfd(0, EFD_CLOEXEC);
+	if (hid_hotplug.wakeup_fd < 0) {
+		register_global_error_format("eventfd: %s", strerror(errno));
+		goto err;
+	}
+
+	if (scan_devices(&enum_filter_all, &hid_hotplug.devices) < 0)
+		goto err;
+
+	if (pthread_create(&hid_hotplug.thread, NULL, hotplug_thread, NULL) != 0) {
+		register_global_error("Couldn't start the hotplug thread");
+		goto err;
+	}
+
+	hid_hotplug.running = 1;
+	return 0;
+
+err:
+	hidapi_free_device_info_list(hid_hotplug.devices);
+	hid_hotplug.devices = NULL;
+	if (hid_hotplug.wakeup_fd >= 0)
+		close(hid_hotplug.wakeup_fd);
+	hid_hotplug.wakeup_fd = -1;
+	hotplug_monitor_close();
+	return -1;
+}
+
+/* Copies the records of the connected devices matching the filter,
+   starting the monitor if needed. Returns -1 if the monitor can't run. */
+static int hotplug_copy_devices(const struct hid_enum_filter *filter, struct hid_device_info **devs)
+{
+	struct hid_device_info *info;
+	struct hid_device_info **last = devs;
+	const char *last_path = NULL;
+	int skip_usages = (filter->flags & HID_API_ENUM_SKIP_USAGES) && filter->usage_page == 0 && filter->usage == 0;
+
+	pthread_once(&hid_hotplug.once, hotplug_init_mutex);
+	pthread_mutex_lock(&hid_hotplug.mutex);
+
+	if (!hid_hotplug.running && hotplug_start() < 0) {
+		pthread_mutex_unlock(&hid_hotplug.mutex);
+		return -1;
+	}
+
+	*devs = NULL;
+	for (info = hid_hotplug.devices; info; info = info->next) {
+		if (!device_info_matches_filter(filter, info))
+			continue;
+
+		/* The records of a device are next to each other,
+		   only its first one is kept without the usages */
+		if (skip_usages && last_path && strcmp(last_path, info->path) == 0)
+			continue;
+
+		*last = copy_device_info(info);
+		if (!*last)
+			continue;
+
+		if (skip_usages) {
+			(*last)->usage_page = 0;
+			(*last)->usage = 0;
+		}
+		if (filter->flags & HID_API_ENUM_SKIP_STRINGS) {
+			free((*last)->manufacturer_string);
+			free((*last)->product_string);
+			(*last)->manufacturer_string = NULL;
+			(*last)->product_string = NULL;
+			if (!filter->serial_number_prefix) {
+				free((*last)->serial_number);
+				(*last)->serial_number = NULL;
+			}
+		}
+
+		last_path = info->path;
+		last = &(*last)->next;
+	}
+
+	pthread_mutex_unlock(&hid_hotplug.mutex);
+
+	return 0;
+}
+
+static void hotplug_stop(void)
+{
+	struct hid_hotplug_callback *hotplug_cb;
+
+	pthread_once(&hid_hotplug.once, hotplug_init_mutex);
+
+	pthread_mutex_lock(&hid_hotplug.mutex);
+	if (!hid_hotplug.running) {
+		pthread_mutex_unlock(&hid_hotplug.mutex);
+		return;
+	}
+	hid_hotplug.running = 0;
+	eventfd_write(hid_hotplug.wakeup_fd, 1);
+	/* The thread may be waiting for the lock to report an event */
+	pthread_mutex_unlock(&hid_hotplug.mutex);
+
+	pthread_join(hid_hotplug.thread, NULL);
+
+	pthread_mutex_lock(&hid_hotplug.mutex);
+	hotplug_cb = hid_hotplug.callbacks;
+	while (hotplug_cb) {
+		struct hid_hotplug_callback *next = hotplug_cb->next;
+		free(hotplug_cb);
+		hotplug_cb = next;
+	}
+	hid_hotplug.callbacks = NULL;
+	hidapi_free_device_info_list(hid_hotplug.devices);
+	hid_hotplug.devices = NULL;
+	close(hid_hotplug.wakeup_fd);
+	hid_hotplug.wakeup_fd = -1;
+	hotplug_monitor_close();
+	pthread_mutex_unlock(&hid_hotplug.mutex);
+}
+
+int HID_API_EXPORT hid_init(void)
+{
+	const char *locale;
+
+	/* indicate no error */
+	register_global_error(NULL);
+
+	/* Set the locale if it's not set. */
+	locale = setlocale(LC_CTYPE, NULL);
+	if (!locale)
+		setlocale(LC_CTYPE, "");
+
+	return 0;
+}
+
+int HID_API_EXPORT hid_exit(void)
+{
+	hotplug_stop();
+
+#ifdef HIDAPI_USE_IO_URING
+	uring_engine_stop();
+#endif
+
+	/* Free global error message */
+	register_global_error(NULL);
+
+	return 0;
+}
+
+/* See hid_set_enumeration_threads() */
+static int enumeration_threads = 1;
+static int enumeration_timeout_ms = -1;
+
+/* hidraw0, hidraw1, ..., hidraw10: in numerical order */
+static int compare_hidraw_names(const struct dirent **a, const struct dirent **b)
+{
+	size_t a_len = strlen((*a)->d_name);
+	size_t b_len = strlen((*b)->d_name);
+
+	if (a_len != b_len)
+		return (a_len < b_len)? -1: 1;
+	return strcmp((*a)->d_name, (*b)->d_name);
+}
+
+static int is_hidraw_name(const struct dirent *entry)
+{
+	return entry->d_name[0] != '.';
+}
+
+struct scan_job {
+	int class_dirfd;
+	struct dirent **names;
+	const struct hid_enum_filter *filter;
+	struct hid_device_info **results; /* Per name, NULL if not listed */
+};
+
+static void scan_device(size_t index, void *context)
+{
+	struct scan_job *job = (struct scan_job*) context;
+	int sysfs_dirfd; /* The device's hidraw sysfs directory. */
+
+	sysfs_dirfd = openat(job->class_dirfd, job->names[index]->d_name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (sysfs_dirfd < 0)
+		return;
+
+	job->results[index] = create_device_info_for_device(sysfs_dirfd, job->filter);
+	close(sysfs_dirfd);
+}
+
+/* Lists the entries of /sys/class/hidraw, in numerical order.
+   Returns the number of names (class_dirfd is -1 if there is none),
+   or -1 (with the global error set) if sysfs can't be read. */
+static int open_hidraw_class(int *class_dirfd, struct dirent ***names)
+{
+	int num_names;
+
+	*class_dirfd = open("/sys/class/hidraw", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (*class_dirfd < 0) {
+		/* The hidraw driver isn't loaded: no devices */
+		if (errno == ENOENT) {
+			*names = NULL;
+			return 0;
+		}
+		register_global_error_format("open failed (/sys/class/hidraw): %s", strerror(errno));
+		return -1;
+	}
+
+	num_names = scandir("/sys/class/hidraw", names, is_hidraw_name, compare_hidraw_names);
+	if (num_names < 0) {
+		register_global_error_format("scandir failed (/sys/class/hidraw): %s", strerror(errno));
+		close(*class_dirfd);
+		*class_dirfd = -1;
+		return -1;
+	}
+
+	return num_names;
+}
+
+static void close_hidraw_class(int class_dirfd, struct dirent **names, int num_names)
+{
+	int i;
+
+	for (i = 0; i < num_names; i++)
+		free(names[i]);
+	free(names);
+	if (class_dirfd >= 0)
+		close(class_dirfd);
+}
+
+/* Lists the hidraw devices matching the filter, from /sys/class/hidraw.
+   The devices may be read concurrently, the records are listed in the
+   order of the names anyway. Returns -1 (with the global error set)
+   if sysfs can't be read. */
+static int scan_devices(const struct hid_enum_filter *filter, struct hid_device_info **devs)
+{
+	struct dirent **names;
+	struct scan_job job;
+	int class_dirfd;
+	int num_names;
+	int i;
+
+	struct hid_device_info *root = NULL; /* return object */
 	struct hid_device_info *cur_dev = NULL;
 
-	hid_init();
-	/* register_global_error: global error is reset by hid_init */
+	*devs = NULL;
+
+	num_names = open_hidraw_class(&class_dirfd, &names);
+	if (num_names <= 0)
+		return num_names;
+
+	job.class_dirfd = class_dirfd;
+	job.names = names;
+	job.filter = filter;
+	job.results = (struct hid_device_info**) calloc(num_names, sizeof(*job.results));
+	if (!job.results) {
+		register_global_error("Couldn't allocate memory");
+		close_hidraw_class(class_dirfd, names, num_names);
+		return -1;
+	}
+
+	/* For each item, create the records if it matches the filter */
+	hidapi_parallel_for((size_t) num_names, enumeration_threads, enumeration_timeout_ms, scan_device, &job);
+
+	for (i = 0; i < num_names; i++) {
+		struct hid_device_info * tmp = job.results[i];
+
+		if (tmp) {
+			if (cur_dev) {
+				cur_dev->next = tmp;
+			}
+			else {
+				root = tmp;
+			}
+			cur_dev = tmp;
+
+			/* move the pointer to the tail of returnd list */
+			while (cur_dev->next != NULL) {
+				cur_dev = cur_dev->next;
+			}
+		}
+	}
+
+	free(job.results);
+	close_hidraw_class(class_dirfd, names, num_names);
+
+	*devs = root;
+	return 0;
+}
+
+struct hid_device_info  HID_API_EXPORT *hid_enumerate(unsigned short vendor_id, unsigned short product_id)
+{
+	struct hid_enum_filter filter;
+
+	memset(&filter, 0, sizeof(filter));
+	filter.vendor_id = vendor_id;
+	filter.product_id = product_id;
+
+	return hid_enumerate_ex(&filter);
+}
+
+struct hid_device_info HID_API_EXPORT *hid_enumerate_ex(const struct hid_enum_filter *filter)
+{
+	struct hid_device_info *root = NULL; /* return object */
+
+	hid_init();
+	/* register_global_error: global error is reset by hid_init */
+
+	if (!filter)
+		filter = &enum_filter_all;
+
+	/* Served from memory while the cache is up */
+	if (!use_enumeration_cache || hotplug_copy_devices(filter, &root) < 0) {
+		if (scan_devices(filter, &root) < 0)
+			return NULL;
+	}
+
+	/* A single allocation for all the records and their strings,
+	   freed at once by hid_free_enumeration() */
+	if (root) {
+		root = hidapi_pack_device_info_list(root);
+		if (!root) {
+			register_global_error("Couldn't allocate memory");
+			return NULL;
+		}
+	}
+
+	if (root == NULL) {
+		if (filter->usage_page != 0 || filter->usage != 0 || filter->bus_type != HID_API_BUS_UNKNOWN
+		 || (filter->flags & HID_API_ENUM_MATCH_INTERFACE) || filter->serial_number_prefix) {
+			register_global_error("No HID devices matching the filter found in the system.");
+		} else if (filter->vendor_id == 0 && filter->product_id == 0) {
+			register_global_error("No HID devices found in the system.");
+		} else {
+			register_global_error("No HID devices with requested VID/PID found in the system.");
+		}
+	}
+
+	return root;
+}
+
+/* Gives the records of devs to the callback one at a time.
+   Returns non-zero if the callback stopped the enumeration. */
+static int report_device_info(struct hid_device_info *devs, hid_enumerate_callback_fn callback, void *user_data)
+{
+	struct hid_device_info *info;
+	struct hid_device_info *next;
+	int stop = 0;
+
+	for (info = devs; info && !stop; info = next) {
+		next = info->next;
+		info->next = NULL;
+		stop = callback(info, user_data);
+		info->next = next;
+	}
+
+	return stop;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_enumerate_each(const struct hid_enum_filter *filter, hid_enumerate_callback_fn callback, void *user_data)
+{
+	struct hid_device_info *devs;
+	struct dirent **names;
+	int class_dirfd;
+	int num_names;
+	int stop = 0;
+	int i;
+
+	hid_init();
+
+	if (!callback) {
+		errno = EINVAL;
+		register_global_error(strerror(errno));
+		return -1;
+	}
+
+	if (!filter)
+		filter = &enum_filter_all;
+
+	/* Served from memory while the cache is up */
+	if (use_enumeration_cache && hotplug_copy_devices(filter, &devs) == 0) {
+		report_device_info(devs, callback, user_data);
+		hidapi_free_device_info_list(devs);
+		return 0;
+	}
+
+	num_names = open_hidraw_class(&class_dirfd, &names);
+	if (num_names < 0)
+		return -1;
+
+	/* Each device is reported before the next one is read */
+	for (i = 0; i < num_names && !stop; i++) {
+		int sysfs_dirfd = openat(class_dirfd, names[i]->d_name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		if (sysfs_dirfd < 0)
+			continue;
+
+		devs = create_device_info_for_device(sysfs_dirfd, filter);
+		close(sysfs_dirfd);
+
+		stop = report_device_info(devs, callback, user_data);
+		hidapi_free_device_info_list(devs);
+	}
+
+	close_hidraw_class(class_dirfd, names, num_names);
+
+	return 0;
+}
+
+void  HID_API_EXPORT hid_free_enumeration(struct hid_device_info *devs)
+{
+	/* The list is packed, see hid_enumerate_ex() */
+	free(devs);
+}
+
+int HID_API_EXPORT HID_API_CALL hid_hotplug_register_callback(unsigned short vendor_id, unsigned short product_id, int events, int flags, hid_hotplug_callback_fn callback, void *user_data, hid_hotplug_callback_handle *callback_handle)
+{
+	struct hid_hotplug_callback *hotplug_cb;
+	struct hid_hotplug_callback **last;
+
+	if (!callback || events == 0
+	 || (events & ~(HID_API_HOTPLUG_EVENT_DEVICE_ARRIVED | HID_API_HOTPLUG_EVENT_DEVICE_LEFT))
+	 || (flags & ~HID_API_HOTPLUG_ENUMERATE)) {
+		errno = EINVAL;
+		register_global_error(strerror(errno));
+		return -1;
+	}
+
+	hotplug_cb = (struct hid_hotplug_callback*) calloc(1, sizeof(*hotplug_cb));
+	if (!hotplug_cb) {
+		register_global_error("Couldn't allocate memory");
+		return -1;
+	}
+
+	hotplug_cb->vendor_id = vendor_id;
+	hotplug_cb->product_id = product_id;
+	hotplug_cb->events = events;
+	hotplug_cb->callback = callback;
+	hotplug_cb->user_data = user_data;
+
+	pthread_once(&hid_hotplug.once, hotplug_init_mutex);
+	pthread_mutex_lock(&hid_hotplug.mutex);
+
+	if (!hid_hotplug.running && hotplug_start() < 0) {
+		pthread_mutex_unlock(&hid_hotplug.mutex);
+		free(hotplug_cb);
+		return -1;
+	}
+
+	hotplug_cb->handle = hid_hotplug.next_handle++;
+	for (last = &hid_hotplug.callbacks; *last; last = &(*last)->next)
+		;
+	*last = hotplug_cb;
+
+	if (callback_handle)
+		*callback_handle = hotplug_cb->handle;
+
+	if (flags & HID_API_HOTPLUG_ENUMERATE)
+		hotplug_dispatch(hid_hotplug.devices, HID_API_HOTPLUG_EVENT_DEVICE_ARRIVED, hotplug_cb);
+
+	pthread_mutex_unlock(&hid_hotplug.mutex);
+
+	return 0;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_hotplug_deregister_callback(hid_hotplug_callback_handle callback_handle)
+{
+	struct hid_hotplug_callback **cur;
+	int res = -1;
+
+	pthread_once(&hid_hotplug.once, hotplug_init_mutex);
+	pthread_mutex_lock(&hid_hotplug.mutex);
+
+	for (cur = &hid_hotplug.callbacks; *cur; cur = &(*cur)->next) {
+		struct hid_hotplug_callback *hotplug_cb = *cur;
+		if (hotplug_cb->handle != callback_handle || !hotplug_cb->callback)
+			continue;
+
+		if (hid_hotplug.dispatching) {
+			/* Called from a callback, the list is being walked */
+			hotplug_cb->callback = NULL;
+		}
+		else {
+			*cur = hotplug_cb->next;
+			free(hotplug_cb);
+		}
+		res = 0;
+		break;
+	}
+
+	pthread_mutex_unlock(&hid_hotplug.mutex);
+
+	return res;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_set_enumeration_cache(int enable)
+{
+	if (enable) {
+		/* Start monitoring right away, so that no change is missed */
+		pthread_once(&hid_hotplug.once, hotplug_init_mutex);
+		pthread_mutex_lock(&hid_hotplug.mutex);
+		if (!hid_hotplug.running && hotplug_start() < 0) {
+			pthread_mutex_unlock(&hid_hotplug.mutex);
+			return -1;
+		}
+		pthread_mutex_unlock(&hid_hotplug.mutex);
+	}
+
+	use_enumeration_cache = enable? 1: 0;
+
+	return 0;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_set_enumeration_threads(int num_threads, int timeout_ms)
+{
+	if (num_threads < 0) {
+		errno = EINVAL;
+		register_global_error(strerror(errno));
+		return -1;
+	}
+
+	enumeration_threads = num_threads;
+	enumeration_timeout_ms = (timeout_ms < 0)? -1: timeout_ms;
+
+	return 0;
+}
+
+hid_device * hid_open(unsigned short vendor_id, unsigned short product_id, const wchar_t *serial_number)
+{
+	struct hid_device_info *devs, *cur_dev;
+	struct hid_enum_filter filter;
+	const char *path_to_open = NULL;
+	hid_device *handle = NULL;
+
+	/* Only the path (and the serial number) is needed */
+	memset(&filter, 0, sizeof(filter));
+	filter.vendor_id = vendor_id;
+	filter.product_id = product_id;
+	filter.serial_number_prefix = serial_number;
+	filter.flags = HID_API_ENUM_SKIP_STRINGS | HID_API_ENUM_SKIP_USAGES;
+
+	/* register_global_error: global error is reset by hid_enumerate/hid_init */
+	devs = hid_enumerate_ex(&filter);
+	if (devs == NULL) {
+		/* register_global_error: global error is already set by hid_enumerate */
+		return NULL;
+	}
+
+	cur_dev = devs;
+	while (cur_dev) {
+		if (cur_dev->vendor_id == vendor_id &&
+		    cur_dev->product_id == product_id) {
+			if (serial_number) {
+				if (wcscmp(serial_number, cur_dev->serial_number) == 0) {
+					path_to_open = cur_dev->path;
+					break;
+				}
+			}
+			else {
+				path_to_open = cur_dev->path;
+				break;
+			}
+		}
+		cur_dev = cur_dev->next;
+	}
+
+	if (path_to_open) {
+		/* Open the device */
+		handle = hid_open_path(path_to_open);
+	} else {
+		register_global_error("Device with requested VID/PID/(SerialNumber) not found");
+	}
+
+	hid_free_enumeration(devs);
+
+	return handle;
+}
+
+hid_device * HID_API_EXPORT hid_open_path(const char *path)
+{
+	hid_device *dev = NULL;
+
+	hid_init();
+	/* register_global_error: global error is reset by hid_init */
+
+	dev = new_hid_device();
+	if (!dev) {
+		register_global_error("Couldn't allocate memory");
+		return NULL;
+	}
+
+	dev->device_handle = open(path, O_RDWR | O_CLOEXEC);
+
+	if (dev->device_handle >= 0) {
+		int res, desc_size = 0;
+
+		/* Make sure this is a HIDRAW device - responds to HIDIOCGRDESCSIZE */
+		res = ioctl(dev->device_handle, HIDIOCGRDESCSIZE, &desc_size);
+		if (res < 0) {
+			hid_close(dev);
+			register_device_error_format(dev, "ioctl(GRDESCSIZE) error for '%s', not a HIDRAW device?: %s", path, strerror(errno));
+			return NULL;
+		}
+
+#ifdef HIDAPI_USE_IO_URING
+		uring_attach_device(dev);
+#endif
+
+		return dev;
+	}
+	else {
+		/* Unable to open a device. */
+		free(dev);
+		register_global_error_format("Failed to open a device with path '%s': %s", path, strerror(errno));
+		return NULL;
+	}
+}
+
+
+int HID_API_EXPORT hid_write(hid_device *dev, const unsigned char *data, size_t length)
+{
+	int bytes_written;
+
+	if (!data || (length == 0)) {
+		errno = EINVAL;
+		register_device_error(dev, strerror(errno));
+		return -1;
+	}
+
+	bytes_written = write(dev->device_handle, data, length);
+
+	register_device_error(dev, (bytes_written == -1)? strerror(errno): NULL);
+
+	return bytes_written;
+}
+
+
+/* Read a report from the kernel (or the io_uring engine), bypassing the input queue */
+static int read_report(hid_device *dev, unsigned char *data, size_t length, int milliseconds)
+{
+	int bytes_read;
+
+#ifdef HIDAPI_USE_IO_URING
+	if (dev->uring_bgid >= 0) {
+		size_t len = 0;
+		bytes_read = uring_read_reports(dev, data, length, 1, &len, milliseconds);
+		return (bytes_read > 0)? (int) len: bytes_read;
+	}
+#endif
+
+	/* With an input queue the handle is non-blocking,
+	   so a blocking read waits in poll() as well */
+	if (milliseconds >= 0 || dev->input_queue) {
+		/* Milliseconds is either 0 (non-blocking) or > 0 (contains
+		   a valid timeout). In both cases we want to call poll()
+		   and wait for data to arrive.  Don't rely on non-blocking
+		   operation (O_NONBLOCK) since some kernels don't seem to
+		   properly report device disconnection through read() when
+		   in non-blocking mode.  */
+		int ret;
+		struct pollfd fds;
+
+		fds.fd = dev->device_handle;
+		fds.events = POLLIN;
+		fds.revents = 0;
+		ret = poll(&fds, 1, milliseconds);
+		if (ret == 0) {
+			/* Timeout */
+			return ret;
+		}
+		if (ret == -1) {
+			/* Error */
+			register_device_error(dev, strerror(errno));
+			return ret;
+		}
+		else {
+			/* Check for errors on the file descriptor. This will
+			   indicate a device disconnection. */
+			if (fds.revents & (POLLERR | POLLHUP | POLLNVAL)) {
+				// We cannot use strerror() here as no -1 was returned from poll().
+				register_device_error(dev, "hid_read_timeout: unexpected poll error (device disconnected)");
+				return -1;
+			}
+		}
+	}
+
+	bytes_read = read(dev->device_handle, data, length);
+	if (bytes_read < 0) {
+		if (errno == EAGAIN || errno == EINPROGRESS)
+			bytes_read = 0;
+		else
+			register_device_error(dev, strerror(errno));
+	}
+
+	return bytes_read;
+}
+
+#define INPUT_QUEUE_RECORD_HEADER 2
+
+static void input_queue_copy_in(struct input_queue *q, size_t offset, const unsigned char *src, size_t n)
+{
+	size_t pos = (q->start + offset) % q->size;
+	size_t first = (n < q->size - pos)? n: q->size - pos;
+	memcpy(q->buffer + pos, src, first);
+	memcpy(q->buffer, src + first, n - first);
+}
+
+static void input_queue_copy_out(struct input_queue *q, size_t offset, unsigned char *dst, size_t n)
+{
+	size_t pos = (q->start + offset) % q->size;
+	size_t first = (n < q->size - pos)? n: q->size - pos;
+	memcpy(dst, q->buffer + pos, first);
+	memcpy(dst + first, q->buffer, n - first);
+}
+
+/* Take the oldest report out of the queue.
+   Returns its (truncated) length, or -1 if the queue is empty. */
+static int input_queue_pop(struct input_queue *q, unsigned char *data, size_t length)
+{
+	unsigned char header[INPUT_QUEUE_RECORD_HEADER];
+	size_t len;
+
+	if (q->count == 0)
+		return -1;
+
+	input_queue_copy_out(q, 0, header, sizeof(header));
+	len = header[0] | (header[1] << 8);
+	input_queue_copy_out(q, sizeof(header), data, (len < length)? len: length);
+
+	q->start = (q->start + sizeof(header) + len) % q->size;
+	q->used -= sizeof(header) + len;
+	q->count--;
+
+	return (int) ((len < length)? len: length);
+}
+
+/* Make sure there is room for needed more bytes, growing the buffer if allowed.
+   Returns 0 if there is. */
+static int input_queue_reserve(struct input_queue *q, size_t needed)
+{
+	size_t size;
+	unsigned char *buffer;
+
+	if (q->size - q->used >= needed)
+		return 0;
+
+	size = q->size? q->size * 2: 1024;
+	while (size - q->used < needed)
+		size *= 2;
+	if (q->max_bytes > 0 && size > q->max_bytes)
+		size = q->max_bytes;
+	if (size - q->used < needed)
+		return -1;
+
+	buffer = (unsigned char*) malloc(size);
+	if (!buffer)
+		return -1;
+	if (q->used > 0)
+		input_queue_copy_out(q, 0, buffer, q->used);
+	free(q->buffer);
+	q->buffer = buffer;
+	q->size = size;
+	q->start = 0;
+
+	return 0;
+}
+
+static int input_queue_fits(struct input_queue *q, size_t length)
+{
+	size_t needed = INPUT_QUEUE_RECORD_HEADER + length;
+	if (q->count >= q->max_reports)
+		return 0;
+	return q->max_bytes == 0 || q->max_bytes - q->used >= needed;
+}
+
+/* Add a report to the queue, applying the overflow policy.
+   Returns 0 if the report was queued or dropped,
+   -1 if it has to wait (HID_API_QUEUE_BLOCK). */
+static int input_queue_push(hid_device *dev, struct input_queue *q, const unsigned char *data, size_t length)
+{
+	unsigned char header[INPUT_QUEUE_RECORD_HEADER];
+
+	if (q->max_bytes > 0 && INPUT_QUEUE_RECORD_HEADER + length > q->max_bytes) {
+		/* Can never fit */
+		dev->dropped_reports++;
+		return 0;
+	}
+
+	if (!input_queue_fits(q, length)) {
+		if (q->policy == HID_API_QUEUE_BLOCK)
+			return -1;
+		if (q->policy == HID_API_QUEUE_DROP_NEWEST) {
+			dev->dropped_reports++;
+			return 0;
+		}
+		while (!input_queue_fits(q, length)) {
+			input_queue_pop(q, header, 0);
+			dev->dropped_reports++;
+		}
+	}
+
+	if (input_queue_reserve(q, INPUT_QUEUE_RECORD_HEADER + length) < 0) {
+		dev->dropped_reports++;
+		return 0;
+	}
+
+	header[0] = (unsigned char) (length & 0xff);
+	header[1] = (unsigned char) (length >> 8);
+	input_queue_copy_in(q, q->used, header, sizeof(header));
+	input_queue_copy_in(q, q->used + sizeof(header), data, length);
+	q->used += sizeof(header) + length;
+	q->count++;
+
+	return 0;
+}
+
+/* Add a report to the queue of its report ID, if it has one,
+   otherwise to the input queue. See input_queue_push(). */
+static int input_queue_dispatch(hid_device *dev, const unsigned char *data, size_t length)
+{
+	if (dev->num_report_id_queues > 0 && length > 0 && dev->report_id_queues[data[0]])
+		return input_queue_push(dev, dev->report_id_queues[data[0]], data, length);
+
+	return input_queue_push(dev, dev->input_queue, data, length);
+}
+
+/* Move all the reports the kernel has buffered into the input queues,
+   without waiting (the handle is non-blocking while there is an input
+   queue, see hid_set_input_queue()). Read errors are left to be
+   reported by the next read_report(), once the queue is empty. */
+static void input_queue_fill(hid_device *dev)
+{
+	struct input_queue *q = dev->input_queue;
+
+	if (q->pending_length >= 0) {
+		if (input_queue_dispatch(dev, q->pending, (size_t) q->pending_length) < 0)
+			return;
+		q->pending_length = -1;
+	}
+
+	for (;;) {
+		ssize_t bytes_read;
+
+#ifdef HIDAPI_USE_IO_URING
+		if (dev->uring_bgid >= 0) {
+			size_t len;
+			if (uring_read_reports(dev, q->pending, HIDRAW_MAX_REPORT_SIZE, 1, &len, 0) <= 0)
+				break;
+			bytes_read = (ssize_t) len;
+		}
+		else
+#endif
+		bytes_read = read(dev->device_handle, q->pending, HIDRAW_MAX_REPORT_SIZE);
+		if (bytes_read < 0)
+			break;
+
+		if (input_queue_dispatch(dev, q->pending, (size_t) bytes_read) < 0) {
+			/* Stop reading from the kernel until there is room */
+			q->pending_length = (int) bytes_read;
+			break;
+		}
+	}
+}
+
+/* Read the oldest report of the queue q, waiting for it if needed.
+   The reports received meanwhile go to their own queues, so this is
+   used instead of read_report() once there are queues of report IDs. */
+static int read_queued_report(hid_device *dev, struct input_queue *q, unsigned char *data, size_t length, int milliseconds)
+{
+	unsigned char report[HIDRAW_MAX_REPORT_SIZE];
+	struct timespec start, now;
+	int timeout = milliseconds;
+	int res;
+
+	if (milliseconds > 0)
+		clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (;;) {
+		input_queue_fill(dev);
+		res = input_queue_pop(q, data, length);
+		if (res >= 0)
+			return res;
+
+		res = read_report(dev, report, sizeof(report), timeout);
+		if (res <= 0)
+			return res;
+		if (input_queue_dispatch(dev, report, (size_t) res) < 0) {
+			memcpy(dev->input_queue->pending, report, (size_t) res);
+			dev->input_queue->pending_length = res;
+		}
+
+		if (milliseconds > 0) {
+			long elapsed;
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			elapsed = (now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000;
+			timeout = (elapsed < milliseconds)? milliseconds - (int) elapsed: 0;
+		}
+		if (timeout == 0) {
+			/* Don't keep reading the reports of the other IDs */
+			input_queue_fill(dev);
+			res = input_queue_pop(q, data, length);
+			return (res >= 0)? res: 0;
+		}
+	}
+}
+
+int HID_API_EXPORT hid_read_timeout(hid_device *dev, unsigned char *data, size_t length, int milliseconds)
+{
+	/* Set device error to none */
+	register_device_error(dev, NULL);
+
+	if (dev->num_report_id_queues > 0)
+		return read_queued_report(dev, dev->input_queue, data, length, milliseconds);
+
+	if (dev->input_queue) {
+		int res;
+		input_queue_fill(dev);
+		res = input_queue_pop(dev->input_queue, data, length);
+		if (res >= 0)
+			return res;
+	}
+
+	return read_report(dev, data, length, milliseconds);
+}
+
+int HID_API_EXPORT hid_read(hid_device *dev, unsigned char *data, size_t length)
+{
+	return hid_read_timeout(dev, data, length, (dev->blocking)? -1: 0);
+}
+
+int HID_API_EXPORT hid_read_batch(hid_device *dev, unsigned char *data, size_t stride, size_t max_reports, size_t *lengths, int milliseconds)
+{
+	int res;
+	int flags;
+	size_t count = 0;
+
+	if (!data || !stride || !lengths || !max_reports) {
+		errno = EINVAL;
+		register_device_error(dev, strerror(errno));
+		return -1;
+	}
+
+	if (dev->input_queue) {
+		register_device_error(dev, NULL);
+
+		input_queue_fill(dev);
+		if (dev->input_queue->count == 0) {
+			/* Wait for the first one */
+			if (dev->num_report_id_queues > 0)
+				res = read_queued_report(dev, dev->input_queue, data, stride, milliseconds);
+			else
+				res = read_report(dev, data, stride, milliseconds);
+			if (res <= 0)
+				return res;
+			lengths[count++] = (size_t) res;
+			input_queue_fill(dev);
+		}
+
+		while (count < max_reports) {
+			res = input_queue_pop(dev->input_queue, data + count * stride, stride);
+			if (res < 0)
+				break;
+			lengths[count++] = (size_t) res;
+		}
+
+		return (int) count;
+	}
+
+#ifdef HIDAPI_USE_IO_URING
+	if (dev->uring_bgid >= 0) {
+		register_device_error(dev, NULL);
+		return uring_read_reports(dev, data, stride, max_reports, lengths, milliseconds);
+	}
+#endif
+
+	/* The first report is waited for exactly like in hid_read_timeout(),
+	   so disconnections are still detected by poll(). */
+	res = hid_read_timeout(dev, data, stride, milliseconds);
+	if (res <= 0)
+		return res;
+	lengths[count++] = (size_t) res;
+
+	if (count == max_reports)
+		return (int) count;
+
+	/* Drain everything the kernel has queued already. The handle is
+	   switched to non-blocking mode only for the duration of the drain,
+	   so an empty queue ends the batch with EAGAIN instead of costing
+	   an extra poll() for every report. */
+	flags = fcntl(dev->device_handle, F_GETFL);
+	if (flags == -1 || fcntl(dev->device_handle, F_SETFL, flags | O_NONBLOCK) == -1)
+		return (int) count;
+
+	while (count < max_reports) {
+		ssize_t bytes_read = read(dev->device_handle, data + count * stride, stride);
+		/* Any failure (EAGAIN included) just ends the batch, a real
+		   error is going to be reported by the next read. */
+		if (bytes_read <= 0)
+			break;
+		lengths[count++] = (size_t) bytes_read;
+	}
+
+	fcntl(dev->device_handle, F_SETFL, flags);
+
+	return (int) count;
+}
+
+int HID_API_EXPORT hid_set_nonblocking(hid_device *dev, int nonblock)
+{
+	/* Do all non-blocking in userspace using poll(), since it looks
+	   like there's a bug in the kernel in some versions where
+	   read() will not return -1 on disconnection of the USB device */
+
+	dev->blocking = !nonblock;
+	return 0; /* Success */
+}
+
+int HID_API_EXPORT hid_get_pollable_fd(hid_device *dev)
+{
+	register_device_error(dev, NULL);
+	return get_input_fd(dev);
+}
+
+static void free_input_queue(struct input_queue *q)
+{
+	if (!q)
+		return;
+	free(q->buffer);
+	free(q->pending);
+	free(q);
+}
+
+int HID_API_EXPORT hid_set_input_queue(hid_device *dev, size_t max_reports, size_t max_bytes, hid_queue_policy policy)
+{
+	struct input_queue *q;
+	unsigned char *report;
+	int len;
+
+	if (max_reports == 0 || (unsigned) policy > HID_API_QUEUE_BLOCK) {
+		errno = EINVAL;
+		register_device_error(dev, strerror(errno));
+		return -1;
+	}
+
+	/* See hid_set_report_id_queue() */
+	if (policy == HID_API_QUEUE_BLOCK && dev->num_report_id_queues > 0) {
+		register_device_error(dev, "The queues of report IDs can't be used with HID_API_QUEUE_BLOCK");
+		return -1;
+	}
+
+	q = (struct input_queue*) calloc(1, sizeof(struct input_queue));
+	report = (unsigned char*) malloc(HIDRAW_MAX_REPORT_SIZE);
+	if (!q || !report) {
+		free(q);
+		free(report);
+		register_device_error(dev, "Couldn't allocate memory");
+		return -1;
+	}
+	q->pending = (unsigned char*) malloc(HIDRAW_MAX_REPORT_SIZE);
+	q->pending_length = -1;
+	q->max_reports = max_reports;
+	q->max_bytes = max_bytes;
+	q->policy = policy;
+	if (!q->pending) {
+		free_input_queue(q);
+		free(report);
+		register_device_error(dev, "Couldn't allocate memory");
+		return -1;
+	}
+
+	/* Keep the reports already queued */
+	if (dev->input_queue) {
+		struct input_queue *old = dev->input_queue;
+		dev->input_queue = q;
+		while ((len = input_queue_pop(old, report, HIDRAW_MAX_REPORT_SIZE)) >= 0) {
+			if (input_queue_push(dev, q, report, (size_t) len) < 0)
+				dev->dropped_reports++;
+		}
+		if (old->pending_length >= 0 && input_queue_dispatch(dev, old->pending, (size_t) old->pending_length) < 0) {
+			memcpy(q->pending, old->pending, (size_t) old->pending_length);
+			q->pending_length = old->pending_length;
+		}
+		free_input_queue(old);
+	}
+	else {
+		/* Set once, so that input_queue_fill() drains the kernel
+		   buffer with plain read()s. The waits go through poll(). */
+		int flags = fcntl(dev->device_handle, F_GETFL);
+		if (flags == -1 || fcntl(dev->device_handle, F_SETFL, flags | O_NONBLOCK) == -1) {
+			register_device_error(dev, strerror(errno));
+			free_input_queue(q);
+			free(report);
+			return -1;
+		}
+		dev->input_queue = q;
+	}
+
+	free(report);
+	register_device_error(dev, NULL);
+	return 0;
+}
 
-	/* Create the udev object */
-	udev = udev_new();
-	if (!udev) {
-		register_global_error("Couldn't create udev context");
-		return NULL;
+int HID_API_EXPORT hid_get_dropped_reports(hid_device *dev, unsigned long long *count)
+{
+	if (!count) {
+		errno = EINVAL;
+		register_device_error(dev, strerror(errno));
+		return -1;
 	}
 
-	/* Create a list of the devices in the 'hidraw' subsystem. */
-	enumerate = udev_enumerate_new(udev);
-	udev_enumerate_add_match_subsystem(enumerate, "hidraw");
-	udev_enumerate_scan_devices(enumerate);
-	devices = udev_enumerate_get_list_entry(enumerate);
-	/* For each item, see if it matches the vid/pid, and if so
-	   create a udev_device record for it */
-	udev_list_entry_foreach(dev_list_entry, devices) {
-		const char *sysfs_path;
-		unsigned short dev_vid = 0;
-		unsigned short dev_pid = 0;
-		unsigned bus_type = 0;
-		struct udev_device *raw_dev; /* The device's hidraw udev node. */
-		struct hid_device_info * tmp;
-
-		/* Get the filename of the /sys entry for the device
-		   and create a udev_device object (dev) representing it */
-		sysfs_path = udev_list_entry_get_name(dev_list_entry);
-		if (!sysfs_path)
-			continue;
+	*count = dev->dropped_reports;
+	register_device_error(dev, NULL);
+	return 0;
+}
 
-		if (vendor_id != 0 || product_id != 0) {
-			if (!parse_hid_vid_pid_from_sysfs(sysfs_path, &bus_type, &dev_vid, &dev_pid))
-				continue;
+int HID_API_EXPORT hid_set_report_id_queue(hid_device *dev, unsigned char report_id, size_t max_reports)
+{
+	struct input_queue *q = NULL;
+	struct input_queue *old;
+	unsigned char *report;
+	int len;
 
-			if (vendor_id != 0 && vendor_id != dev_vid)
-				continue;
-			if (product_id != 0 && product_id != dev_pid)
-				continue;
-		}
+	/* Without report IDs, the first byte is data */
+	if (report_id == 0) {
+		errno = EINVAL;
+		register_device_error(dev, strerror(errno));
+		return -1;
+	}
 
-		raw_dev = udev_device_new_from_syspath(udev, sysfs_path);
-		if (!raw_dev)
-			continue;
+	/* The reports of the ID would wait behind a full input queue */
+	if (max_reports > 0 && dev->input_queue && dev->input_queue->policy == HID_API_QUEUE_BLOCK) {
+		register_device_error(dev, "The queues of report IDs can't be used with HID_API_QUEUE_BLOCK");
+		return -1;
+	}
 
-		tmp = create_device_info_for_device(raw_dev);
-		if (tmp) {
-			if (cur_dev) {
-				cur_dev->next = tmp;
-			}
-			else {
-				root = tmp;
-			}
-			cur_dev = tmp;
+	/* The reports of the other IDs are queued while waiting */
+	if (!dev->input_queue && hid_set_input_queue(dev, 64, 0, HID_API_QUEUE_DROP_OLDEST) < 0)
+		return -1;
 
-			/* move the pointer to the tail of returnd list */
-			while (cur_dev->next != NULL) {
-				cur_dev = cur_dev->next;
-			}
+	if (!dev->report_id_queues) {
+		dev->report_id_queues = (struct input_queue**) calloc(256, sizeof(struct input_queue*));
+		if (!dev->report_id_queues) {
+			register_device_error(dev, "Couldn't allocate memory");
+			return -1;
 		}
+	}
 
-		udev_device_unref(raw_dev);
+	report = (unsigned char*) malloc(HIDRAW_MAX_REPORT_SIZE);
+	if (max_reports > 0)
+		q = (struct input_queue*) calloc(1, sizeof(struct input_queue));
+	if (!report || (max_reports > 0 && !q)) {
+		free(report);
+		free(q);
+		register_device_error(dev, "Couldn't allocate memory");
+		return -1;
+	}
+	if (q) {
+		q->pending_length = -1;
+		q->max_reports = max_reports;
+		q->policy = HID_API_QUEUE_DROP_OLDEST;
 	}
-	/* Free the enumerator and udev objects. */
-	udev_enumerate_unref(enumerate);
-	udev_unref(udev);
 
-	if (root == NULL) {
-		if (vendor_id == 0 && product_id == 0) {
-			register_global_error("No HID devices found in the system.");
-		} else {
-			register_global_error("No HID devices with requested VID/PID found in the system.");
+	/* The reports queued already stay in the queue of the ID,
+	   or go back to the input queue when it is removed */
+	old = dev->report_id_queues[report_id];
+	dev->report_id_queues[report_id] = q;
+	if (q && !old)
+		dev->num_report_id_queues++;
+	else if (!q && old)
+		dev->num_report_id_queues--;
+
+	if (old) {
+		while ((len = input_queue_pop(old, report, HIDRAW_MAX_REPORT_SIZE)) >= 0) {
+			if (input_queue_dispatch(dev, report, (size_t) len) < 0)
+				dev->dropped_reports++;
 		}
+		free_input_queue(old);
 	}
 
-	return root;
+	free(report);
+	register_device_error(dev, NULL);
+	return 0;
 }
 
-void  HID_API_EXPORT hid_free_enumeration(struct hid_device_info *devs)
+int HID_API_EXPORT hid_read_report_id(hid_device *dev, unsigned char report_id, unsigned char *data, size_t length, int milliseconds)
 {
-	struct hid_device_info *d = devs;
-	while (d) {
-		struct hid_device_info *next = d->next;
-		free(d->path);
-		free(d->serial_number);
-		free(d->manufacturer_string);
-		free(d->product_string);
-		free(d);
-		d = next;
+	if (!dev->report_id_queues || !dev->report_id_queues[report_id]) {
+		register_device_error(dev, "No queue for this report ID, see hid_set_report_id_queue()");
+		return -1;
 	}
+
+	register_device_error(dev, NULL);
+	return read_queued_report(dev, dev->report_id_queues[report_id], data, length, milliseconds);
 }
 
-hid_device * hid_open(unsigned short vendor_id, unsigned short product_id, const wchar_t *serial_number)
-{
-	struct hid_device_info *devs, *cur_dev;
-	const char *path_to_open = NULL;
-	hid_device *handle = NULL;
+struct hid_poller_entry {
+	hid_device *dev;
+	hid_poller_callback callback;
+	void *user_data;
+	int removed;
+	struct hid_poller_entry *next;
+};
 
-	/* register_global_error: global error is reset by hid_enumerate/hid_init */
-	devs = hid_enumerate(vendor_id, product_id);
-	if (devs == NULL) {
-		/* register_global_error: global error is already set by hid_enumerate */
+struct hid_poller_ {
+	int epoll_fd;
+	int running; /* hid_poller_run() is dispatching the reports */
+	struct hid_poller_entry *entries;
+	unsigned char *buffer;
+	size_t lengths[HIDRAW_POLLER_BATCH];
+};
+
+hid_poller HID_API_EXPORT * HID_API_CALL hid_poller_new(void)
+{
+	hid_poller *poller = (hid_poller*) calloc(1, sizeof(hid_poller));
+	if (!poller) {
+		register_global_error("Couldn't allocate memory");
 		return NULL;
 	}
 
-	cur_dev = devs;
-	while (cur_dev) {
-		if (cur_dev->vendor_id == vendor_id &&
-		    cur_dev->product_id == product_id) {
-			if (serial_number) {
-				if (wcscmp(serial_number, cur_dev->serial_number) == 0) {
-					path_to_open = cur_dev->path;
-					break;
-				}
-			}
-			else {
-				path_to_open = cur_dev->path;
-				break;
-			}
-		}
-		cur_dev = cur_dev->next;
+	poller->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (poller->epoll_fd == -1) {
+		register_global_error_format("epoll_create1: %s", strerror(errno));
+		free(poller);
+		return NULL;
 	}
 
-	if (path_to_open) {
-		/* Open the device */
-		handle = hid_open_path(path_to_open);
-	} else {
-		register_global_error("Device with requested VID/PID/(SerialNumber) not found");
+	poller->buffer = (unsigned char*) malloc(HIDRAW_POLLER_REPORT_SIZE * HIDRAW_POLLER_BATCH);
+	if (!poller->buffer) {
+		register_global_error("Couldn't allocate memory");
+		close(poller->epoll_fd);
+		free(poller);
+		return NULL;
 	}
 
-	hid_free_enumeration(devs);
-
-	return handle;
+	register_global_error(NULL);
+	return poller;
 }
 
-hid_device * HID_API_EXPORT hid_open_path(const char *path)
+int HID_API_EXPORT HID_API_CALL hid_poller_add(hid_poller *poller, hid_device *dev, hid_poller_callback callback, void *user_data)
 {
-	hid_device *dev = NULL;
+	struct hid_poller_entry *entry;
+	struct epoll_event ev;
 
-	hid_init();
-	/* register_global_error: global error is reset by hid_init */
+	if (!poller || !dev || !callback) {
+		errno = EINVAL;
+		register_global_error(strerror(errno));
+		return -1;
+	}
 
-	dev = new_hid_device();
-	if (!dev) {
+	if (dev->poller) {
+		register_global_error("The device is already added to a poller");
+		return -1;
+	}
+
+	entry = (struct hid_poller_entry*) calloc(1, sizeof(struct hid_poller_entry));
+	if (!entry) {
 		register_global_error("Couldn't allocate memory");
-		return NULL;
+		return -1;
+	}
+	entry->dev = dev;
+	entry->callback = callback;
+	entry->user_data = user_data;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.ptr = entry;
+	if (epoll_ctl(poller->epoll_fd, EPOLL_CTL_ADD, get_input_fd(dev), &ev) == -1) {
+		register_global_error_format("epoll_ctl: %s", strerror(errno));
+		free(entry);
+		return -1;
 	}
 
-	dev->device_handle = open(path, O_RDWR | O_CLOEXEC);
+	entry->next = poller->entries;
+	poller->entries = entry;
+	dev->poller = poller;
+	dev->poller_entry = entry;
 
-	if (dev->device_handle >= 0) {
-		int res, desc_size = 0;
+	register_global_error(NULL);
+	return 0;
+}
 
-		/* Make sure this is a HIDRAW device - responds to HIDIOCGRDESCSIZE */
-		res = ioctl(dev->device_handle, HIDIOCGRDESCSIZE, &desc_size);
-		if (res < 0) {
-			hid_close(dev);
-			register_device_error_format(dev, "ioctl(GRDESCSIZE) error for '%s', not a HIDRAW device?: %s", path, strerror(errno));
-			return NULL;
-		}
+static void poller_free_entry(hid_poller *poller, struct hid_poller_entry *entry)
+{
+	struct hid_poller_entry **cur = &poller->entries;
+	while (*cur != entry)
+		cur = &(*cur)->next;
+	*cur = entry->next;
+	free(entry);
+}
 
-		return dev;
+int HID_API_EXPORT HID_API_CALL hid_poller_remove(hid_poller *poller, hid_device *dev)
+{
+	struct hid_poller_entry *entry;
+
+	if (!poller || !dev || dev->poller != poller) {
+		errno = EINVAL;
+		register_global_error(strerror(errno));
+		return -1;
+	}
+
+	entry = dev->poller_entry;
+	epoll_ctl(poller->epoll_fd, EPOLL_CTL_DEL, get_input_fd(dev), NULL);
+	dev->poller = NULL;
+	dev->poller_entry = NULL;
+
+	/* hid_poller_run() may still hold events pointing to the entry */
+	if (poller->running) {
+		entry->removed = 1;
+		entry->dev = NULL;
 	}
 	else {
-		/* Unable to open a device. */
-		free(dev);
-		register_global_error_format("Failed to open a device with path '%s': %s", path, strerror(errno));
-		return NULL;
+		poller_free_entry(poller, entry);
 	}
-}
 
+	register_global_error(NULL);
+	return 0;
+}
 
-int HID_API_EXPORT hid_write(hid_device *dev, const unsigned char *data, size_t length)
+int HID_API_EXPORT HID_API_CALL hid_poller_run(hid_poller *poller, int milliseconds)
 {
-	int bytes_written;
+	struct epoll_event events[HIDRAW_POLLER_EVENTS];
+	struct hid_poller_entry **cur;
+	int count = 0;
+	int n;
 
-	if (!data || (length == 0)) {
+	if (!poller) {
 		errno = EINVAL;
-		register_device_error(dev, strerror(errno));
+		register_global_error(strerror(errno));
 		return -1;
 	}
 
-	bytes_written = write(dev->device_handle, data, length);
+	register_global_error(NULL);
 
-	register_device_error(dev, (bytes_written == -1)? strerror(errno): NULL);
+	n = epoll_wait(poller->epoll_fd, events, HIDRAW_POLLER_EVENTS, milliseconds);
+	if (n == -1) {
+		if (errno == EINTR)
+			return 0;
+		register_global_error_format("epoll_wait: %s", strerror(errno));
+		return -1;
+	}
 
-	return bytes_written;
-}
+	poller->running = 1;
 
+	for (int i = 0; i < n; i++) {
+		struct hid_poller_entry *entry = (struct hid_poller_entry*) events[i].data.ptr;
+		hid_device *dev = entry->dev;
+		int res;
 
-int HID_API_EXPORT hid_read_timeout(hid_device *dev, unsigned char *data, size_t length, int milliseconds)
-{
-	/* Set device error to none */
-	register_device_error(dev, NULL);
+		if (entry->removed)
+			continue;
 
-	int bytes_read;
+		/* Read until nothing is left: with an input queue, the
+		   descriptor isn't readable anymore while reports remain queued. */
+		do {
+			res = hid_read_batch(dev, poller->buffer, HIDRAW_POLLER_REPORT_SIZE, HIDRAW_POLLER_BATCH, poller->lengths, 0);
+			if (res < 0) {
+				/* Most likely the device was disconnected */
+				hid_poller_remove(poller, dev);
+				entry->callback(dev, NULL, 0, entry->user_data);
+				break;
+			}
 
-	if (milliseconds >= 0) {
-		/* Milliseconds is either 0 (non-blocking) or > 0 (contains
-		   a valid timeout). In both cases we want to call poll()
-		   and wait for data to arrive.  Don't rely on non-blocking
-		   operation (O_NONBLOCK) since some kernels don't seem to
-		   properly report device disconnection through read() when
-		   in non-blocking mode.  */
-		int ret;
-		struct pollfd fds;
+			for (int j = 0; j < res && !entry->removed; j++) {
+				entry->callback(dev, poller->buffer + j * HIDRAW_POLLER_REPORT_SIZE, poller->lengths[j], entry->user_data);
+				count++;
+			}
+		} while (res == HIDRAW_POLLER_BATCH && !entry->removed);
+	}
 
-		fds.fd = dev->device_handle;
-		fds.events = POLLIN;
-		fds.revents = 0;
-		ret = poll(&fds, 1, milliseconds);
-		if (ret == 0) {
-			/* Timeout */
-			return ret;
-		}
-		if (ret == -1) {
-			/* Error */
-			register_device_error(dev, strerror(errno));
-			return ret;
+	poller->running = 0;
+
+	/* Free the entries removed by the callbacks */
+	cur = &poller->entries;
+	while (*cur) {
+		struct hid_poller_entry *entry = *cur;
+		if (entry->removed) {
+			*cur = entry->next;
+			free(entry);
 		}
 		else {
-			/* Check for errors on the file descriptor. This will
-			   indicate a device disconnection. */
-			if (fds.revents & (POLLERR | POLLHUP | POLLNVAL)) {
-				// We cannot use strerror() here as no -1 was returned from poll().
-				register_device_error(dev, "hid_read_timeout: unexpected poll error (device disconnected)");
-				return -1;
-			}
+			cur = &entry->next;
 		}
 	}
 
-	bytes_read = read(dev->device_handle, data, length);
-	if (bytes_read < 0) {
-		if (errno == EAGAIN || errno == EINPROGRESS)
-			bytes_read = 0;
-		else
-			register_device_error(dev, strerror(errno));
-	}
-
-	return bytes_read;
+	return count;
 }
 
-int HID_API_EXPORT hid_read(hid_device *dev, unsigned char *data, size_t length)
+void HID_API_EXPORT HID_API_CALL hid_poller_free(hid_poller *poller)
 {
-	return hid_read_timeout(dev, data, length, (dev->blocking)? -1: 0);
-}
+	if (!poller)
+		return;
 
-int HID_API_EXPORT hid_set_nonblocking(hid_device *dev, int nonblock)
-{
-	/* Do all non-blocking in userspace using poll(), since it looks
-	   like there's a bug in the kernel in some versions where
-	   read() will not return -1 on disconnection of the USB device */
+	while (poller->entries)
+		hid_poller_remove(poller, poller->entries->dev);
 
-	dev->blocking = !nonblock;
-	return 0; /* Success */
+	close(poller->epoll_fd);
+	free(poller->buffer);
+	free(poller);
 }
 
 
@@ -1130,12 +3022,30 @@ void HID_API_EXPORT hid_close(hid_device *dev)
 	if (!dev)
 		return;
 
+	if (dev->poller)
+		hid_poller_remove(dev->poller, dev);
+
+#ifdef HIDAPI_USE_IO_URING
+	if (dev->uring_bgid >= 0)
+		uring_detach_device(dev);
+#endif
+
 	close(dev->device_handle);
 
+	free_input_queue(dev->input_queue);
+	if (dev->report_id_queues) {
+		int i;
+		for (i = 0; i < 256; i++)
+			free_input_queue(dev->report_id_queues[i]);
+		free(dev->report_id_queues);
+	}
+
 	/* Free the device error message */
 	register_device_error(dev, NULL);
 
-	hid_free_enumeration(dev->device_info);
+	hidapi_free_device_info_list(dev->device_info);
+	free(dev->report_layout);
+	free(dev->report_descriptor);
 
 	free(dev);
 }
@@ -1224,6 +3134,81 @@ HID_API_EXPORT struct hid_device_info *HID_API_CALL hid_get_device_info(hid_devi
 	return dev->device_info;
 }
 
+/* Reads the report descriptor of the device, only once */
+static int cache_report_descriptor(hid_device *dev)
+{
+	struct hidraw_report_descriptor rpt_desc;
+	int desc_size = 0;
+
+	if (dev->report_descriptor)
+		return 0;
+
+	if (ioctl(dev->device_handle, HIDIOCGRDESCSIZE, &desc_size) < 0) {
+		register_device_error_format(dev, "ioctl (GRDESCSIZE): %s", strerror(errno));
+		return -1;
+	}
+
+	rpt_desc.size = desc_size;
+	if (ioctl(dev->device_handle, HIDIOCGRDESC, &rpt_desc) < 0) {
+		register_device_error_format(dev, "ioctl (GRDESC): %s", strerror(errno));
+		return -1;
+	}
+
+	dev->report_descriptor = (unsigned char*) malloc(rpt_desc.size? rpt_desc.size: 1);
+	if (!dev->report_descriptor) {
+		register_device_error(dev, "Couldn't allocate memory");
+		return -1;
+	}
+	memcpy(dev->report_descriptor, rpt_desc.value, rpt_desc.size);
+	dev->report_descriptor_size = rpt_desc.size;
+
+	return 0;
+}
+
+int HID_API_EXPORT_CALL hid_get_report_descriptor(hid_device *dev, unsigned char *buf, size_t buf_size)
+{
+	size_t copy_len;
+
+	register_device_error(dev, NULL);
+
+	if (cache_report_descriptor(dev) < 0)
+		return -1;
+
+	copy_len = dev->report_descriptor_size;
+	if (copy_len > buf_size)
+		copy_len = buf_size;
+	memcpy(buf, dev->report_descriptor, copy_len);
+
+	return (int) copy_len;
+}
+
+HID_API_EXPORT const struct hid_report_layout * HID_API_CALL hid_get_report_layout(hid_device *dev)
+{
+	if (dev->report_layout)
+		return dev->report_layout;
+
+	register_device_error(dev, NULL);
+
+	if (cache_report_descriptor(dev) < 0)
+		return NULL;
+
+	dev->report_layout = hidapi_compile_report_layout(dev->report_descriptor, dev->report_descriptor_size);
+	if (!dev->report_layout) {
+		register_device_error(dev, (errno == EINVAL)? "Malformed report descriptor": "Couldn't allocate memory");
+		return NULL;
+	}
+
+	return dev->report_layout;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_decode_report(const struct hid_report_layout *layout, const unsigned char *report, size_t length, int *values, size_t max_values)
+{
+	int res = hidapi_decode_report(layout, report, length, values, max_values);
+	if (res < 0)
+		register_global_error("No matching Input report in the layout, or not enough values");
+	return res;
+}
+
 int HID_API_EXPORT_CALL hid_get_indexed_string(hid_device *dev, int string_index, wchar_t *string, size_t maxlen)
 {
 	(void)string_index;
@@ -34,8 +34,10 @@
 #include <sys/time.h>
 #include <unistd.h>
 #include <dlfcn.h>
+#include <errno.h>
 
 #include "hidapi_darwin.h"
+#include "hidapi_report_descriptor.h"
 
 /* As defined in AppKit.h, but we don't need the entire AppKit for a single constant. */
 extern const double NSAppKitVersionNumber;
@@ -134,6 +136,7 @@ struct hid_device_ {
 	CFIndex max_input_report_len;
 	struct input_report *input_reports;
 	struct hid_device_info* device_info;
+	struct hid_report_layout *report_layout; /* Compiled at the first hid_get_report_layout() */
 
 	pthread_t thread;
 	pthread_mutex_t mutex; /* Protects input_reports */
@@ -196,6 +199,7 @@ static void free_hid_device(hid_device *dev)
 		CFRelease(dev->source);
 	free(dev->input_report_buf);
 	hid_free_enumeration(dev->device_info);
+	free(dev->report_layout);
 
 	/* Clean up the thread objects */
 	pthread_barrier_destroy(&dev->shutdown_barrier);
@@ -466,13 +470,61 @@ static void process_pending_events(void) {
 	} while(res != kCFRunLoopRunFinished && res != kCFRunLoopRunTimedOut);
 }
 
-static struct hid_device_info *create_device_info_with_usage(IOHIDDeviceRef dev, int32_t usage_page, int32_t usage)
+/* Matches all the devices */
+static const struct hid_enum_filter enum_filter_all;
+
+static int usage_matches_filter(const struct hid_enum_filter *filter, int32_t usage_page, int32_t usage)
+{
+	return (filter->usage_page == 0 || filter->usage_page == usage_page)
+	    && (filter->usage == 0 || filter->usage == usage);
+}
+
+static int serial_number_matches_filter(const struct hid_enum_filter *filter, const wchar_t *serial_number)
+{
+	if (!filter->serial_number_prefix)
+		return 1;
+	return wcsncmp(serial_number, filter->serial_number_prefix, wcslen(filter->serial_number_prefix)) == 0;
+}
+
+static int get_interface_number(IOHIDDeviceRef dev)
+{
+	/* We can only retrieve the interface number for USB HID devices.
+	 * IOKit always seems to return 0 when querying a standard USB device
+	 * for its interface. */
+	int is_usb_hid = get_int_property(dev, CFSTR(kUSBInterfaceClass)) == kUSBHIDClass;
+	if (is_usb_hid) {
+		/* Get the interface number */
+		return get_int_property(dev, CFSTR(kUSBInterfaceNumber));
+	}
+	return -1;
+}
+
+static hid_bus_type get_bus_type(IOHIDDeviceRef dev)
+{
+	CFTypeRef transport_prop = IOHIDDeviceGetProperty(dev, CFSTR(kIOHIDTransportKey));
+
+	if (transport_prop != NULL && CFGetTypeID(transport_prop) == CFStringGetTypeID()) {
+		if (CFStringCompare((CFStringRef)transport_prop, CFSTR(kIOHIDTransportUSBValue), 0) == kCFCompareEqualTo) {
+			return HID_API_BUS_USB;
+		/* Match "Bluetooth", "BluetoothLowEnergy" and "Bluetooth Low Energy" strings */
+		} else if (CFStringHasPrefix((CFStringRef)transport_prop, CFSTR(kIOHIDTransportBluetoothValue))) {
+			return HID_API_BUS_BLUETOOTH;
+		} else if (CFStringCompare((CFStringRef)transport_prop, CFSTR(kIOHIDTransportI2CValue), 0) == kCFCompareEqualTo) {
+			return HID_API_BUS_I2C;
+		} else  if (CFStringCompare((CFStringRef)transport_prop, CFSTR(kIOHIDTransportSPIValue), 0) == kCFCompareEqualTo) {
+			return HID_API_BUS_SPI;
+		}
+	}
+
+	return HID_API_BUS_UNKNOWN;
+}
+
+static struct hid_device_info *create_device_info_with_usage(IOHIDDeviceRef dev, int32_t usage_page, int32_t usage, const struct hid_enum_filter *filter)
 {
 	unsigned short dev_vid;
 	unsigned short dev_pid;
 	int BUF_LEN = 256;
 	wchar_t buf[BUF_LEN];
-	CFTypeRef transport_prop;
 
 	struct hid_device_info *cur_dev;
 	io_object_t iokit_dev;
@@ -523,14 +575,18 @@ static struct hid_device_info *create_device_info_with_usage(IOHIDDeviceRef dev,
 	}
 
 	/* Serial Number */
-	get_serial_number(dev, buf, BUF_LEN);
-	cur_dev->serial_number = dup_wcs(buf);
+	if (!(filter->flags & HID_API_ENUM_SKIP_STRINGS) || filter->serial_number_prefix) {
+		get_serial_number(dev, buf, BUF_LEN);
+		cur_dev->serial_number = dup_wcs(buf);
+	}
 
 	/* Manufacturer and Product strings */
-	get_manufacturer_string(dev, buf, BUF_LEN);
-	cur_dev->manufacturer_string = dup_wcs(buf);
-	get_product_string(dev, buf, BUF_LEN);
-	cur_dev->product_string = dup_wcs(buf);
+	if (!(filter->flags & HID_API_ENUM_SKIP_STRINGS)) {
+		get_manufacturer_string(dev, buf, BUF_LEN);
+		cur_dev->manufacturer_string = dup_wcs(buf);
+		get_product_string(dev, buf, BUF_LEN);
+		cur_dev->product_string = dup_wcs(buf);
+	}
 
 	/* VID/PID */
 	cur_dev->vendor_id = dev_vid;
@@ -540,48 +596,47 @@ static struct hid_device_info *create_device_info_with_usage(IOHIDDeviceRef dev,
 	cur_dev->release_number = get_int_property(dev, CFSTR(kIOHIDVersionNumberKey));
 
 	/* Interface Number */
-	/* We can only retrieve the interface number for USB HID devices.
-	 * IOKit always seems to return 0 when querying a standard USB device
-	 * for its interface. */
-	int is_usb_hid = get_int_property(dev, CFSTR(kUSBInterfaceClass)) == kUSBHIDClass;
-	if (is_usb_hid) {
-		/* Get the interface number */
-		cur_dev->interface_number = get_int_property(dev, CFSTR(kUSBInterfaceNumber));
-	} else {
-		cur_dev->interface_number = -1;
-	}
+	cur_dev->interface_number = get_interface_number(dev);
 
 	/* Bus Type */
-	transport_prop = IOHIDDeviceGetProperty(dev, CFSTR(kIOHIDTransportKey));
-
-	if (transport_prop != NULL && CFGetTypeID(transport_prop) == CFStringGetTypeID()) {
-		if (CFStringCompare((CFStringRef)transport_prop, CFSTR(kIOHIDTransportUSBValue), 0) == kCFCompareEqualTo) {
-			cur_dev->bus_type = HID_API_BUS_USB;
-		/* Match "Bluetooth", "BluetoothLowEnergy" and "Bluetooth Low Energy" strings */
-		} else if (CFStringHasPrefix((CFStringRef)transport_prop, CFSTR(kIOHIDTransportBluetoothValue))) {
-			cur_dev->bus_type = HID_API_BUS_BLUETOOTH;
-		} else if (CFStringCompare((CFStringRef)transport_prop, CFSTR(kIOHIDTransportI2CValue), 0) == kCFCompareEqualTo) {
-			cur_dev->bus_type = HID_API_BUS_I2C;
-		} else  if (CFStringCompare((CFStringRef)transport_prop, CFSTR(kIOHIDTransportSPIValue), 0) == kCFCompareEqualTo) {
-			cur_dev->bus_type = HID_API_BUS_SPI;
-		}
-	}
+	cur_dev->bus_type = get_bus_type(dev);
 
 	return cur_dev;
 }
 
-static struct hid_device_info *create_device_info(IOHIDDeviceRef device)
+/* Creates the records of a device matching the filter (the VID/PID
+   are matched by the HID Manager already), the properties are
+   checked before any string is copied */
+static struct hid_device_info *create_device_info(IOHIDDeviceRef device, const struct hid_enum_filter *filter)
 {
 	const int32_t primary_usage_page = get_int_property(device, CFSTR(kIOHIDPrimaryUsagePageKey));
 	const int32_t primary_usage = get_int_property(device, CFSTR(kIOHIDPrimaryUsageKey));
 
-	/* Primary should always be first, to match previous behavior. */
-	struct hid_device_info *root = create_device_info_with_usage(device, primary_usage_page, primary_usage);
-	struct hid_device_info *cur = root;
+	struct hid_device_info *root = NULL;
+	struct hid_device_info *cur = NULL;
+
+	if (filter->bus_type != HID_API_BUS_UNKNOWN && filter->bus_type != get_bus_type(device))
+		return NULL;
 
-	if (!root)
+	if ((filter->flags & HID_API_ENUM_MATCH_INTERFACE) && filter->interface_number != get_interface_number(device))
 		return NULL;
 
+	if (filter->serial_number_prefix) {
+		wchar_t buf[256];
+		get_serial_number(device, buf, sizeof(buf) / sizeof(buf[0]));
+		if (!serial_number_matches_filter(filter, buf))
+			return NULL;
+	}
+
+	if ((filter->flags & HID_API_ENUM_SKIP_USAGES) && filter->usage_page == 0 && filter->usage == 0)
+		return create_device_info_with_usage(device, 0, 0, filter);
+
+	/* Primary should always be first, to match previous behavior. */
+	if (usage_matches_filter(filter, primary_usage_page, primary_usage)) {
+		root = create_device_info_with_usage(device, primary_usage_page, primary_usage, filter);
+		cur = root;
+	}
+
 	CFArrayRef usage_pairs = get_usage_pairs(device);
 
 	if (usage_pairs != NULL) {
@@ -605,12 +660,20 @@ static struct hid_device_info *create_device_info(IOHIDDeviceRef device)
 			}
 			if (usage_page == primary_usage_page && usage == primary_usage)
 				continue; /* Already added. */
+			if (!usage_matches_filter(filter, usage_page, usage))
+				continue;
+
+			next = create_device_info_with_usage(device, usage_page, usage, filter);
+			if (next == NULL)
+				continue;
 
-			next = create_device_info_with_usage(device, usage_page, usage);
-			cur->next = next;
-			if (next != NULL) {
-				cur = next;
+			if (cur) {
+				cur->next = next;
+			}
+			else {
+				root = next;
 			}
+			cur = next;
 		}
 	}
 
@@ -618,6 +681,17 @@ static struct hid_device_info *create_device_info(IOHIDDeviceRef device)
 }
 
 struct hid_device_info  HID_API_EXPORT *hid_enumerate(unsigned short vendor_id, unsigned short product_id)
+{
+	struct hid_enum_filter filter;
+
+	memset(&filter, 0, sizeof(filter));
+	filter.vendor_id = vendor_id;
+	filter.product_id = product_id;
+
+	return hid_enumerate_ex(&filter);
+}
+
+struct hid_device_info  HID_API_EXPORT *hid_enumerate_ex(const struct hid_enum_filter *filter)
 {
 	struct hid_device_info *root = NULL; /* return object */
 	struct hid_device_info *cur_dev = NULL;
@@ -630,25 +704,41 @@ struct hid_device_info  HID_API_EXPORT *hid_enumerate(unsigned short vendor_id,
 	}
 	/* register_global_error: global error is set/reset by hid_init */
 
+	if (!filter)
+		filter = &enum_filter_all;
+
 	/* give the IOHIDManager a chance to update itself */
 	process_pending_events();
 
-	/* Get a list of the Devices */
+	/* Get a list of the Devices,
+	   the HID Manager matches the VID/PID and any of the usage pairs */
 	CFMutableDictionaryRef matching = NULL;
-	if (vendor_id != 0 || product_id != 0) {
+	if (filter->vendor_id != 0 || filter->product_id != 0 || filter->usage_page != 0) {
 		matching = CFDictionaryCreateMutable(kCFAllocatorDefault, kIOHIDOptionsTypeNone, &kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks);
 
-		if (matching && vendor_id != 0) {
-			CFNumberRef v = CFNumberCreate(kCFAllocatorDefault, kCFNumberShortType, &vendor_id);
+		if (matching && filter->vendor_id != 0) {
+			CFNumberRef v = CFNumberCreate(kCFAllocatorDefault, kCFNumberShortType, &filter->vendor_id);
 			CFDictionarySetValue(matching, CFSTR(kIOHIDVendorIDKey), v);
 			CFRelease(v);
 		}
 
-		if (matching && product_id != 0) {
-			CFNumberRef p = CFNumberCreate(kCFAllocatorDefault, kCFNumberShortType, &product_id);
+		if (matching && filter->product_id != 0) {
+			CFNumberRef p = CFNumberCreate(kCFAllocatorDefault, kCFNumberShortType, &filter->product_id);
 			CFDictionarySetValue(matching, CFSTR(kIOHIDProductIDKey), p);
 			CFRelease(p);
 		}
+
+		if (matching && filter->usage_page != 0) {
+			CFNumberRef p = CFNumberCreate(kCFAllocatorDefault, kCFNumberShortType, &filter->usage_page);
+			CFDictionarySetValue(matching, CFSTR(kIOHIDDeviceUsagePageKey), p);
+			CFRelease(p);
+
+			if (filter->usage != 0) {
+				CFNumberRef u = CFNumberCreate(kCFAllocatorDefault, kCFNumberShortType, &filter->usage);
+				CFDictionarySetValue(matching, CFSTR(kIOHIDDeviceUsageKey), u);
+				CFRelease(u);
+			}
+		}
 	}
 	IOHIDManagerSetDeviceMatching(hid_mgr, matching);
 	if (matching != NULL) {
@@ -676,7 +766,7 @@ struct hid_device_info  HID_API_EXPORT *hid_enumerate(unsigned short vendor_id,
 			continue;
 		}
 
-		struct hid_device_info *tmp = create_device_info(dev);
+		struct hid_device_info *tmp = create_device_info(dev, filter);
 		if (tmp == NULL) {
 			continue;
 		}
@@ -700,7 +790,10 @@ struct hid_device_info  HID_API_EXPORT *hid_enumerate(unsigned short vendor_id,
 		CFRelease(device_set);
 
 	if (root == NULL) {
-		if (vendor_id == 0 && product_id == 0) {
+		if (filter->usage_page != 0 || filter->usage != 0 || filter->bus_type != HID_API_BUS_UNKNOWN
+		 || (filter->flags & HID_API_ENUM_MATCH_INTERFACE) || filter->serial_number_prefix) {
+			register_global_error("No HID devices matching the filter found in the system.");
+		} else if (filter->vendor_id == 0 && filter->product_id == 0) {
 			register_global_error("No HID devices found in the system.");
 		} else {
 			register_global_error("No HID devices with requested VID/PID found in the system.");
@@ -710,6 +803,31 @@ struct hid_device_info  HID_API_EXPORT *hid_enumerate(unsigned short vendor_id,
 	return root;
 }
 
+int HID_API_EXPORT HID_API_CALL hid_enumerate_each(const struct hid_enum_filter *filter, hid_enumerate_callback_fn callback, void *user_data)
+{
+	struct hid_device_info *devs;
+	struct hid_device_info *info;
+	struct hid_device_info *next;
+	int stop = 0;
+
+	if (!callback) {
+		register_global_error("callback is NULL");
+		return -1;
+	}
+
+	/* The list is read at once, then reported one record at a time */
+	devs = hid_enumerate_ex(filter);
+	for (info = devs; info && !stop; info = next) {
+		next = info->next;
+		info->next = NULL;
+		stop = callback(info, user_data);
+		info->next = next;
+	}
+	hid_free_enumeration(devs);
+
+	return 0;
+}
+
 void  HID_API_EXPORT hid_free_enumeration(struct hid_device_info *devs)
 {
 	/* This function is identical to the Linux version. Platform independent. */
@@ -725,16 +843,65 @@ void  HID_API_EXPORT hid_free_enumeration(struct hid_device_info *devs)
 	}
 }
 
+int HID_API_EXPORT HID_API_CALL hid_hotplug_register_callback(unsigned short vendor_id, unsigned short product_id, int events, int flags, hid_hotplug_callback_fn callback, void *user_data, hid_hotplug_callback_handle *callback_handle)
+{
+	(void) vendor_id;
+	(void) product_id;
+	(void) events;
+	(void) flags;
+	(void) callback;
+	(void) user_data;
+	(void) callback_handle;
+
+	register_global_error("hid_hotplug_register_callback is not supported on this platform");
+	return -1;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_hotplug_deregister_callback(hid_hotplug_callback_handle callback_handle)
+{
+	(void) callback_handle;
+
+	/* No callback can be registered */
+	return -1;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_set_enumeration_cache(int enable)
+{
+	if (!enable)
+		return 0;
+
+	/* Needs hid_hotplug_register_callback() */
+	register_global_error("hid_set_enumeration_cache is not supported on this platform");
+	return -1;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_set_enumeration_threads(int num_threads, int timeout_ms)
+{
+	if (num_threads <= 1 && timeout_ms < 0)
+		return 0;
+
+	register_global_error("hid_set_enumeration_threads is not supported on this platform");
+	return -1;
+}
+
 hid_device * HID_API_EXPORT hid_open(unsigned short vendor_id, unsigned short product_id, const wchar_t *serial_number)
 {
 	/* This function is identical to the Linux version. Platform independent. */
 
 	struct hid_device_info *devs, *cur_dev;
+	struct hid_enum_filter filter;
 	const char *path_to_open = NULL;
 	hid_device * handle = NULL;
 
+	/* Only the path (and the serial number) is needed */
+	memset(&filter, 0, sizeof(filter));
+	filter.vendor_id = vendor_id;
+	filter.product_id = product_id;
+	filter.serial_number_prefix = serial_number;
+	filter.flags = HID_API_ENUM_SKIP_STRINGS | HID_API_ENUM_SKIP_USAGES;
+
 	/* register_global_error: global error is reset by hid_enumerate/hid_init */
-	devs = hid_enumerate(vendor_id, product_id);
+	devs = hid_enumerate_ex(&filter);
 	if (devs == NULL) {
 		/* register_global_error: global error is already set by hid_enumerate */
 		return NULL;
@@ -1242,6 +1409,29 @@ int HID_API_EXPORT hid_read(hid_device *dev, unsigned char *data, size_t length)
 	return hid_read_timeout(dev, data, length, (dev->blocking)? -1: 0);
 }
 
+int HID_API_EXPORT hid_read_batch(hid_device *dev, unsigned char *data, size_t stride, size_t max_reports, size_t *lengths, int milliseconds)
+{
+	size_t count = 0;
+	int res;
+
+	if (!data || !stride || !lengths || !max_reports) {
+		register_device_error(dev, "Zero buffer/length");
+		return -1;
+	}
+
+	/* Only the first report is waited for, the rest are
+	   the ones which are already queued up. */
+	res = hid_read_timeout(dev, data, stride, milliseconds);
+	while (res > 0) {
+		lengths[count++] = (size_t) res;
+		if (count == max_reports)
+			break;
+		res = hid_read_timeout(dev, data + count * stride, stride, 0);
+	}
+
+	return (count > 0)? (int) count: res;
+}
+
 int HID_API_EXPORT hid_set_nonblocking(hid_device *dev, int nonblock)
 {
 	/* All Nonblocking operation is handled by the library. */
@@ -1250,6 +1440,83 @@ int HID_API_EXPORT hid_set_nonblocking(hid_device *dev, int nonblock)
 	return 0;
 }
 
+int HID_API_EXPORT HID_API_CALL hid_get_pollable_fd(hid_device *dev)
+{
+	register_device_error(dev, "hid_get_pollable_fd is not supported on this platform");
+	return -1;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_set_input_queue(hid_device *dev, size_t max_reports, size_t max_bytes, hid_queue_policy policy)
+{
+	(void) max_reports;
+	(void) max_bytes;
+	(void) policy;
+	register_device_error(dev, "hid_set_input_queue is not supported on this platform");
+	return -1;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_get_dropped_reports(hid_device *dev, unsigned long long *count)
+{
+	(void) count;
+	register_device_error(dev, "hid_get_dropped_reports is not supported on this platform");
+	return -1;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_set_report_id_queue(hid_device *dev, unsigned char report_id, size_t max_reports)
+{
+	(void) report_id;
+	(void) max_reports;
+	register_device_error(dev, "hid_set_report_id_queue is not supported on this platform");
+	return -1;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_read_report_id(hid_device *dev, unsigned char report_id, unsigned char *data, size_t length, int milliseconds)
+{
+	(void) report_id;
+	(void) data;
+	(void) length;
+	(void) milliseconds;
+	register_device_error(dev, "hid_read_report_id is not supported on this platform");
+	return -1;
+}
+
+hid_poller HID_API_EXPORT * HID_API_CALL hid_poller_new(void)
+{
+	register_global_error("hid_poller is not supported on this platform");
+	return NULL;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_poller_add(hid_poller *poller, hid_device *dev, hid_poller_callback callback, void *user_data)
+{
+	(void) poller;
+	(void) dev;
+	(void) callback;
+	(void) user_data;
+	register_global_error("hid_poller is not supported on this platform");
+	return -1;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_poller_remove(hid_poller *poller, hid_device *dev)
+{
+	(void) poller;
+	(void) dev;
+	register_global_error("hid_poller is not supported on this platform");
+	return -1;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_poller_run(hid_poller *poller, int milliseconds)
+{
+	(void) poller;
+	(void) milliseconds;
+	register_global_error("hid_poller is not supported on this platform");
+	return -1;
+}
+
+void HID_API_EXPORT HID_API_CALL hid_poller_free(hid_poller *poller)
+{
+	(void) poller;
+}
+
 int HID_API_EXPORT hid_send_feature_report(hid_device *dev, const unsigned char *data, size_t length)
 {
 	return set_report(dev, kIOHIDReportTypeFeature, data, length);
@@ -1380,7 +1647,7 @@ int HID_API_EXPORT_CALL hid_get_serial_number_string(hid_device *dev, wchar_t *s
 
 HID_API_EXPORT struct hid_device_info *HID_API_CALL hid_get_device_info(hid_device *dev) {
 	if (!dev->device_info) {
-		dev->device_info = create_device_info(dev->device_handle);
+		dev->device_info = create_device_info(dev->device_handle, &enum_filter_all);
 		if (!dev->device_info) {
 			register_device_error(dev, "Failed to create hid_device_info");
 		}
@@ -1389,6 +1656,65 @@ HID_API_EXPORT struct hid_device_info *HID_API_CALL hid_get_device_info(hid_devi
 	return dev->device_info;
 }
 
+int HID_API_EXPORT_CALL hid_get_report_descriptor(hid_device *dev, unsigned char *buf, size_t buf_size)
+{
+	/* IOKit keeps the descriptor with the device, no copy is needed */
+	CFTypeRef ref = IOHIDDeviceGetProperty(dev->device_handle, CFSTR(kIOHIDReportDescriptorKey));
+	if (ref != NULL && CFGetTypeID(ref) == CFDataGetTypeID()) {
+		CFDataRef report_descriptor = (CFDataRef) ref;
+		const UInt8 *descriptor_buf = CFDataGetBytePtr(report_descriptor);
+		CFIndex descriptor_buf_len = CFDataGetLength(report_descriptor);
+		size_t copy_len = (size_t) descriptor_buf_len;
+
+		if (descriptor_buf == NULL || descriptor_buf_len < 0) {
+			register_device_error(dev, "Zero buffer/length");
+			return -1;
+		}
+
+		if (buf_size < copy_len) {
+			copy_len = buf_size;
+		}
+
+		memcpy(buf, descriptor_buf, copy_len);
+		return (int) copy_len;
+	}
+	else {
+		register_device_error(dev, "Failed to get kIOHIDReportDescriptorKey property");
+		return -1;
+	}
+}
+
+HID_API_EXPORT const struct hid_report_layout * HID_API_CALL hid_get_report_layout(hid_device *dev)
+{
+	CFTypeRef ref;
+
+	if (dev->report_layout)
+		return dev->report_layout;
+
+	ref = IOHIDDeviceGetProperty(dev->device_handle, CFSTR(kIOHIDReportDescriptorKey));
+	if (ref == NULL || CFGetTypeID(ref) != CFDataGetTypeID()) {
+		register_device_error(dev, "Failed to get kIOHIDReportDescriptorKey property");
+		return NULL;
+	}
+
+	dev->report_layout = hidapi_compile_report_layout(CFDataGetBytePtr((CFDataRef) ref), (size_t) CFDataGetLength((CFDataRef) ref));
+	if (!dev->report_layout) {
+		register_device_error(dev, (errno == EINVAL)? "Malformed report descriptor": "Couldn't allocate memory");
+		return NULL;
+	}
+
+	register_device_error(dev, NULL);
+	return dev->report_layout;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_decode_report(const struct hid_report_layout *layout, const unsigned char *report, size_t length, int *values, size_t max_values)
+{
+	int res = hidapi_decode_report(layout, report, length, values, max_values);
+	if (res < 0)
+		register_global_error("No matching Input report in the layout, or not enough values");
+	return res;
+}
+
 int HID_API_EXPORT_CALL hid_get_indexed_string(hid_device *dev, int string_index, wchar_t *string, size_t maxlen)
 {
 	(void) dev;
@@ -586,7 +586,27 @@ static wchar_t *hid_internal_UTF8toUTF16(const char *src)
 	return dst;
 }
 
-static struct hid_device_info *hid_internal_get_device_info(const wchar_t *path, HANDLE handle)
+/* Matches all the devices */
+static const struct hid_enum_filter enum_filter_all;
+
+static int usage_matches_filter(const struct hid_enum_filter *filter, unsigned short usage_page, unsigned short usage)
+{
+	return (filter->usage_page == 0 || filter->usage_page == usage_page)
+	    && (filter->usage == 0 || filter->usage == usage);
+}
+
+static int serial_number_matches_filter(const struct hid_enum_filter *filter, const wchar_t *serial_number)
+{
+	if (!filter->serial_number_prefix)
+		return 1;
+	return serial_number
+	    && wcsncmp(serial_number, filter->serial_number_prefix, wcslen(filter->serial_number_prefix)) == 0;
+}
+
+/* Creates the record of a device matching the filter (except for the VID/PID).
+   The criteria known from the device nodes are checked first,
+   then the ones which have to be requested from the device itself. */
+static struct hid_device_info *hid_internal_get_device_info(const wchar_t *path, HANDLE handle, const struct hid_enum_filter *filter)
 {
 	struct hid_device_info *dev = NULL; /* return object */
 	HIDD_ATTRIBUTES attrib;
@@ -611,40 +631,86 @@ static struct hid_device_info *hid_internal_get_device_info(const wchar_t *path,
 		dev->release_number = attrib.VersionNumber;
 	}
 
+	/* Interface number and bus type (and the strings of Bluetooth LE devices) */
+	hid_internal_get_info(path, dev);
+
+	if ((filter->bus_type != HID_API_BUS_UNKNOWN && filter->bus_type != dev->bus_type)
+	 || ((filter->flags & HID_API_ENUM_MATCH_INTERFACE) && filter->interface_number != dev->interface_number))
+		goto reject;
+
 	/* Get the Usage Page and Usage for this device. */
-	if (HidD_GetPreparsedData(handle, &pp_data)) {
-		if (HidP_GetCaps(pp_data, &caps) == HIDP_STATUS_SUCCESS) {
-			dev->usage_page = caps.UsagePage;
-			dev->usage = caps.Usage;
+	if (!(filter->flags & HID_API_ENUM_SKIP_USAGES) || filter->usage_page != 0 || filter->usage != 0) {
+		if (HidD_GetPreparsedData(handle, &pp_data)) {
+			if (HidP_GetCaps(pp_data, &caps) == HIDP_STATUS_SUCCESS) {
+				dev->usage_page = caps.UsagePage;
+				dev->usage = caps.Usage;
+			}
+
+			HidD_FreePreparsedData(pp_data);
 		}
 
-		HidD_FreePreparsedData(pp_data);
+		if (!usage_matches_filter(filter, dev->usage_page, dev->usage))
+			goto reject;
 	}
 
 	/* Serial Number */
-	string[0] = L'\0';
-	HidD_GetSerialNumberString(handle, string, sizeof(string));
-	string[MAX_STRING_WCHARS - 1] = L'\0';
-	dev->serial_number = _wcsdup(string);
+	if (!dev->serial_number && (!(filter->flags & HID_API_ENUM_SKIP_STRINGS) || filter->serial_number_prefix)) {
+		string[0] = L'\0';
+		HidD_GetSerialNumberString(handle, string, sizeof(string));
+		string[MAX_STRING_WCHARS - 1] = L'\0';
+		dev->serial_number = _wcsdup(string);
+	}
+
+	if (!serial_number_matches_filter(filter, dev->serial_number))
+		goto reject;
+
+	if (filter->flags & HID_API_ENUM_SKIP_STRINGS) {
+		free(dev->manufacturer_string);
+		free(dev->product_string);
+		dev->manufacturer_string = NULL;
+		dev->product_string = NULL;
+		if (!filter->serial_number_prefix) {
+			free(dev->serial_number);
+			dev->serial_number = NULL;
+		}
+		return dev;
+	}
 
 	/* Manufacturer String */
-	string[0] = L'\0';
-	HidD_GetManufacturerString(handle, string, sizeof(string));
-	string[MAX_STRING_WCHARS - 1] = L'\0';
-	dev->manufacturer_string = _wcsdup(string);
+	if (!dev->manufacturer_string) {
+		string[0] = L'\0';
+		HidD_GetManufacturerString(handle, string, sizeof(string));
+		string[MAX_STRING_WCHARS - 1] = L'\0';
+		dev->manufacturer_string = _wcsdup(string);
+	}
 
 	/* Product String */
-	string[0] = L'\0';
-	HidD_GetProductString(handle, string, sizeof(string));
-	string[MAX_STRING_WCHARS - 1] = L'\0';
-	dev->product_string = _wcsdup(string);
-
-	hid_internal_get_info(path, dev);
+	if (!dev->product_string) {
+		string[0] = L'\0';
+		HidD_GetProductString(handle, string, sizeof(string));
+		string[MAX_STRING_WCHARS - 1] = L'\0';
+		dev->product_string = _wcsdup(string);
+	}
 
 	return dev;
+
+reject:
+	hid_free_enumeration(dev);
+	return NULL;
 }
 
 struct hid_device_info HID_API_EXPORT * HID_API_CALL hid_enumerate(unsigned short vendor_id, unsigned short product_id)
+{
+	struct hid_enum_filter filter;
+
+	memset(&filter, 0, sizeof(filter));
+	filter.vendor_id = vendor_id;
+	filter.product_id = product_id;
+
+	return hid_enumerate_ex(&filter);
+}
+
+struct hid_device_info HID_API_EXPORT * HID_API_CALL hid_enumerate_ex(const struct hid_enum_filter *filter)
 {
 	struct hid_device_info *root = NULL; /* return object */
 	struct hid_device_info *cur_dev = NULL;
@@ -658,6 +724,9 @@ struct hid_device_info HID_API_EXPORT * HID_API_CALL hid_enumerate(unsigned shor
 		return NULL;
 	}
 
+	if (!filter)
+		filter = &enum_filter_all;
+
 	/* Retrieve HID Interface Class GUID
 	   https://docs.microsoft.com/windows-hardware/drivers/install/guid-devinterface-hid */
 	HidD_GetHidGuid(&interface_class_guid);
@@ -713,11 +782,11 @@ struct hid_device_info HID_API_EXPORT * HID_API_CALL hid_enumerate(unsigned shor
 
 		/* Check the VID/PID to see if we should add this
 		   device to the enumeration list. */
-		if ((vendor_id == 0x0 || attrib.VendorID == vendor_id) &&
-		    (product_id == 0x0 || attrib.ProductID == product_id)) {
+		if ((filter->vendor_id == 0x0 || attrib.VendorID == filter->vendor_id) &&
+		    (filter->product_id == 0x0 || attrib.ProductID == filter->product_id)) {
 
-			/* VID/PID match. Create the record. */
-			struct hid_device_info *tmp = hid_internal_get_device_info(device_interface, device_handle);
+			/* VID/PID match. Create the record, if the rest matches. */
+			struct hid_device_info *tmp = hid_internal_get_device_info(device_interface, device_handle, filter);
 
 			if (tmp == NULL) {
 				goto cont_close;
@@ -737,7 +806,10 @@ cont_close:
 	}
 
 	if (root == NULL) {
-		if (vendor_id == 0 && product_id == 0) {
+		if (filter->usage_page != 0 || filter->usage != 0 || filter->bus_type != HID_API_BUS_UNKNOWN
+		 || (filter->flags & HID_API_ENUM_MATCH_INTERFACE) || filter->serial_number_prefix) {
+			register_global_error(L"No HID devices matching the filter found in the system.");
+		} else if (filter->vendor_id == 0 && filter->product_id == 0) {
 			register_global_error(L"No HID devices found in the system.");
 		} else {
 			register_global_error(L"No HID devices with requested VID/PID found in the system.");
@@ -750,6 +822,31 @@ end_of_function:
 	return root;
 }
 
+int HID_API_EXPORT HID_API_CALL hid_enumerate_each(const struct hid_enum_filter *filter, hid_enumerate_callback_fn callback, void *user_data)
+{
+	struct hid_device_info *devs;
+	struct hid_device_info *info;
+	struct hid_device_info *next;
+	int stop = 0;
+
+	if (!callback) {
+		register_global_error(L"callback is NULL");
+		return -1;
+	}
+
+	/* The list is read at once, then reported one record at a time */
+	devs = hid_enumerate_ex(filter);
+	for (info = devs; info && !stop; info = next) {
+		next = info->next;
+		info->next = NULL;
+		stop = callback(info, user_data);
+		info->next = next;
+	}
+	hid_free_enumeration(devs);
+
+	return 0;
+}
+
 void  HID_API_EXPORT HID_API_CALL hid_free_enumeration(struct hid_device_info *devs)
 {
 	/* TODO: Merge this with the Linux version. This function is platform-independent. */
@@ -765,15 +862,64 @@ void  HID_API_EXPORT HID_API_CALL hid_free_enumeration(struct hid_device_info *d
 	}
 }
 
+int HID_API_EXPORT HID_API_CALL hid_hotplug_register_callback(unsigned short vendor_id, unsigned short product_id, int events, int flags, hid_hotplug_callback_fn callback, void *user_data, hid_hotplug_callback_handle *callback_handle)
+{
+	(void) vendor_id;
+	(void) product_id;
+	(void) events;
+	(void) flags;
+	(void) callback;
+	(void) user_data;
+	(void) callback_handle;
+
+	register_global_error(L"hid_hotplug_register_callback is not supported on this platform");
+	return -1;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_hotplug_deregister_callback(hid_hotplug_callback_handle callback_handle)
+{
+	(void) callback_handle;
+
+	/* No callback can be registered */
+	return -1;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_set_enumeration_cache(int enable)
+{
+	if (!enable)
+		return 0;
+
+	/* Needs hid_hotplug_register_callback() */
+	register_global_error(L"hid_set_enumeration_cache is not supported on this platform");
+	return -1;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_set_enumeration_threads(int num_threads, int timeout_ms)
+{
+	if (num_threads <= 1 && timeout_ms < 0)
+		return 0;
+
+	register_global_error(L"hid_set_enumeration_threads is not supported on this platform");
+	return -1;
+}
+
 HID_API_EXPORT hid_device * HID_API_CALL hid_open(unsigned short vendor_id, unsigned short product_id, const wchar_t *serial_number)
 {
 	/* TODO: Merge this functions with the Linux version. This function should be platform independent. */
 	struct hid_device_info *devs, *cur_dev;
+	struct hid_enum_filter filter;
 	const char *path_to_open = NULL;
 	hid_device *handle = NULL;
 
+	/* Only the path (and the serial number) is needed */
+	memset(&filter, 0, sizeof(filter));
+	filter.vendor_id = vendor_id;
+	filter.product_id = product_id;
+	filter.serial_number_prefix = serial_number;
+	filter.flags = HID_API_ENUM_SKIP_STRINGS | HID_API_ENUM_SKIP_USAGES;
+
 	/* register_global_error: global error is reset by hid_enumerate/hid_init */
-	devs = hid_enumerate(vendor_id, product_id);
+	devs = hid_enumerate_ex(&filter);
 	if (!devs) {
 		/* register_global_error: global error is already set by hid_enumerate */
 		return NULL;
@@ -878,7 +1024,7 @@ HID_API_EXPORT hid_device * HID_API_CALL hid_open_path(const char *path)
 	dev->input_report_length = caps.InputReportByteLength;
 	dev->feature_report_length = caps.FeatureReportByteLength;
 	dev->read_buf = (char*) malloc(dev->input_report_length);
-	dev->device_info = hid_internal_get_device_info(interface_path, dev->device_handle);
+	dev->device_info = hid_internal_get_device_info(interface_path, dev->device_handle, &enum_filter_all);
 
 end_of_function:
 	free(interface_path);
@@ -1055,12 +1201,112 @@ int HID_API_EXPORT HID_API_CALL hid_read(hid_device *dev, unsigned char *data, s
 	return hid_read_timeout(dev, data, length, (dev->blocking)? -1: 0);
 }
 
+int HID_API_EXPORT HID_API_CALL hid_read_batch(hid_device *dev, unsigned char *data, size_t stride, size_t max_reports, size_t *lengths, int milliseconds)
+{
+	size_t count = 0;
+	int res;
+
+	if (!data || !stride || !lengths || !max_reports) {
+		register_string_error(dev, L"Zero buffer/length");
+		return -1;
+	}
+
+	/* Only the first report is waited for, the rest are the ones
+	   which have already completed (or complete immediately). */
+	res = hid_read_timeout(dev, data, stride, milliseconds);
+	while (res > 0) {
+		lengths[count++] = (size_t) res;
+		if (count == max_reports)
+			break;
+		res = hid_read_timeout(dev, data + count * stride, stride, 0);
+	}
+
+	return (count > 0)? (int) count: res;
+}
+
 int HID_API_EXPORT HID_API_CALL hid_set_nonblocking(hid_device *dev, int nonblock)
 {
 	dev->blocking = !nonblock;
 	return 0; /* Success */
 }
 
+int HID_API_EXPORT HID_API_CALL hid_get_pollable_fd(hid_device *dev)
+{
+	register_string_error(dev, L"hid_get_pollable_fd is not supported on this platform");
+	return -1;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_set_input_queue(hid_device *dev, size_t max_reports, size_t max_bytes, hid_queue_policy policy)
+{
+	(void) max_reports;
+	(void) max_bytes;
+	(void) policy;
+	register_string_error(dev, L"hid_set_input_queue is not supported on this platform");
+	return -1;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_get_dropped_reports(hid_device *dev, unsigned long long *count)
+{
+	(void) count;
+	register_string_error(dev, L"hid_get_dropped_reports is not supported on this platform");
+	return -1;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_set_report_id_queue(hid_device *dev, unsigned char report_id, size_t max_reports)
+{
+	(void) report_id;
+	(void) max_reports;
+	register_string_error(dev, L"hid_set_report_id_queue is not supported on this platform");
+	return -1;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_read_report_id(hid_device *dev, unsigned char report_id, unsigned char *data, size_t length, int milliseconds)
+{
+	(void) report_id;
+	(void) data;
+	(void) length;
+	(void) milliseconds;
+	register_string_error(dev, L"hid_read_report_id is not supported on this platform");
+	return -1;
+}
+
+hid_poller HID_API_EXPORT * HID_API_CALL hid_poller_new(void)
+{
+	register_global_error(L"hid_poller is not supported on this platform");
+	return NULL;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_poller_add(hid_poller *poller, hid_device *dev, hid_poller_callback callback, void *user_data)
+{
+	(void) poller;
+	(void) dev;
+	(void) callback;
+	(void) user_data;
+	register_global_error(L"hid_poller is not supported on this platform");
+	return -1;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_poller_remove(hid_poller *poller, hid_device *dev)
+{
+	(void) poller;
+	(void) dev;
+	register_global_error(L"hid_poller is not supported on this platform");
+	return -1;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_poller_run(hid_poller *poller, int milliseconds)
+{
+	(void) poller;
+	(void) milliseconds;
+	register_global_error(L"hid_poller is not supported on this platform");
+	return -1;
+}
+
+void HID_API_EXPORT HID_API_CALL hid_poller_free(hid_poller *poller)
+{
+	(void) poller;
+}
+
 int HID_API_EXPORT HID_API_CALL hid_send_feature_report(hid_device *dev, const unsigned char *data, size_t length)
 {
 	BOOL res = FALSE;
@@ -1240,6 +1486,34 @@ HID_API_EXPORT struct hid_device_info * HID_API_CALL hid_get_device_info(hid_dev
 	return dev->device_info;
 }
 
+int HID_API_EXPORT_CALL hid_get_report_descriptor(hid_device *dev, unsigned char *buf, size_t buf_size)
+{
+	(void) buf;
+	(void) buf_size;
+
+	/* Windows only exposes the parsed (preparsed) data of the descriptor */
+	register_string_error(dev, L"hid_get_report_descriptor is not supported on this platform");
+	return -1;
+}
+
+HID_API_EXPORT const struct hid_report_layout * HID_API_CALL hid_get_report_layout(hid_device *dev)
+{
+	register_string_error(dev, L"hid_get_report_layout is not supported on this platform");
+	return NULL;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_decode_report(const struct hid_report_layout *layout, const unsigned char *report, size_t length, int *values, size_t max_values)
+{
+	(void) layout;
+	(void) report;
+	(void) length;
+	(void) values;
+	(void) max_values;
+
+	register_global_error(L"hid_decode_report is not supported on this platform");
+	return -1;
+}
+
 int HID_API_EXPORT_CALL HID_API_CALL hid_get_indexed_string(hid_device *dev, int string_index, wchar_t *string, size_t maxlen)
 {
 	BOOL res;